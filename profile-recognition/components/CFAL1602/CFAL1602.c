@@ -1,5 +1,8 @@
 #include "CFAL1602.h"
 
+#include "esp_attr.h"
+#include "esp_log.h"
+
 /**
  * Private variables (put on CFAL1602 object)
  * 
@@ -12,6 +15,8 @@ typedef struct my_struct_t {
     bool isAutoScroll;
     bool isEnabled;
     const int line;
+    int length;         // strlen(msg), taken once
+    int last;           // scroll position before the ring goes back to 0
 } my_struct_t;
 
 my_struct_t line0 = {
@@ -30,45 +35,62 @@ static const char* TAG = "cfal1602";
 
 static const char* clear_string = "                "; // used to clear line
 
-static esp_event_handler_instance_t s_instance1_1;
-static esp_event_handler_instance_t s_instance1_2;
-static esp_event_handler_instance_t s_instance2_1;
-static esp_event_handler_instance_t s_instance2_2;
+/**
+ * Prints waiting for a dwell to end. An entry with a NULL msg is a dwell of
+ * its own, started once the entries before it are shown
+ */
+typedef struct pending_t {
+    const char* msg;
+    int line;
+    bool isAutoScroll;
+    int dwell_ms;
+    WS2_prio_t prio;        // of a dwell
+} pending_t;
 
-static esp_event_handler_instance_t s_instanceS_1;
-static esp_event_handler_instance_t s_instanceS_2;
+// Above every dwell: a flush skips them all
+#define PRIO_ALL (WS2_prio_error + 1)
 
 /**
- * In 16-char string, replace instances of \0 (0x00) with SPACE (0x20)
- * Note: String s actually 17-char, including \0 end byte
+ * Mailbox entries, from the public calls to the render task
  */
-static void replace_null_with_spaces(char *s) {
-    for (int i=0; i < 16; i++) {
-        if (s[i] == 0x0) {
-            s[i] = ' ';
-        }
-    }
-}
+typedef enum {
+    MAIL_PRINT,
+    MAIL_DWELL,
+    MAIL_SCREEN,
+    MAIL_FLUSH,
+    MAIL_WAKE               // nothing, see mail_post
+} mail_kind_t;
+
+typedef struct mail_t {
+    mail_kind_t kind;
+    pending_t entry;        // the print or dwell, unused for a flush
+    const char* screen[2];  // MAIL_SCREEN lines, its dwell in entry
+} mail_t;
+
+// Render task state. Only the render task touches it, so it needs no lock
+static pending_t pending[WS2_PENDING_SIZE];
+static int pending_head = 0;
+static int pending_count = 0;
+static bool dwelling = false;
+static TickType_t dwell_until = 0;      // tick count at the end of the dwell
+static WS2_prio_t dwell_prio;           // a screen above it cuts the dwell short
+
+static QueueHandle_t mailbox = NULL;
+
+// Last print per line, shown or waiting: for WS2_get_string, and for the
+// render task to catch up to after mail was lost to a full mailbox
+typedef struct latest_t {
+    const char* msg;
+    bool isAutoScroll;
+} latest_t;
+static latest_t latest[2];
+static portMUX_TYPE latest_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool mail_lost = false;          // only touched atomically
 
-static char* get_id_string(esp_event_base_t base, int32_t id) {
-    char* event = "";
-    if (base == TIMER_EVENTS) {
-        switch(id) {
-            case TIMER_EVENT_STARTED:
-            event = "TIMER_EVENT_STARTED";
-            break;
-            case TIMER_EVENT_EXPIRY:
-            event = "TIMER_EVENT_EXPIRY";
-            break;
-            case TIMER_EVENT_STOPPED:
-            event = "TIMER_EVENT_STOPPED";
-            break;
-        }
-    } else {
-        event = "TASK_ITERATION_EVENT";
-    }
-    return event;
-}
+// Scroll ticks, only armed while a line's text is longer than the display
+static bool ticking = false;
+static TickType_t next_tick = 0;
+static TickType_t tick_period = 0;
 
 /* Send a command to the LCD. Uses spi_device_polling_transmit, which waits
  * until the transfer is complete.
@@ -76,6 +98,8 @@ static char* get_id_string(esp_event_base_t base, int32_t id) {
  * Since command transactions are usually small, they are handled in polling
  * mode for higher speed. The overhead of interrupt transactions is more than
  * just waiting for the transaction to complete.
+ *
+ * Only for lcd_init: polling can't start while batches are queued
  */
 static void lcd_cmd(spi_device_handle_t spi, const uint8_t cmd)
 {
@@ -92,55 +116,108 @@ static void lcd_cmd(spi_device_handle_t spi, const uint8_t cmd)
     assert(ret==ESP_OK);            //Should have had no issues.
 }
 
-/* Send data to the LCD. Uses spi_device_polling_transmit, which waits until the
- * transfer is complete.
+/* Batches: 10-bit words packed back to back, MSB first, each sent as one
+ * queued DMA transaction. The caller only packs and queues; it waits for the
+ * bus only when every slot is still queued or unreaped.
  *
- * Since data transactions are usually small, they are handled in polling
- * mode for higher speed. The overhead of interrupt transactions is more than
- * just waiting for the transaction to complete.
+ * The longest batch is a line with every cell changed: a DDRAM address and
+ * 16 characters
  */
-static void lcd_data(spi_device_handle_t spi, const char cmd)
+#define LCD_BATCH_WORDS 17
+#define LCD_BATCH_BYTES ((((LCD_BATCH_WORDS * 10 + 7) / 8) + 3) & ~3)
+
+static DMA_ATTR uint8_t batch_buf[WS2_SPI_QUEUE_SIZE][LCD_BATCH_BYTES];
+static spi_transaction_t batch_trans[WS2_SPI_QUEUE_SIZE];
+static int batch_next = 0;      // slot the batch is built in
+static int batch_words = 0;     // words packed into it so far
+static int batch_in_flight = 0; // slots queued and not yet reaped
+
+/* Start a batch. Slots are used in turn, so the one to free is the oldest */
+static void lcd_batch_begin(spi_device_handle_t spi)
 {
-    esp_err_t ret;
-    spi_transaction_t t;
+    if (batch_in_flight == WS2_SPI_QUEUE_SIZE) {
+        spi_transaction_t *done;
+        esp_err_t ret = spi_device_get_trans_result(spi, &done, portMAX_DELAY);
+        assert(ret == ESP_OK);
+        batch_in_flight--;
+    }
+    memset(batch_buf[batch_next], 0, LCD_BATCH_BYTES);
+    batch_words = 0;
+}
 
-    uint16_t tmp = (uint16_t)(WS2_data_write | cmd);
+/* Append a command, or WS2_data_write | a character */
+static void lcd_batch_word(uint16_t word)
+{
+    uint8_t *buf = batch_buf[batch_next];
+    int bit = batch_words * 10;
 
-    uint16_t cmd2 = SPI_SWAP_DATA_TX(tmp, 10);
+    assert(batch_words < LCD_BATCH_WORDS);
+    for (int i = 9; i >= 0; i--, bit++) {
+        if (word & (1 << i)) {
+            buf[bit / 8] |= 0x80 >> (bit % 8);
+        }
+    }
+    batch_words++;
+}
 
-    memset(&t, 0, sizeof(t));       //Zero out the transaction
-    t.length=10;                     //Command is 8 bits
-    t.tx_buffer=&cmd2;               //The data is the cmd itself
-    t.user=(void*)0;                //D/C needs to be set to 0
-    ret=spi_device_polling_transmit(spi, &t);  //Transmit!
-    assert(ret==ESP_OK);            //Should have had no issues.
+/* Queue the batch, if anything was packed. Returns before it is sent */
+static void lcd_batch_send(spi_device_handle_t spi)
+{
+    if (batch_words == 0) {
+        return;
+    }
+    spi_transaction_t *t = &batch_trans[batch_next];
+
+    memset(t, 0, sizeof(*t));
+    t->length = batch_words * 10;
+    t->tx_buffer = batch_buf[batch_next];
+    esp_err_t ret = spi_device_queue_trans(spi, t, portMAX_DELAY);
+    assert(ret == ESP_OK);
+    batch_in_flight++;
+    batch_next = (batch_next + 1) % WS2_SPI_QUEUE_SIZE;
 }
 
-/* Print a string on one line to the LCD.
+/* Shadow of DDRAM: the character each cell of the display shows. Only the
+ * render task writes the display, so it needs no lock
+ */
+static char frame[2][16];
+
+/* Print a string on one line to the LCD, sending only the cells that change,
+ * in one batch.
  *
- * In case of 0x0 (NULL) bytes in string, specify length of string.
- * Line number is 0 (top) or 1 (bottom)
+ * Cells from length on are spaces. Line number is 0 (top) or 1 (bottom)
  */
-static void lcd_print(spi_device_handle_t spi, int line, const char *s) {
-    /* (1) Send command moving cursor to start of selected line */
-    /* (2) Write each character of text */
-	/* (3) Write remaining slots with spaces */
-
-    int n = 16; // limit string length
-    int length = strlen(s);
-
-    lcd_cmd(spi, (int)(WS2_setDDRAM | (line << 6))); /* (1) */
-    while ((--length >= 0) && (--n >= 0)) { /* (2) */
-        if (*s == 0x00) {
-            lcd_data(spi, ' ');
-            s++;
-        } else {
-            lcd_data(spi, *s++);
+static void lcd_print(spi_device_handle_t spi, int line, const char *s, int length) {
+    /* (1) Lay out the line: text, then spaces to the end */
+    /* (2) Mark each cell that differs from the frame */
+    /* (3) Per run of marked cells, move the cursor once, write the run */
+
+    char cells[16];
+    uint16_t dirty = 0;
+
+    for (int i = 0; i < 16; i++) {          /* (1) */
+        cells[i] = (i < length) ? s[i] : ' ';
+        if (cells[i] != frame[line][i]) {   /* (2) */
+            dirty |= (1 << i);
         }
     }
-    while (--n >= 0) {                      /* (3) */
-        lcd_data(spi, ' ');
+
+    lcd_batch_begin(spi);
+    int i = 0;
+    while (dirty != 0) {                    /* (3) */
+        // entry mode increments the address, so a run needs one command
+        while (!(dirty & (1 << i))) {
+            i++;
+        }
+        lcd_batch_word(WS2_setDDRAM | (line << 6) | i);
+        while (dirty & (1 << i)) {
+            lcd_batch_word(WS2_data_write | (uint8_t)cells[i]);
+            frame[line][i] = cells[i];
+            dirty &= ~(1 << i);
+            i++;
+        }
     }
+    lcd_batch_send(spi);
 }
 
 //Initialize the display
@@ -158,82 +235,234 @@ static void lcd_init(spi_device_handle_t spi)
     // set cursor and return home
     lcd_cmd(spi, WS2_entry | WS2_entry_I_D);
     lcd_cmd(spi, WS2_home);
+
+    // clear left a space in every cell
+    memset(frame, ' ', sizeof(frame));
 }
 
-/* Event source periodic timer related definitions */
-ESP_EVENT_DEFINE_BASE(TIMER_EVENTS);
+// Show a line's text from its scroll position. On a tick, move the position
+// on first, around the ring: by 1 if isAutoScroll, else a page of 16
+static void line_show(CFAL1602Interface *this, my_struct_t *ps, bool isTick) {
+    if (ps->isEnabled == false) {
+        return;
+    }
 
-esp_timer_handle_t TIMER;
+    if (isTick) {
+        if (ps->last == 0) {
+            return; // fits, nothing moves
+        }
+        ps->count = (ps->count >= ps->last) ? 0 :
+            ps->count + ((ps->isAutoScroll) ? 1 : 16);
+    }
 
-// Callback that will be executed when the timer period lapses. Posts the timer expiry event
-// to the default event loop.
-static void timer_callback(void* arg)
-{
-    ESP_ERROR_CHECK(esp_event_post(TIMER_EVENTS, TIMER_EVENT_EXPIRY, NULL, 0, portMAX_DELAY));
+    lcd_print(this->spi, ps->line, ps->msg + ps->count, ps->length - ps->count);
 }
 
-// Handler which executes when the timer started event gets executed by the initial posting.
-static void timer_started_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data)
-{
-    // local vars
-    char print_string[17] = {0};
-    my_struct_t * ps = (my_struct_t*)(handler_args);
-    CFAL1602Interface *this = ps->this;
+// Arm the scroll ticks if a line is too long to show at once, else stop them
+static void scroll_arm(void) {
+    bool scrolling = line0.isEnabled && (line0.last > 0);
+    scrolling = scrolling || (line1.isEnabled && (line1.last > 0));
 
-    if (ps->isEnabled == false) {
-        return;
+    if (scrolling && !ticking) {
+        next_tick = xTaskGetTickCount() + tick_period;
     }
+    ticking = scrolling;
+}
 
-    // generate printable string
-    const char* print_str = ps->msg;
-    
-    snprintf(print_string, 17, "%s", print_str);
-    replace_null_with_spaces(print_string);
+// Show msg on line now
+static void msg_apply(CFAL1602Interface *this, const char* msg, int line, bool isAutoScroll) {
+    my_struct_t *ps = (line == 0) ? &line0 : &line1;
+
+    ps->msg = msg;
+    ps->count = 0;
+    ps->isAutoScroll = isAutoScroll;
+    ps->isEnabled = true;
+
+    // The ring: the last window is the first to reach the end of the text
+    ps->length = strlen(msg);
+    if (ps->length <= 16) {
+        ps->last = 0;
+    } else if (isAutoScroll) {
+        ps->last = ps->length - 16;
+    } else {
+        ps->last = ((ps->length - 16 + 15) / 16) * 16;
+    }
 
-    lcd_print(this->spi, ps->line, print_string);
+    line_show(this, ps, false);
+    scroll_arm();
+}
 
-    //ESP_LOGI(TAG, "%s:%s: timer_started_handler, string from char %d", base, get_id_string(base, id), ps->count);
+// Hold the display for dwell_ms
+static void dwell_start(int dwell_ms, WS2_prio_t prio) {
+    dwelling = true;
+    dwell_prio = prio;
+    dwell_until = xTaskGetTickCount() + pdMS_TO_TICKS(dwell_ms);
 }
 
-// Handler which executes when the timer expiry event gets executed by the loop. This handler keeps track of
-// how many times the timer expired. When a set number of expiry is reached, the handler stops the timer
-// and sends a timer stopped event.
-static void timer_expiry_handler(void* handler_args, esp_event_base_t base, int32_t id, void* event_data)
-{
-    // local vars
-    char print_string[17] = {0};
-    my_struct_t * ps = (my_struct_t*)(handler_args);
-    CFAL1602Interface *this = ps->this;
+// Show pending prints up to the next dwell of at least skipBelow. The dwells
+// below it are skipped
+static void pending_drain(CFAL1602Interface *this, int skipBelow) {
+    dwelling = false;
+    while (pending_count > 0) {
+        pending_t *p = &pending[pending_head];
+        pending_head = (pending_head + 1) % WS2_PENDING_SIZE;
+        pending_count--;
+
+        if (p->msg != NULL) {
+            msg_apply(this, p->msg, p->line, p->isAutoScroll);
+        } else if ((int)p->prio >= skipBelow) {
+            dwell_start(p->dwell_ms, p->prio);
+            return;
+        }
+    }
+}
 
-    if (ps->isEnabled == false) {
+// Queue an entry behind the running dwell
+static void pending_push(CFAL1602Interface *this, const pending_t *p) {
+    if (pending_count == WS2_PENDING_SIZE) {
+        // Nobody is reading that fast: skip to the newest screen
+        ESP_LOGW(TAG, "display queue full, dropping dwells");
+        pending_drain(this, PRIO_ALL);
+        if (p->msg != NULL) {
+            msg_apply(this, p->msg, p->line, p->isAutoScroll);
+        } else {
+            dwell_start(p->dwell_ms, p->prio);
+        }
         return;
     }
+    pending[(pending_head + pending_count) % WS2_PENDING_SIZE] = *p;
+    pending_count++;
+}
 
-    // generate printable string
-    const char* print_str;
-    if (id == TIMER_EVENT_EXPIRY) {
-        print_str = ps->msg + ps->count;
+// A print or dwell goes behind the running dwell, if any
+static void entry_handle(CFAL1602Interface *this, const pending_t *p) {
+    if (dwelling) {
+        pending_push(this, p);
+    } else if (p->msg != NULL) {
+        msg_apply(this, p->msg, p->line, p->isAutoScroll);
     } else {
-        print_str = ps->msg;
+        dwell_start(p->dwell_ms, p->prio);
     }
-    
-    snprintf(print_string, 17, "%s", print_str);
-    replace_null_with_spaces(print_string);
+}
 
-    lcd_print(this->spi, ps->line, print_string);
+// A screen above the running dwell cuts it short, a flush ends it
+static void mail_handle(CFAL1602Interface *this, const mail_t *mail) {
+    switch (mail->kind) {
+        case MAIL_PRINT:
+        case MAIL_DWELL:
+            entry_handle(this, &mail->entry);
+            break;
+        case MAIL_SCREEN:
+            if (dwelling && (mail->entry.prio > dwell_prio)) {
+                pending_drain(this, mail->entry.prio);
+            }
+            for (int line = 0; line < 2; line++) {
+                if (mail->screen[line] != NULL) {
+                    pending_t p = {
+                        .msg = mail->screen[line],
+                        .line = line,
+                        .isAutoScroll = false
+                    };
+                    entry_handle(this, &p);
+                }
+            }
+            entry_handle(this, &mail->entry);
+            break;
+        case MAIL_FLUSH:
+            if (dwelling) {
+                pending_drain(this, PRIO_ALL);
+            }
+            break;
+        case MAIL_WAKE:
+            break;
+    }
+}
 
-    if (id == TIMER_EVENT_EXPIRY) {
-        ps->count += (ps->isAutoScroll) ? 1 : 16;
+// Mail was lost: skip the dwells and show the last print on each line, as
+// the mail that got through would have left it
+static void mail_catch_up(CFAL1602Interface *this) {
+    pending_drain(this, PRIO_ALL);
+    for (int line = 0; line < 2; line++) {
+        portENTER_CRITICAL(&latest_mux);
+        latest_t l = latest[line];
+        portEXIT_CRITICAL(&latest_mux);
+
+        my_struct_t *ps = (line == 0) ? &line0 : &line1;
+        if ((l.msg != NULL) && ((ps->msg != l.msg) || !ps->isEnabled)) {
+            msg_apply(this, l.msg, line, l.isAutoScroll);
+        }
     }
+}
+
+// Owns the display: mail in order, the end of each dwell and the scroll ticks.
+// With nothing scrolling or dwelling it sleeps until the next mail
+static void render_task(void* arg) {
+    CFAL1602Interface *this = (CFAL1602Interface*)arg;
+    mail_t mail;
+
+    for (;;) {
+        // 1: Sleep until mail, the next scroll tick or the end of the dwell
+        TickType_t now = xTaskGetTickCount();
+        TickType_t wait = portMAX_DELAY;
+        if (ticking || dwelling) {
+            TickType_t wake = ticking ? next_tick : dwell_until;
+            if (ticking && dwelling && ((int32_t)(dwell_until - wake) < 0)) {
+                wake = dwell_until;
+            }
+            wait = ((int32_t)(wake - now) > 0) ? (wake - now) : 0;
+        }
+        if (xQueueReceive(mailbox, &mail, wait) == pdTRUE) {
+            mail_handle(this, &mail);
+        }
+
+        // 2: Once the mail that got in is handled, catch up on any that didn't
+        if ((uxQueueMessagesWaiting(mailbox) == 0) &&
+            __atomic_exchange_n(&mail_lost, false, __ATOMIC_ACQ_REL)) {
+            mail_catch_up(this);
+        }
+
+        // 3: Dwell over: show what was printed during it, up to the next dwell
+        now = xTaskGetTickCount();
+        if (dwelling && ((int32_t)(now - dwell_until) >= 0)) {
+            pending_drain(this, WS2_prio_status);
+        }
 
-    if (strlen(print_str) <= 16) {
-        ps->count = 0; // Loop string read back to beginning
+        // 4: Scroll tick, both lines
+        if (ticking && ((int32_t)(now - next_tick) >= 0)) {
+            line_show(this, &line0, true);
+            line_show(this, &line1, true);
+            next_tick += tick_period;
+            if ((int32_t)(now - next_tick) >= 0) {
+                next_tick = now + tick_period; // fell behind, don't catch up
+            }
+        }
     }
-    //ESP_LOGI(TAG, "%s:%s: timer_expiry_handler, string from char %d", base, get_id_string(base, id), ps->count);
 }
 
-/* Event source task related definitions */
-ESP_EVENT_DEFINE_BASE(TASK_EVENTS);
+// Note a print as the last on its line
+static void latest_set(int line, const char* msg, bool isAutoScroll) {
+    portENTER_CRITICAL(&latest_mux);
+    latest[(line == 0) ? 0 : 1] = (latest_t){ .msg = msg, .isAutoScroll = isAutoScroll };
+    portEXIT_CRITICAL(&latest_mux);
+}
+
+// Hand mail to the render task. Never waits: if the mailbox is full, the
+// render task catches up to the last print per line once it has room
+static void mail_post(const mail_t *mail) {
+    if (mailbox == NULL) {
+        return; // before WS2_init, nothing to show it on
+    }
+    if (xQueueSend(mailbox, mail, 0) != pdTRUE) {
+        __atomic_store_n(&mail_lost, true, __ATOMIC_RELEASE);
+        ESP_LOGW(TAG, "display mailbox full, catching up");
+
+        // The render task may have emptied the mailbox and gone to sleep
+        // since: wake it. If there is still no room it has mail to handle,
+        // and looks at mail_lost after that
+        mail_t wake = { .kind = MAIL_WAKE };
+        xQueueSend(mailbox, &wake, 0);
+    }
+}
 
 /**
  * -------------------------------------
@@ -273,7 +502,7 @@ void WS2_init(CFAL1602Interface *this, gpio_num_t _pin_miso,
 #endif
         .mode = 0,                                //SPI mode 0
         .spics_io_num = this->pin_cs,               //CS pin
-        .queue_size=7,                          //We want to be able to queue 7 transactions at a time
+        .queue_size=WS2_SPI_QUEUE_SIZE,         //Line batches queued at a time
     };
 
     //Initialize the SPI bus
@@ -286,57 +515,70 @@ void WS2_init(CFAL1602Interface *this, gpio_num_t _pin_miso,
     //Initialize the LCD
     lcd_init(this->spi);
 
-    // Create and start the event sources
-    esp_timer_create_args_t timer_args = {
-        .callback = &timer_callback,
-    };
+    // Mailbox before the task: it reads it from its first line
+    mailbox = xQueueCreate(WS2_MAILBOX_SIZE, sizeof(mail_t));
+    assert(mailbox != NULL);
 
     line0.this = this;
     line1.this = this;
+    tick_period = pdMS_TO_TICKS(this->timer_period / 1000);
 
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-
-    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &TIMER)); // creates timer with timer expiry event. Does not start timer.
-
-    esp_event_handler_instance_register(TIMER_EVENTS, TIMER_EVENT_STARTED, timer_started_handler, (void*)(&line1), &s_instanceS_1);
-
-    esp_event_handler_instance_register(TIMER_EVENTS, TIMER_EVENT_EXPIRY, timer_expiry_handler, (void*)(&line0), &s_instance1_1);
-    esp_event_handler_instance_register(TIMER_EVENTS, TIMER_EVENT_EXPIRY, timer_expiry_handler, (void*)(&line1), &s_instance2_1);
-
-    ESP_LOGI(TAG, "starting event sources");
-    ESP_ERROR_CHECK(esp_timer_start_periodic(TIMER, this->timer_period)); // used to be TIMER_PERIOD
+    ESP_LOGI(TAG, "starting render task");
+    BaseType_t created = xTaskCreate(render_task, "ws2_render", WS2_TASK_STACK_SIZE,
+        (void*)this, WS2_TASK_PRIORITY, NULL);
+    assert(created == pdPASS);
+    this->initialized = true;
 }
 
 void WS2_msg_print(CFAL1602Interface *this, const char* msg, int line, bool isAutoScroll) {
-    if (line == 0) {
-        line0.msg = msg;
-        line0.count = 0;
-        line0.isAutoScroll = isAutoScroll;
-        line0.isEnabled = true;
-
-        esp_event_handler_instance_register(TIMER_EVENTS, TIMER_EVENT_EXPIRY, timer_expiry_handler, (void*)(&line0), &s_instance1_2);
-        esp_event_handler_instance_register(TIMER_EVENTS, TIMER_EVENT_STARTED, timer_started_handler, (void*)(&line0), &s_instanceS_2);
-
-        esp_event_handler_instance_unregister(TIMER_EVENTS, TIMER_EVENT_EXPIRY, s_instance1_1);
-        s_instance1_1 = s_instance1_2;
-    } else {
-        line1.msg = msg;
-        line1.count = 0;
-        line1.isAutoScroll = isAutoScroll;
-        line1.isEnabled = true;
+    mail_t mail = {
+        .kind = MAIL_PRINT,
+        .entry = {
+            .msg = msg,
+            .line = line,
+            .isAutoScroll = isAutoScroll,
+            .dwell_ms = 0
+        }
+    };
+    latest_set(line, msg, isAutoScroll);
+    mail_post(&mail);
+}
 
-        esp_event_handler_instance_register(TIMER_EVENTS, TIMER_EVENT_EXPIRY, timer_expiry_handler, (void*)(&line1), &s_instance2_2);
-        esp_event_handler_instance_register(TIMER_EVENTS, TIMER_EVENT_STARTED, timer_started_handler, (void*)(&line1), &s_instanceS_2);
+void WS2_msg_dwell(CFAL1602Interface *this, int dwell_ms) {
+    mail_t mail = {
+        .kind = MAIL_DWELL,
+        .entry = {
+            .msg = NULL,
+            .dwell_ms = dwell_ms,
+            .prio = WS2_prio_status
+        }
+    };
+    mail_post(&mail);
+}
 
-        esp_event_handler_instance_unregister(TIMER_EVENTS, TIMER_EVENT_EXPIRY, s_instance2_1);
-        s_instance2_1 = s_instance2_2;
+void WS2_msg_screen(CFAL1602Interface *this, const char* msg0, const char* msg1,
+    WS2_prio_t prio, int dwell_ms) {
+    mail_t mail = {
+        .kind = MAIL_SCREEN,
+        .entry = {
+            .msg = NULL,
+            .dwell_ms = dwell_ms,
+            .prio = prio
+        },
+        .screen = { msg0, msg1 }
+    };
+    if (msg0 != NULL) {
+        latest_set(0, msg0, false);
     }
+    if (msg1 != NULL) {
+        latest_set(1, msg1, false);
+    }
+    mail_post(&mail);
+}
 
-    esp_event_handler_instance_unregister(TIMER_EVENTS, TIMER_EVENT_STARTED, s_instanceS_1);
-    s_instanceS_1 = s_instanceS_2;
-
-    //ESP_LOGI(TAG, "%s:%s: posting to default loop", TIMER_EVENTS, get_id_string(TIMER_EVENTS, TIMER_EVENT_STARTED));
-    ESP_ERROR_CHECK(esp_event_post(TIMER_EVENTS, TIMER_EVENT_STARTED, NULL, 0, portMAX_DELAY));
+void WS2_msg_flush(CFAL1602Interface *this) {
+    mail_t mail = { .kind = MAIL_FLUSH };
+    mail_post(&mail);
 }
 
 void WS2_msg_clear(CFAL1602Interface *this, int line) {
@@ -344,12 +586,8 @@ void WS2_msg_clear(CFAL1602Interface *this, int line) {
 }
 
 char * WS2_get_string(CFAL1602Interface *this, int line) {
-    char * outString = NULL;
-    if ((line == 0) && (line0.isEnabled)) {
-        outString = line0.msg;
-    }
-    if ((line == 1) && (line1.isEnabled)) {
-        outString = line1.msg;
-    }
-    return outString;
-}
\ No newline at end of file
+    portENTER_CRITICAL(&latest_mux);
+    const char* msg = latest[(line == 0) ? 0 : 1].msg;
+    portEXIT_CRITICAL(&latest_mux);
+    return (char*)msg;
+}
@@ -19,11 +19,11 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_system.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
 
-#include "event_source.h"
 #include "messages.h"
 
 #ifdef CONFIG_IDF_TARGET_ESP32
@@ -31,6 +31,19 @@
 #define DMA_CHAN    2
 #endif
 
+// Prints and dwells that can wait behind a dwell
+#define WS2_PENDING_SIZE 16
+
+// Line writes that can be queued on the SPI bus at once
+#define WS2_SPI_QUEUE_SIZE 7
+
+// Render task, which owns the display. Below the input tasks, so prints made
+// while handling an input go out together once it's done
+#define WS2_TASK_PRIORITY 5
+#define WS2_TASK_STACK_SIZE 3072
+// Prints, dwells and flushes waiting for the render task
+#define WS2_MAILBOX_SIZE 32
+
 /*#define PIN_NUM_MISO -1
 #define PIN_NUM_MOSI 15
 #define PIN_NUM_CLK  14
@@ -74,6 +87,15 @@ typedef enum {
     WS2_function_DL = 0x10,
 } WS0010_cmd_param_t;
 
+/**
+ * @brief Priority of a screen and its dwell, see WS2_msg_screen
+ */
+typedef enum {
+    WS2_prio_status = 0,    // progress and menu moves: Returning to menu
+    WS2_prio_outcome,       // what came of an input: Access granted
+    WS2_prio_error          // what went wrong: Invalid PIN
+} WS2_prio_t;
+
 // NEW: Add CFAL1602 this object
 // WARNING: move to CFAL1602.h when done
 typedef struct CFAL1602Interface {
@@ -112,12 +134,22 @@ typedef struct CFAL1602Interface {
     const uint64_t timer_period;
 } CFAL1602Interface;
 
+/**
+ * @brief Set up the SPI device and the display, and start the render task
+ * @return none
+ */
 void WS2_init(CFAL1602Interface *this, gpio_num_t _pin_miso,
     gpio_num_t _pin_mosi, gpio_num_t _pin_sck, gpio_num_t _pin_cs);
 
 /**
- * @brief Print a message to the CFAL1602 (WS0010) OLED text display
- * @param msg           char string to print
+ * @brief Print a message to the CFAL1602 (WS0010) OLED text display. Shown
+ *        by the render task, at once or when the running dwell (see
+ *        WS2_msg_dwell) ends. Posts to its mailbox without allocating or
+ *        waiting. If the mailbox is full the render task catches up once
+ *        it has room: the dwells are skipped and each line shows its last
+ *        print, so the final screen is never lost
+ * @param msg           char string to print, not copied: keep it valid and
+ *                      unchanged while it is shown or waiting
  * @param line          line number, 0 (TOP) or 1 (BOTTOM)
  * @param isAutoScroll  bool for enabling auto-scroll text
  * @return none
@@ -125,6 +157,40 @@ void WS2_init(CFAL1602Interface *this, gpio_num_t _pin_miso,
 void WS2_msg_print(CFAL1602Interface *this, const char* msg, int line,
     bool isAutoScroll);
 
+/**
+ * @brief Hold what has been printed so far on screen for dwell_ms. Prints
+ *        made meanwhile are queued and shown in order when it ends, and a
+ *        dwell queued behind it starts then. Returns at once, so callers never
+ *        sleep to let a message be read. Has WS2_prio_status
+ * @param dwell_ms      milliseconds to hold the screen
+ * @return none
+ */
+void WS2_msg_dwell(CFAL1602Interface *this, int dwell_ms);
+
+/**
+ * @brief Show both lines and hold them for dwell_ms, as one entry. Queued
+ *        behind the running dwell like a print, unless prio is above the
+ *        dwell's: then it is cut short, with the lower dwells queued behind
+ *        it, and the prints between show at once. Lines don't scroll.
+ *        Returns at once
+ * @param msg0          line 0 text, "" to clear it, NULL to leave it as it is
+ * @param msg1          line 1 text, as msg0
+ * @param prio          priority of the screen and its dwell
+ * @param dwell_ms      milliseconds to hold the screen, unless a higher
+ *                      priority screen comes
+ * @return none
+ */
+void WS2_msg_screen(CFAL1602Interface *this, const char* msg0, const char* msg1,
+    WS2_prio_t prio, int dwell_ms);
+
+/**
+ * @brief End the running dwell and show every queued print now, skipping
+ *        the dwells between them. For new input, which should not wait for
+ *        the last outcome to finish showing
+ * @return none
+ */
+void WS2_msg_flush(CFAL1602Interface *this);
+
 /**
  * @brief Clear a line on the CFAL1602 (WS0010) OLED text display
  * @param line          line number, 0 (TOP) or 1 (BOTTOM)
@@ -133,7 +199,8 @@ void WS2_msg_print(CFAL1602Interface *this, const char* msg, int line,
 void WS2_msg_clear(CFAL1602Interface *this, int line);
 
 /**
- * @brief Retrieve string currently printing on a line (including clear_string)
+ * @brief Retrieve the string last printed on a line (including clear_string),
+ *        shown or waiting behind a dwell
  * @param line          line number, 0 (TOP) or 1 (BOTTOM)
  * @return pointer to string
  */
@@ -30,6 +30,7 @@
 ||
 */
 #include "Keypad.h"
+#include "esp_attr.h"
 
 #define GPIO_OUTPUT_PIN_SEL  ((1ULL<<25) | (1ULL<<26) | (1ULL<<27) | (1ULL<<33))
 #define GPIO_INPUT_PIN_SEL  ((1ULL<<34) | (1ULL<<35) | (1ULL<<36) | (1ULL<<39))
@@ -146,13 +147,12 @@ static bool Keypad_updateList(Keypad *this) {
 
 // Private : Hardware scan
 static void Keypad_scanKeys(Keypad *this) {
-	// Re-intialize the row pins. Allows sharing these pins with other hardware.
+	// Columns are open drain (see Keypad_init): a pulse is only a level, no
+	// direction change.
 
 	// bitMap stores ALL the keys that are being pressed.
 	for (uint8_t c=0; c<(this->sizeKpd).columns; c++) {
 
-		gpio_set_direction((gpio_num_t)((this->columnPins)[c]), GPIO_MODE_OUTPUT);
-
 		//pin_write(columnPins[c], LOW);	// Begin column pulse output.
 		gpio_set_level((gpio_num_t)((this->columnPins)[c]), 0);
 
@@ -166,15 +166,47 @@ static void Keypad_scanKeys(Keypad *this) {
 			}
 
 		}
-		// Set pin to high impedance input. Effectively ends column pulse.
+		// Release the pin to its pull-up (high impedance). Effectively ends column pulse.
 		//pin_write(columnPins[c],HIGH);
 		gpio_set_level((gpio_num_t)((this->columnPins)[c]), 1);
+	}
+}
 
-		//pin_mode(columnPins[c],INPUT);
-		gpio_set_direction((gpio_num_t)((this->columnPins)[c]), GPIO_MODE_INPUT);
+// Private : drive every column low (idle mode) or release them all
+static void Keypad_setColumns(Keypad *this, uint32_t level) {
+	for (uint8_t c=0; c<(this->sizeKpd).columns; c++) {
+		gpio_set_level((gpio_num_t)((this->columnPins)[c]), level);
 	}
 }
 
+// Private : with the columns driven, true if any key pulls its row low
+static bool Keypad_anyRowLow(Keypad *this) {
+	for (uint8_t r=0; r<(this->sizeKpd).rows; r++) {
+		if (!gpio_get_level((gpio_num_t)((this->rowPins)[r]))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Private : row interrupts on (idle mode) or off (scanning)
+static void Keypad_setRowInterrupts(Keypad *this, bool enable) {
+	for (uint8_t r=0; r<(this->sizeKpd).rows; r++) {
+		if (enable) {
+			gpio_intr_enable((gpio_num_t)((this->rowPins)[r]));
+		} else {
+			gpio_intr_disable((gpio_num_t)((this->rowPins)[r]));
+		}
+	}
+}
+
+// Private : a row fell in idle mode. One wake is enough, the scan finds the key
+static void IRAM_ATTR Keypad_rowIsr(void *arg) {
+	Keypad *this = (Keypad *)arg;
+	Keypad_setRowInterrupts(this, false);
+	xSemaphoreGiveFromISR(this->rowEvent, NULL);
+}
+
 /**
  * -------------------------------------------------
  * Public API
@@ -204,22 +236,30 @@ void Keypad_init(Keypad *this, char *userKeymap, uint8_t *row, uint8_t *col,
 		Key_init(&(this->key[i]));
 	}
 
-	// Initialize pin GPIO - rows (input)
+	// Initialize pin GPIO - rows (input, falling edge interrupt armed only in
+	// idle mode)
 	gpio_config_t io_conf;
-	io_conf.intr_type = (gpio_int_type_t)GPIO_PIN_INTR_DISABLE;
+	io_conf.intr_type = (gpio_int_type_t)GPIO_PIN_INTR_NEGEDGE;
 	io_conf.pin_bit_mask = GPIO_INPUT_PIN_SEL;
 	io_conf.mode = GPIO_MODE_INPUT;
 	//io_conf.pull_up_en = (gpio_pullup_t)1;
 	//io_conf.pull_down_en = (gpio_pulldown_t)0;
 	gpio_config(&io_conf);
+	Keypad_setRowInterrupts(this, false);
+	this->rowEvent = xSemaphoreCreateBinary();
+	for (uint8_t r=0; r<numRows; r++) {
+		gpio_isr_handler_add((gpio_num_t)(row[r]), Keypad_rowIsr, this);
+	}
 
-	// Initialize pin GPIO - cols (output - start input, turn output when checking)
+	// Initialize pin GPIO - cols (open drain output with pull-up: low drives
+	// the column, high releases it)
 	gpio_config_t io_conf2;
     io_conf2.intr_type = (gpio_int_type_t)GPIO_PIN_INTR_DISABLE;
-    io_conf2.mode = GPIO_MODE_INPUT;
+    io_conf2.mode = GPIO_MODE_INPUT_OUTPUT_OD;
     io_conf2.pin_bit_mask = GPIO_OUTPUT_PIN_SEL;
     io_conf2.pull_up_en = (gpio_pullup_t)1;
     gpio_config(&io_conf2);
+    Keypad_setColumns(this, 1);
 }
 
 // Returns a single key only. Retained for backwards compatibility.
@@ -248,6 +288,39 @@ bool Keypad_getKeys(Keypad *this) {
 	return keyActivity;
 }
 
+// True while no key is down or still on its way to IDLE, so scanning can stop.
+bool Keypad_isIdle(Keypad *this) {
+	for (uint8_t r=0; r<(this->sizeKpd).rows; r++) {
+		if ((this->bitMap)[r]) {
+			return false;
+		}
+	}
+	for (uint8_t i=0; i<LIST_MAX; i++) {
+		if ((this->key)[i].kstate != IDLE) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Idle mode: all columns low, so any key pulls its row low and interrupts.
+// Blocks until then, and leaves the keypad ready to scan again.
+bool Keypad_waitForPress(Keypad *this, TickType_t ticks) {
+	Keypad_setColumns(this, 0);
+	xSemaphoreTake(this->rowEvent, 0);	// Drop a wake left from the last press.
+	Keypad_setRowInterrupts(this, true);
+
+	// A key already down made no edge.
+	bool pressed = Keypad_anyRowLow(this);
+	if (!pressed) {
+		pressed = (xSemaphoreTake(this->rowEvent, ticks) == pdTRUE);
+	}
+
+	Keypad_setRowInterrupts(this, false);
+	Keypad_setColumns(this, 1);
+	return pressed;
+}
+
 // Backwards compatibility function.
 KeyState Keypad_getState(Keypad *this) {
 	return (this->key)[0].kstate;
@@ -34,6 +34,7 @@
 #define KEYPAD_H
 
 #include "Key.h"
+#include "freertos/semphr.h"
 
 #define OPEN false
 #define CLOSED true
@@ -70,10 +71,11 @@ typedef struct Keypad {
 	uint holdTime;
 	bool single_key;
 	void (*keypadEventListener)(char);
+	SemaphoreHandle_t rowEvent;	// given by a row interrupt in idle mode
 } Keypad;
 
 /**
- * @brief initialize interface, must call first
+ * @brief initialize interface, must call first. After gpio_install_isr_service
  * @param userKeymap ROW x COL array of keypad characters
  * @param row GPIO row pins
  * @param col GPIO col pins
@@ -97,6 +99,22 @@ bool Keypad_getKeys(Keypad *this);
 
 //KeyState getState();
 
+/**
+ * @brief No key down and none still on its way to IDLE: scanning can stop
+ *        until Keypad_waitForPress returns
+ * @retval true if idle
+ */
+bool Keypad_isIdle(Keypad *this);
+
+/**
+ * @brief Idle mode: drive every column low and block until a row interrupt
+ *        says a key went down, instead of scanning. Returns at once if a key
+ *        is already down
+ * @param ticks how long to wait
+ * @retval true if a key went down, false on timeout
+ */
+bool Keypad_waitForPress(Keypad *this, TickType_t ticks);
+
 /**
  * @brief Backwards compatibility function.
  * @retval state of button press
@@ -0,0 +1,208 @@
+#include "R502Async.h"
+
+// One queued command, as seen by the driver task
+typedef struct R502_async_job_t {
+    R502_async_req_t req;
+    R502_async_cb_t cb;
+    QueueHandle_t done_queue;
+    void *ctx;
+    R502_async_handle_t handle;
+    bool stop;                      // ask the driver task to exit
+} R502_async_job_t;
+
+static portMUX_TYPE async_handle_mux = portMUX_INITIALIZER_UNLOCKED;
+
+// Private functions
+
+static void async_run(R502Interface *this, const R502_async_req_t *req,
+    R502_async_result_t *result)
+{
+    switch(req->cmd){
+        case R502_async_gen_image:
+            result->err = R502_gen_image(this, &result->res);
+            break;
+        case R502_async_img_2_tz:
+            result->err = R502_img_2_tz(this, req->buffer_id, &result->res);
+            break;
+        case R502_async_reg_model:
+            result->err = R502_reg_model(this, &result->res);
+            break;
+        case R502_async_store:
+            result->err = R502_store(this, req->buffer_id, req->page_id, &result->res);
+            break;
+        case R502_async_delet_char:
+            result->err = R502_delet_char(this, req->page_id, req->count, &result->res);
+            break;
+        case R502_async_search:
+            result->err = R502_search(this, req->buffer_id, req->page_id, req->count,
+                &result->res, &result->page_id, &result->match_score);
+            break;
+        case R502_async_template_num:
+            result->err = R502_template_num(this, &result->res, &result->page_id);
+            break;
+        case R502_async_led_config:
+            result->err = R502_led_config(this, req->led_ctrl, req->led_speed,
+                req->led_color, req->count, &result->res);
+            break;
+        default:
+            ESP_LOGE(this->TAG, "async: unknown command %d", req->cmd);
+            result->err = ESP_ERR_INVALID_ARG;
+            break;
+    }
+}
+
+static void async_complete(R502Interface *this, const R502_async_job_t *job,
+    R502_async_result_t *result)
+{
+    if(job->cb){
+        job->cb(result);
+    }
+    // Never block the driver task on a slow consumer
+    if(job->done_queue && xQueueSend(job->done_queue, result, 0) != pdTRUE){
+        ESP_LOGE(this->TAG, "async: done queue full, result of %u dropped", 
+            (unsigned)job->handle);
+    }
+}
+
+static void async_task(void *arg)
+{
+    R502Interface *this = (R502Interface *)arg;
+    R502_async_job_t job;
+    TaskHandle_t stopper = NULL;
+
+    while(1){
+        xQueueReceive(this->async_queue, &job, portMAX_DELAY);
+        if(job.stop){
+            // The drain below reuses job
+            stopper = (TaskHandle_t)job.ctx;
+            break;
+        }
+
+        R502_async_result_t result = {
+            .handle = job.handle,
+            .cmd = job.req.cmd,
+            .err = ESP_OK,
+            .res = R502_ok,
+            .ctx = job.ctx
+        };
+        R502_lock(this, portMAX_DELAY);
+        async_run(this, &job.req, &result);
+        R502_unlock(this);
+        async_complete(this, &job, &result);
+    }
+
+    // Fail what was queued behind the stop request
+    while(xQueueReceive(this->async_queue, &job, 0) == pdTRUE){
+        R502_async_result_t result = {
+            .handle = job.handle,
+            .cmd = job.req.cmd,
+            .err = ESP_ERR_INVALID_STATE,
+            .ctx = job.ctx
+        };
+        if(!job.stop) async_complete(this, &job, &result);
+    }
+
+    xTaskNotifyGive(stopper);
+    vTaskDelete(NULL);
+}
+
+// Public API
+
+esp_err_t R502_async_start(R502Interface *this, UBaseType_t priority)
+{
+    if(!this->initialized){
+        return ESP_ERR_INVALID_STATE;
+    }
+    if(this->async_task){
+        return ESP_OK;
+    }
+
+    this->async_queue = xQueueCreate(R502_ASYNC_QUEUE_SIZE, sizeof(R502_async_job_t));
+    if(!this->async_queue){
+        return ESP_ERR_NO_MEM;
+    }
+    TaskHandle_t task;
+    if(xTaskCreate(async_task, "R502_async", R502_ASYNC_STACK_SIZE, this, priority,
+        &task) != pdPASS)
+    {
+        vQueueDelete(this->async_queue);
+        this->async_queue = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    portENTER_CRITICAL(&async_handle_mux);
+    this->async_task = task;
+    portEXIT_CRITICAL(&async_handle_mux);
+    return ESP_OK;
+}
+
+esp_err_t R502_async_stop(R502Interface *this)
+{
+    // Refuse new submissions
+    portENTER_CRITICAL(&async_handle_mux);
+    bool running = (this->async_task != NULL);
+    this->async_task = NULL;
+    portEXIT_CRITICAL(&async_handle_mux);
+    if(!running){
+        return ESP_OK;
+    }
+
+    // Submissions already past the check queue ahead of the stop request,
+    // never behind it into a deleted queue
+    while(1){
+        portENTER_CRITICAL(&async_handle_mux);
+        int submitters = this->async_submitters;
+        portEXIT_CRITICAL(&async_handle_mux);
+        if(submitters == 0) break;
+        vTaskDelay(1);
+    }
+
+    // Then wait for the driver task to exit
+    R502_async_job_t job = {
+        .stop = true,
+        .ctx = xTaskGetCurrentTaskHandle()
+    };
+    xQueueSend(this->async_queue, &job, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    vQueueDelete(this->async_queue);
+    this->async_queue = NULL;
+    return ESP_OK;
+}
+
+esp_err_t R502_async_submit(R502Interface *this, const R502_async_req_t *req,
+    R502_async_cb_t cb, QueueHandle_t done_queue, void *ctx,
+    R502_async_handle_t *handle, TickType_t wait_ticks)
+{
+    R502_async_job_t job = {
+        .req = *req,
+        .cb = cb,
+        .done_queue = done_queue,
+        .ctx = ctx,
+        .stop = false
+    };
+
+    // Counted as a submitter until queued, so R502_async_stop waits for it
+    portENTER_CRITICAL(&async_handle_mux);
+    bool running = (this->async_task != NULL);
+    if(running){
+        this->async_submitters++;
+        job.handle = ++this->async_next_handle;
+    }
+    portEXIT_CRITICAL(&async_handle_mux);
+    if(!running){
+        ESP_LOGE(this->TAG, "async: driver task not started");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    BaseType_t queued = xQueueSend(this->async_queue, &job, wait_ticks);
+    portENTER_CRITICAL(&async_handle_mux);
+    this->async_submitters--;
+    portEXIT_CRITICAL(&async_handle_mux);
+    if(queued != pdTRUE){
+        return ESP_ERR_TIMEOUT;
+    }
+    if(handle){
+        *handle = job.handle;
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "R502Checksum.h"
+
+// A 16 bit lane holds 257 bytes of 0xff, flush the lanes before that
+#define LANE_FLUSH_WORDS 256
+
+/**
+ * \brief Shared body of R502_checksum and R502_checksum_copy. dst is NULL
+ * for no copy; both callers pass a constant so the branch folds away
+ */
+static inline uint16_t checksum_words(uint32_t sum, uint8_t *dst, const uint8_t *src,
+    size_t len)
+{
+    // 1: bytes up to a word boundary of src
+    while(len > 0 && ((uintptr_t)src & 3)){
+        sum += *src;
+        if(dst) *dst++ = *src;
+        src++;
+        len--;
+    }
+
+    // 2: whole words, bytes 0 and 2 in one pair of lanes, 1 and 3 in another
+    while(len >= 4){
+        size_t words = len / 4;
+        if(words > LANE_FLUSH_WORDS) words = LANE_FLUSH_WORDS;
+        uint32_t even = 0;
+        uint32_t odd = 0;
+        for(size_t i = 0; i < words; i++){
+            uint32_t word;
+            memcpy(&word, __builtin_assume_aligned(src, 4), 4);
+            even += word & 0x00ff00ff;
+            odd += (word >> 8) & 0x00ff00ff;
+            if(dst){
+                memcpy(dst, &word, 4);
+                dst += 4;
+            }
+            src += 4;
+        }
+        sum += (even & 0xffff) + (even >> 16) + (odd & 0xffff) + (odd >> 16);
+        len -= words * 4;
+    }
+
+    // 3: remaining bytes
+    while(len > 0){
+        sum += *src;
+        if(dst) *dst++ = *src;
+        src++;
+        len--;
+    }
+    return sum & 0xffff;
+}
+
+uint16_t R502_checksum(uint16_t sum, const uint8_t *data, size_t len)
+{
+    return checksum_words(sum, NULL, data, len);
+}
+
+uint16_t R502_checksum_copy(uint16_t sum, uint8_t *dst, const uint8_t *src, size_t len)
+{
+    return checksum_words(sum, dst, src, len);
+}
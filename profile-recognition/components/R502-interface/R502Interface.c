@@ -1,19 +1,246 @@
 #include "R502Interface.h"
+#include "R502Async.h"
+#include "R502Checksum.h"
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
-uint8_t data_cb_buffer[R502_MAX_DATA_LEN];
+// Private function declarations
+
+/**
+ * \brief Set system parameters baud rate, security level, and 
+ * data package length
+ * \param parameter_num Select which parameter to be set
+ * \param value The value to set the parameter to
+ * \param res OUT confirmation code provided by the R502
+ * \retval See vfy_pass for description of all possible return values
+ * 
+ * Set to private and broken out to three public methods instead
+ *  Parameter Num       | Value Meaning
+ *  ------------------- | -----------------------------------------------
+ *  Baud Control        | N=[1,2,4,6,12]. Baud rate = N*9600 
+ *  Security Level      | [1,2,3,4,5]. At 1 FAR is high, at 5 FRR is high
+ *  Data Package Length | [0,1,2,3] corresponds to 32, 64, 128, 256 bytes
+ */
+static esp_err_t set_sys_para(R502Interface *this, R502_para_num parameter_num, int value, 
+    R502_conf_code_t *res);
+
+/**
+ * \brief The bodies of the public calls that take more than one exchange
+ * with the module. Those take R502_lock around them, so the exchanges are
+ * not interleaved with another task's
+ */
+static esp_err_t set_baud_rate(R502Interface *this, R502_baud_t baud, 
+    R502_conf_code_t *res);
+static esp_err_t set_data_package_length(R502Interface *this, 
+    R502_data_len_t data_length, R502_conf_code_t *res);
+static esp_err_t up_char(R502Interface *this, uint8_t buffer_id, 
+    R502_conf_code_t *res);
+static esp_err_t up_char_into(R502Interface *this, uint8_t buffer_id, uint8_t *dest,
+    int dest_len, int *received_len, R502_conf_code_t *res);
+static esp_err_t down_char(R502Interface *this, uint8_t buffer_id, 
+    uint8_t * char_data, R502_conf_code_t *res);
+
+/**
+ * \brief Send a command to the module, and read its acknowledgement
+ * \param pkg data to send
+ * \param receivePkg OUT package to read response data into
+ * \param data_rec_length number of data bytes to receive into
+ * receivePkg.data
+ * \param read_delay_ms Max number of ms to wait for a response
+ * Holds R502_lock for the exchange, so every single command call is safe
+ * alongside the R502Async driver task
+ * \retval ESP_OK: successful
+ *         ESP_ERR_INVALID_STATE: Error sending or recieving via UART,
+ *         or interface not initialized
+ *         ESP_ERR_INVALID_SIZE: Not all data was sent out
+ *         ESP_ERR_NOT_FOUND: No response from the module
+             ESP_ERR_INVALID_RESPONSE: Not enough bytes received
+            ESP_ERR_INVALID_CRC: Response had failed CRC
+    */
+static esp_err_t send_command_package(R502Interface *this, const R502_DataPkg_t *pkg,
+    R502_DataPkg_t *receivePkg, int data_rec_length, 
+    int read_delay_ms);
+
+/**
+ * \brief Send a filled package to the module
+ * \param pkg A filled package, depends on length being filled
+ * \retval ESP_OK: successful
+             ESP_ERR_INVALID_ARG: Package length not set correctly
+    *         ESP_ERR_INVALID_STATE: Error sending or recieving via UART
+    *         ESP_ERR_INVALID_SIZE: Not all data was sent out
+    */
+static esp_err_t send_package(R502Interface *this, const R502_DataPkg_t *pkg);
+
+/**
+ * \brief Receive a package from the module
+ * \param rec_pkg OUT Package to be filled
+ * \param data_length Expected amount of data to be read
+ * \param read_delay_ms Max number of ms to wait for a response
+ * Frames the package as bytes arrive (start code, header, then the length
+ * announced by the header) and returns as soon as it is complete. Waits on
+ * the UART event queue in between, so no time is spent polling.
+ * An ack shorter than data_length is accepted if it carries an error
+ * confirmation code; the missing bytes are zeroed.
+ * \retval ESP_OK: successful
+ *         ESP_ERR_INVALID_STATE: Error sending or recieving via UART
+ *         ESP_ERR_NOT_FOUND: No data was received
+ *         ESP_ERR_INVALID_RESPONSE: Incomplete, overflowed or unexpected package
+ *         ESP_ERR_INVALID_CRC: Response had failed CRC
+ */
+static esp_err_t receive_package(R502Interface *this, const R502_DataPkg_t *rec_pkg, 
+    int data_length, int read_delay_ms);
+
+/**
+ * \brief Receive a data package, placing its payload directly in dest
+ * \param hdr OUT header of the package (data is not filled)
+ * \param dest OUT where to put the payload
+ * \param dest_len room in dest
+ * \param data_len OUT number of payload bytes received
+ * \param read_delay_ms Max number of ms to wait for the package
+ * The checksum is verified over the payload in dest, no copy is made
+ * \retval See receive_package.
+ *         ESP_ERR_INVALID_SIZE: payload larger than dest_len
+ */
+static esp_err_t receive_data_package(R502Interface *this, R502_DataPkg_t *hdr,
+    uint8_t *dest, int dest_len, int *data_len, int read_delay_ms);
+
+/**
+ * \brief Read exactly len bytes, sleeping on the UART event queue while
+ * none are buffered
+ * \param deadline esp_timer time to give up at
+ * \param received OUT set if any byte was read
+ * \retval ESP_OK, ESP_ERR_TIMEOUT, ESP_ERR_INVALID_RESPONSE on rx overflow,
+ *         ESP_ERR_INVALID_STATE on driver error
+ */
+static esp_err_t read_exact(R502Interface *this, uint8_t *dst, int len,
+    int64_t deadline, bool *received);
+
+/**
+ * \brief Sync on the start code and read a package header
+ */
+static esp_err_t receive_header(R502Interface *this, R502_DataPkg_t *hdr,
+    int64_t deadline, bool *received);
+
+/**
+ * \brief Map a read_exact/receive_header error to the receive_package return
+ * values, flushing the input when a package was cut short
+ */
+static esp_err_t receive_error(R502Interface *this, esp_err_t err, bool received);
+
+/**
+ * \brief Serialize a template into consecutive data packages (header, payload
+ * and checksum each), the last one marked end of data
+ * \param tx_buf OUT at least R502_DOWN_CHAR_TX_SIZE bytes
+ * \param data_len_i payload bytes per package
+ * \param length value of each package's length field
+ * \retval number of bytes written to tx_buf
+ */
+static int encode_data_packages(R502Interface *this, uint8_t *tx_buf,
+    const uint8_t *char_data, int char_data_length, int data_len_i, uint16_t length);
+
+/**
+ * \brief Write raw bytes to the module in a single driver call
+ * \retval See send_package
+ */
+static esp_err_t send_bytes(R502Interface *this, const uint8_t *tx_buf, int tx_len);
+
+/**
+ * \brief Fill sys_para from a ReadSysPara ack. If the ack is ok, also
+ * track the data package length in cur_data_pkg_len
+ */
+static void parse_sys_para(R502Interface *this, const R502_ReadSysParaAck_t *ack,
+    R502_sys_para_t *sys_para);
+
+/**
+ * \brief Switch the UART to baud and check the module answers there, with
+ * a ReadSysPara
+ * \param sys_para OUT the module's parameters, if it answered
+ * \retval ESP_OK if it does, else the error of the probe command
+ */
+static esp_err_t probe_baud(R502Interface *this, R502_baud_t baud, 
+    R502_sys_para_t *sys_para);
+
+/**
+ * \brief Probe first, then every rate from fastest to slowest
+ * \param sys_para OUT the module's parameters, from the probe that answered
+ * \retval the rate the module answered at, the UART left there, or 0
+ */
+static R502_baud_t sweep_baud(R502Interface *this, R502_baud_t first,
+    R502_sys_para_t *sys_para);
+
+/**
+ * \brief Find the module's baud rate by probing, then move it to
+ * R502_BAUD_FASTEST. If it does not answer there after the switch, sweep
+ * again for wherever it ended up.
+ * Leaves cur_baud and the UART at the rate in use
+ * \retval ESP_OK: module found
+ *         ESP_ERR_NOT_FOUND: module did not answer at any rate
+ */
+static esp_err_t negotiate_baud(R502Interface *this);
+
+/**
+ * \brief Payload bytes per data package for a data_package_length setting
+ * \retval 32 to 256, or 0 if data_len is not a valid R502_data_len_t
+ */
+static int data_len_bytes(R502_data_len_t data_len);
+
+/**
+ * \brief Read delay for one data package of cur_data_pkg_len: the default
+ * delay plus its time on the wire, which at 9600 baud is longer than the
+ * default delay on its own
+ */
+static int data_read_delay(R502Interface *this);
+
+static void set_headers(R502Interface *this, R502_DataPkg_t *package, R502_pid_t pid,
+    uint16_t length);
+
+static void fill_checksum(R502_DataPkg_t *package);
+
+static bool verify_checksum(const R502_DataPkg_t *package);
+
+/**
+ * \brief Verify the header fields of the package are correct
+ * \param pkg package to verify
+ * \param length Expected value of length field
+ * \retval ESP_OK: successful
+ *         ESP_ERR_INVALID_RESPONSE: package header is incorrect
+ */
+static esp_err_t verify_headers(R502Interface *this, const R502_DataPkg_t *pkg, uint16_t length);
+
+/**
+ * \brief Return the total number of bytes in a filled package
+ * \param pkg Package to measure
+ * This uses the filled length parameter, so it doesn't need to know what
+ * type of package data it is. But length needs to be properly filled before
+ * calling
+ * Includes start, adder, pid, length, data and checksum bytes
+ */
+static uint16_t package_length(const R502_DataPkg_t *pkg);
+
+static uint16_t conv_8_to_16(const uint8_t in[2]);
+static void conv_16_to_8(const uint16_t in, uint8_t out[2]);
 
 // Private functions
 
 static esp_err_t send_command_package(R502Interface *this, const R502_DataPkg_t *pkg,
     R502_DataPkg_t *receive_pkg, int data_rec_length, int read_delay_ms)
 {
-    esp_err_t err = send_package(this, pkg);
+    esp_err_t err = R502_lock(this, portMAX_DELAY);
     if(err) return err;
-    return receive_package(this, receive_pkg, data_rec_length + this->header_size, 
-        read_delay_ms);
+
+    // Bytes left over from an earlier exchange, like the rest of a transfer
+    // that failed part way, would be taken for the reply. Their events would
+    // only cause spurious wakeups
+    uart_flush_input(this->uart_num);
+    xQueueReset(this->uart_queue);
+    err = send_package(this, pkg);
+    if(!err){
+        err = receive_package(this, receive_pkg, data_rec_length + this->header_size, 
+            read_delay_ms);
+    }
+    R502_unlock(this);
+    return err;
 }
 
 
@@ -51,30 +278,107 @@ static esp_err_t send_package(R502Interface *this, const R502_DataPkg_t *pkg)
     return ESP_OK;
 }
 
-static esp_err_t receive_package(R502Interface *this, const R502_DataPkg_t *rec_pkg,
-    int data_length, int read_delay_ms)
+static esp_err_t read_exact(R502Interface *this, uint8_t *dst, int len,
+    int64_t deadline, bool *received)
 {
-    int len = uart_read_bytes(this->uart_num, (uint8_t *)rec_pkg, data_length,
-        read_delay_ms / portTICK_RATE_MS);
-    
-    //ESP_LOGI(this->TAG, "received %d bytes", len);
+    int got = 0;
+    while(got < len){
+        size_t buffered = 0;
+        uart_get_buffered_data_len(this->uart_num, &buffered);
+        if(buffered == 0){
+            // Sleep until the driver reports more data, or the deadline
+            int64_t remaining_ms = (deadline - esp_timer_get_time() + 999) / 1000;
+            uart_event_t event;
+            if(remaining_ms <= 0 || xQueueReceive(this->uart_queue, &event,
+                (remaining_ms + portTICK_RATE_MS - 1) / portTICK_RATE_MS) != pdTRUE)
+            {
+                return ESP_ERR_TIMEOUT;
+            }
+            if(event.type == UART_FIFO_OVF || event.type == UART_BUFFER_FULL){
+                ESP_LOGE(this->TAG, "uart read error, rx overflow");
+                uart_flush_input(this->uart_num);
+                xQueueReset(this->uart_queue);
+                return ESP_ERR_INVALID_RESPONSE;
+            }
+            continue;
+        }
+        *received = true;
 
-    if(len == -1){
-        ESP_LOGE(this->TAG, "uart read error, parameter error");
-        return ESP_ERR_INVALID_STATE;
+        int n = uart_read_bytes(this->uart_num, dst + got, MIN(len - got, (int)buffered), 0);
+        if(n < 0){
+            ESP_LOGE(this->TAG, "uart read error, parameter error");
+            return ESP_ERR_INVALID_STATE;
+        }
+        got += n;
     }
-    else if(len == 0){
-        ESP_LOGE(this->TAG, "uart read error, R502 not found");
-        return ESP_ERR_NOT_FOUND;
+    return ESP_OK;
+}
+
+static esp_err_t receive_header(R502Interface *this, R502_DataPkg_t *hdr,
+    int64_t deadline, bool *received)
+{
+    uint8_t *buf = (uint8_t *)hdr;
+    int start_len = sizeof(this->start);
+    int len = 0;
+
+    // Hunt for the start code a byte at a time, dropping noise
+    while(len < start_len){
+        esp_err_t err = read_exact(this, buf + len, 1, deadline, received);
+        if(err) return err;
+        if(buf[len] == this->start[len]){
+            len++;
+        }
+        else{
+            len = (buf[len] == this->start[0]) ? 1 : 0;
+            buf[0] = this->start[0];
+        }
     }
-    // This check is uncesseccary, it'll probably fail the crc cause it doesn't
-    // write data into the last crc byte if this is the case
-    else if(len < data_length){
-        ESP_LOGE(this->TAG, "uart read error, not enough bytes read, %d < %d", 
-            len, data_length);
-        uart_flush(this->uart_num);
+    return read_exact(this, buf + len, this->header_size - len, deadline, received);
+}
+
+static esp_err_t receive_error(R502Interface *this, esp_err_t err, bool received)
+{
+    if(err == ESP_ERR_TIMEOUT){
+        if(!received){
+            ESP_LOGE(this->TAG, "uart read error, R502 not found");
+            return ESP_ERR_NOT_FOUND;
+        }
+        ESP_LOGE(this->TAG, "uart read error, not enough bytes read");
+        uart_flush_input(this->uart_num);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return err;
+}
+
+static esp_err_t receive_package(R502Interface *this, const R502_DataPkg_t *rec_pkg,
+    int data_length, int read_delay_ms)
+{
+    R502_DataPkg_t *pkg = (R502_DataPkg_t *)rec_pkg;
+    uint8_t *buf = (uint8_t *)rec_pkg;
+    bool received = false;
+    int64_t deadline = esp_timer_get_time() + (int64_t)read_delay_ms * 1000;
+
+    // Header first, then exactly the number of bytes its length field announces
+    esp_err_t err = receive_header(this, pkg, deadline, &received);
+    if(err) return receive_error(this, err, received);
+
+    int len = this->header_size + conv_8_to_16(rec_pkg->length);
+    if(conv_8_to_16(rec_pkg->length) < R502_cs_len){
+        ESP_LOGE(this->TAG, "uart read error, length %d has no room for the checksum", 
+            conv_8_to_16(rec_pkg->length));
+        uart_flush_input(this->uart_num);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    if(len > sizeof(R502_DataPkg_t)){
+        ESP_LOGE(this->TAG, "uart read error, frame too long, %d bytes", len);
+        uart_flush_input(this->uart_num);
         return ESP_ERR_INVALID_RESPONSE;
     }
+    err = read_exact(this, buf + this->header_size, len - this->header_size, 
+        deadline, &received);
+    if(err) return receive_error(this, err, received);
+
+    //ESP_LOGI(this->TAG, "received %d bytes", len);
 
     //printf("response Data\n");
     //int printed = 0;
@@ -89,31 +393,220 @@ static esp_err_t receive_package(R502Interface *this, const R502_DataPkg_t *rec_
     // Verify response
     if(!verify_checksum(rec_pkg)){
         ESP_LOGE(this->TAG, "uart read error, invalid CRC"); 
-        uart_flush(this->uart_num);
+        uart_flush_input(this->uart_num);
         return ESP_ERR_INVALID_CRC;
     }
-    esp_err_t err = verify_headers(this, rec_pkg, len - this->header_size);
+    err = verify_headers(this, rec_pkg, len - this->header_size);
     if(err){
-        uart_flush(this->uart_num);
+        uart_flush_input(this->uart_num);
+        return err;
     }
-    return err;
+
+    // The module answers failed commands with a bare confirmation code. Pass
+    // that on, with the missing fields zeroed, instead of rejecting it
+    if(len != data_length){
+        if(len < data_length && rec_pkg->pid == R502_pid_ack && 
+            rec_pkg->data.general_ack.conf_code != R502_ok)
+        {
+            memset(buf + len, 0, data_length - len);
+            return ESP_OK;
+        }
+        ESP_LOGE(this->TAG, "uart read error, unexpected length, %d vs %d", 
+            len, data_length);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ESP_OK;
 }
 
-static void busy_delay(int64_t microseconds)
+static esp_err_t receive_data_package(R502Interface *this, R502_DataPkg_t *hdr,
+    uint8_t *dest, int dest_len, int *data_len, int read_delay_ms)
 {
-    // wait
-    int64_t time_start = esp_timer_get_time();
-    while(esp_timer_get_time() < time_start + microseconds);
+    bool received = false;
+    int64_t deadline = esp_timer_get_time() + (int64_t)read_delay_ms * 1000;
+    uint8_t checksum[R502_cs_len];
+
+    esp_err_t err = receive_header(this, hdr, deadline, &received);
+    if(err) return receive_error(this, err, received);
+
+    // Payload straight into dest, checksum aside so it never lands past it
+    int len = conv_8_to_16(hdr->length) - R502_cs_len;
+    if(len < 0 || len > dest_len){
+        ESP_LOGE(this->TAG, "uart read error, %d data bytes do not fit in %d", 
+            len, dest_len);
+        uart_flush_input(this->uart_num);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    err = read_exact(this, dest, len, deadline, &received);
+    if(!err) err = read_exact(this, checksum, R502_cs_len, deadline, &received);
+    if(err) return receive_error(this, err, received);
+
+    // Verify response in place
+    uint16_t sum = R502_checksum(hdr->pid + hdr->length[0] + hdr->length[1], 
+        dest, len);
+    if(sum != conv_8_to_16(checksum)){
+        ESP_LOGE(this->TAG, "uart read error, invalid CRC"); 
+        uart_flush_input(this->uart_num);
+        return ESP_ERR_INVALID_CRC;
+    }
+    err = verify_headers(this, hdr, len + R502_cs_len);
+    if(err){
+        uart_flush_input(this->uart_num);
+        return err;
+    }
+
+    *data_len = len;
+    return ESP_OK;
+}
+
+static int encode_data_packages(R502Interface *this, uint8_t *tx_buf,
+    const uint8_t *char_data, int char_data_length, int data_len_i, uint16_t length)
+{
+    int packet_num = char_data_length / data_len_i;
+    int tx_len = 0;
+
+    for(int i = 1; i <= packet_num; i++){
+        // Packages are all uint8_t fields, so one can sit at any offset
+        R502_DataPkg_t *pkg = (R502_DataPkg_t *)(tx_buf + tx_len);
+        set_headers(this, pkg, (i == packet_num) ? R502_pid_end_of_data : R502_pid_data, 
+            length);
+        // Copy the payload and checksum it in one pass
+        uint8_t *content = pkg->data.data.content;
+        uint16_t sum = R502_checksum_copy(pkg->pid + pkg->length[0] + pkg->length[1], 
+            content, char_data + data_len_i * (i - 1), data_len_i);
+        content[data_len_i] = (sum >> 8) & 0xff;
+        content[data_len_i + 1] = sum & 0xff;
+        tx_len += package_length(pkg);
+    }
+    return tx_len;
+}
+
+static esp_err_t send_bytes(R502Interface *this, const uint8_t *tx_buf, int tx_len)
+{
+    int len = uart_write_bytes(this->uart_num, (const char *)tx_buf, tx_len);
+    if(len == -1){
+        ESP_LOGE(this->TAG, "uart write error, parameter error");
+        return ESP_ERR_INVALID_STATE;
+    }
+    else if(len != tx_len){
+        // not all data transferred
+        ESP_LOGE(this->TAG, "uart write error, wrong number of bytes written");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t probe_baud(R502Interface *this, R502_baud_t baud, 
+    R502_sys_para_t *sys_para)
+{
+    esp_err_t err = uart_set_baudrate(this->uart_num, 9600 * baud);
+    if(err) return err;
+    uart_flush_input(this->uart_num);
+
+    R502_DataPkg_t pkg;
+    R502_GeneralCommand_t *data = &pkg.data.general;
+    set_headers(this, &pkg, R502_pid_command, sizeof(R502_GeneralCommand_t));
+    data->instr_code = R502_ic_read_sys_para;
+    fill_checksum(&pkg);
+
+    R502_DataPkg_t receive_pkg;
+    R502_ReadSysParaAck_t *receive_data = &receive_pkg.data.read_sys_para_ack;
+    err = send_command_package(this, &pkg, &receive_pkg, 
+        sizeof(*receive_data), R502_PROBE_READ_DELAY);
+    if(err) return err;
+    if(receive_data->conf_code != R502_ok) return ESP_ERR_INVALID_RESPONSE;
+    parse_sys_para(this, receive_data, sys_para);
+    return ESP_OK;
+}
+
+static R502_baud_t sweep_baud(R502Interface *this, R502_baud_t first,
+    R502_sys_para_t *sys_para)
+{
+    const R502_baud_t rates[] = { first, R502_baud_115200, R502_baud_57600,
+        R502_baud_38400, R502_baud_19200, R502_baud_9600 };
+    for(int i = 0; i < sizeof(rates) / sizeof(rates[0]); i++){
+        if(i > 0 && rates[i] == rates[0]) continue;
+        if(probe_baud(this, rates[i], sys_para) == ESP_OK){
+            return rates[i];
+        }
+    }
+    return 0;
+}
+
+static esp_err_t negotiate_baud(R502Interface *this)
+{
+    // Caller's rate first (normally right), then fastest to slowest
+    R502_sys_para_t sys_para;
+    R502_baud_t found = sweep_baud(this, this->cur_baud, &sys_para);
+    if(!found){
+        ESP_LOGW(this->TAG, "module not found at any baud rate, staying at %d", 
+            9600 * this->cur_baud);
+        uart_set_baudrate(this->uart_num, 9600 * this->cur_baud);
+        return ESP_ERR_NOT_FOUND;
+    }
+    this->cur_baud = found;
+
+    // The probe was a ReadSysPara: no write if the setting is already there
+    if(found == R502_BAUD_FASTEST && sys_para.baud_setting == R502_BAUD_FASTEST){
+        ESP_LOGI(this->TAG, "module at %d baud", 9600 * found);
+        return ESP_OK;
+    }
+
+    // Upgrade, then check the module really answers at the new rate
+    R502_conf_code_t conf_code = R502_fail;
+    esp_err_t err = R502_set_baud_rate(this, R502_BAUD_FASTEST, &conf_code);
+    if(!err && conf_code == R502_ok && 
+        probe_baud(this, R502_BAUD_FASTEST, &sys_para) == ESP_OK)
+    {
+        ESP_LOGI(this->TAG, "module moved from %d to %d baud", 9600 * found, 
+            9600 * R502_BAUD_FASTEST);
+        return ESP_OK;
+    }
+
+    // The switch may have taken even if its ack or the probe got lost, so
+    // look for the module again rather than assume it stayed at found
+    R502_baud_t now = sweep_baud(this, R502_BAUD_FASTEST, &sys_para);
+    if(!now){
+        ESP_LOGW(this->TAG, "module lost moving from %d to %d baud", 
+            9600 * found, 9600 * R502_BAUD_FASTEST);
+        this->cur_baud = found;
+        uart_set_baudrate(this->uart_num, 9600 * this->cur_baud);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if(now != R502_BAUD_FASTEST){
+        ESP_LOGW(this->TAG, "could not move module to %d baud, staying at %d", 
+            9600 * R502_BAUD_FASTEST, 9600 * now);
+    }
+    this->cur_baud = now;
+    return ESP_OK;
+}
+
+static int data_len_bytes(R502_data_len_t data_len)
+{
+    switch(data_len){
+        case R502_data_len_32:
+        case R502_data_len_64:
+        case R502_data_len_128:
+        case R502_data_len_256:
+            return 32 << data_len;
+        default:
+            return 0;
+    }
+}
+
+static int data_read_delay(R502Interface *this)
+{
+    int pkg_len = this->header_size + this->cur_data_pkg_len + R502_cs_len;
+    return this->default_read_delay + pkg_len * 10 * 1000 / (9600 * this->cur_baud);
 }
 
 static void fill_checksum(R502_DataPkg_t *package)
 {
     int data_length = conv_8_to_16(package->length) - 2; // -2 for the 2 byte CS
-    int sum = package->pid + package->length[0] + package->length[1];
+    if(data_length < 0) return;
     uint8_t *itr = (uint8_t *)&(package->data);
-    for(int i = 0; i < data_length; i++){
-        sum += *itr++;
-    }
+    uint16_t sum = R502_checksum(package->pid + package->length[0] + 
+        package->length[1], itr, data_length);
+    itr += data_length;
     // Now itr is pointing to the first checksum byte
     *itr = (sum >> 8) & 0xff;
     *++itr = sum & 0xff;
@@ -122,15 +615,13 @@ static void fill_checksum(R502_DataPkg_t *package)
 static bool verify_checksum(const R502_DataPkg_t *package)
 {
     int data_length = conv_8_to_16(package->length) - 2; // -2 for the 2 byte CS
-    int sum = package->pid + package->length[0] + package->length[1];
-    uint8_t *itr = (uint8_t *)&(package->data);
-    for(int i = 0; i < data_length; i++){
-        sum += *itr++;
-    }
-    int checksum = *itr << 8;
-    checksum += *++itr;
+    if(data_length < 0) return false;
+    const uint8_t *itr = (const uint8_t *)&(package->data);
+    uint16_t sum = R502_checksum(package->pid + package->length[0] + 
+        package->length[1], itr, data_length);
+    itr += data_length;
 
-    return (sum == checksum);
+    return (sum == conv_8_to_16(itr));
 }
 
 static esp_err_t verify_headers(R502Interface *this, const R502_DataPkg_t *pkg, 
@@ -226,7 +717,8 @@ esp_err_t R502_init(R502Interface *this, uart_port_t _uart_num, gpio_num_t _pin_
     err = uart_set_pin(this->uart_num, this->pin_txd, this->pin_rxd, this->pin_rts, this->pin_cts);
     if(err) return err;
     err = uart_driver_install(this->uart_num, 
-        MAX(sizeof(R502_DataPkg_t), this->min_uart_buffer_size), 0, 0, NULL, 0);
+        MAX(sizeof(R502_DataPkg_t), this->min_uart_buffer_size), R502_UART_TX_BUFFER_SIZE, 
+        R502_UART_QUEUE_SIZE, &this->uart_queue, 0);
     if(err) return err;
 
     /* Configure parameters of a pin_isr interrupt,
@@ -245,18 +737,51 @@ esp_err_t R502_init(R502Interface *this, uart_port_t _uart_num, gpio_num_t _pin_
     gpio_isr_handler_add(this->pin_irq, gpio_isr_handler, (void*) this->pin_irq);
     if(err) return err;
 
+    if(!this->lock){
+        this->lock = xSemaphoreCreateRecursiveMutex();
+        if(!this->lock) return ESP_ERR_NO_MEM;
+    }
+    if(!this->tx_buf){
+        this->tx_buf = malloc(R502_DOWN_CHAR_TX_SIZE);
+        if(!this->tx_buf) return ESP_ERR_NO_MEM;
+    }
+
     // wait for R502 to prepare itself
     vTaskDelay(200 / portTICK_PERIOD_MS);
     this->initialized = true;
     this->interrupt = 0;
+
+    // Find the module's rate and move it to the fastest one. Not finding the
+    // module is not an init failure; commands will report ESP_ERR_NOT_FOUND
+    if(negotiate_baud(this) != ESP_OK) return ESP_OK;
+
+    // Largest data packages, fewest headers and turnarounds per template.
+    // negotiate_baud's ReadSysPara left the module's length in
+    // cur_data_pkg_len, so only write it when it differs. Whatever the
+    // module ends up at is tracked in cur_data_pkg_len
+    if(this->cur_data_pkg_len == data_len_bytes(R502_DATA_LEN_LARGEST)){
+        return ESP_OK;
+    }
+    R502_conf_code_t conf_code = R502_fail;
+    err = R502_set_data_package_length(this, R502_DATA_LEN_LARGEST, 
+        &conf_code);
+    if(err || conf_code != R502_ok){
+        ESP_LOGW(this->TAG, "could not set data package length to %d, using %d", 
+            data_len_bytes(R502_DATA_LEN_LARGEST), this->cur_data_pkg_len);
+    }
     return ESP_OK;
 }
 
 esp_err_t R502_deinit(R502Interface *this)
 {
     if(this->initialized){
+        R502_async_stop(this);
+        // Not out from under a blocking call in another task
+        R502_lock(this, portMAX_DELAY);
         this->initialized = false;
         esp_err_t err_uart_driver = uart_driver_delete(this->uart_num);
+        this->uart_queue = NULL;
+        R502_unlock(this);
         esp_err_t err_isr_remove = gpio_isr_handler_remove(this->pin_irq);
         gpio_uninstall_isr_service();
         if(err_uart_driver) return err_uart_driver;
@@ -270,6 +795,22 @@ esp_err_t R502_deinit(R502Interface *this)
     return ESP_OK;
 }
 
+esp_err_t R502_lock(R502Interface *this, TickType_t wait_ticks)
+{
+    if(!this->lock){
+        return ESP_ERR_INVALID_STATE;
+    }
+    return (xSemaphoreTakeRecursive(this->lock, wait_ticks) == pdTRUE) ? 
+        ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+void R502_unlock(R502Interface *this)
+{
+    if(this->lock){
+        xSemaphoreGiveRecursive(this->lock);
+    }
+}
+
 /*static void IRAM_ATTR irq_intr(void *arg)
 {
     R502Interface *me = (R502Interface *)arg;
@@ -378,43 +919,37 @@ static esp_err_t set_sys_para(R502Interface *this, R502_para_num parameter_num,
 }
 
 esp_err_t R502_set_baud_rate(R502Interface *this, R502_baud_t baud, R502_conf_code_t *res)
+{
+    esp_err_t err = R502_lock(this, portMAX_DELAY);
+    if(err) return err;
+    err = set_baud_rate(this, baud, res);
+    R502_unlock(this);
+    return err;
+}
+
+static esp_err_t set_baud_rate(R502Interface *this, R502_baud_t baud, 
+    R502_conf_code_t *res)
 {
     esp_err_t err = set_sys_para(this, R502_para_num_baud_control, baud, res);
     if(err){
         ESP_LOGE(this->TAG, "set_sys_para err %s", esp_err_to_name(err));
         return err;
     }
+    if(*res != R502_ok){
+        // Module refused, it is still at the old rate
+        return ESP_OK;
+    }
     // remember the current baud rate
     this->cur_baud = baud;
 
-    esp_err_t err_uart_driver = uart_driver_delete(this->uart_num);
-    if(err_uart_driver){
-        ESP_LOGE(this->TAG, "error deleting uart driver: %s",  
-            esp_err_to_name(err));
-    }
-    // Reinitialize with the new baud rate
-    uart_config_t uart_config = {
-        .baud_rate = 9600*baud,
-        .data_bits = UART_DATA_8_BITS,
-        .parity    = UART_PARITY_DISABLE,
-        .stop_bits = UART_STOP_BITS_1,
-        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .rx_flow_ctrl_thresh = 0,
-        .use_ref_tick = false
-    };
-    err = uart_param_config(this->uart_num, &uart_config);
-    if(err){
-        ESP_LOGE(this->TAG, "error reconfiguring uart baud rate: %s",  
-            esp_err_to_name(err));
-    }
-
-    err = uart_driver_install(this->uart_num, 
-        MAX(sizeof(R502_DataPkg_t), this->min_uart_buffer_size), 0, 0, NULL,
-        0);
+    // The ack came at the old rate; the module listens at the new one now
+    err = uart_set_baudrate(this->uart_num, 9600 * baud);
     if(err){
-        ESP_LOGE(this->TAG, "error installing uart driver: %s",  
+        ESP_LOGE(this->TAG, "error changing uart baud rate: %s",  
             esp_err_to_name(err));
+        return err;
     }
+    uart_flush_input(this->uart_num);
     return ESP_OK;
 }
 
@@ -429,8 +964,33 @@ esp_err_t R502_set_security_level(R502Interface *this, uint8_t security_level,
 esp_err_t R502_set_data_package_length(R502Interface *this, R502_data_len_t data_length,
     R502_conf_code_t *res)
 {
+    esp_err_t err = R502_lock(this, portMAX_DELAY);
+    if(err) return err;
+    err = set_data_package_length(this, data_length, res);
+    R502_unlock(this);
+    return err;
+}
+
+static esp_err_t set_data_package_length(R502Interface *this, 
+    R502_data_len_t data_length, R502_conf_code_t *res)
+{
+    if(!data_len_bytes(data_length)){
+        ESP_LOGE(this->TAG, "invalid data length, use enum");
+        return ESP_ERR_INVALID_ARG;
+    }
     esp_err_t err = set_sys_para(this, R502_para_num_data_pkg_len, data_length, res);
     if(err) return err;
+    if(*res != R502_ok) return ESP_OK;
+
+    // Some modules round the length up, so track what it really is now
+    R502_conf_code_t read_res = R502_fail;
+    R502_sys_para_t sys_para;
+    err = R502_read_sys_para(this, &read_res, &sys_para);
+    if(err) return err;
+    if(read_res != R502_ok){
+        ESP_LOGW(this->TAG, "could not read back data package length");
+        this->cur_data_pkg_len = data_len_bytes(data_length);
+    }
     return ESP_OK;
 }
 
@@ -454,21 +1014,29 @@ esp_err_t R502_read_sys_para(R502Interface *this, R502_conf_code_t *res,
 
     // Return result
     *res = (R502_conf_code_t)receive_data->conf_code;
+    parse_sys_para(this, receive_data, sys_para);
+    return ESP_OK;
+}
+
+static void parse_sys_para(R502Interface *this, const R502_ReadSysParaAck_t *ack,
+    R502_sys_para_t *sys_para)
+{
+    sys_para->status_register = conv_8_to_16(ack->data + 0);
+    sys_para->system_identifier_code = conv_8_to_16(ack->data + 2);
+    sys_para->finger_library_size = conv_8_to_16(ack->data + 4);
+    sys_para->security_level = conv_8_to_16(ack->data + 6);
+    memcpy(sys_para->device_address, ack->data+8, 4);
+    sys_para->data_package_length = (R502_data_len_t)conv_8_to_16(ack->data + 12);
+    sys_para->baud_setting = (R502_baud_t)conv_8_to_16(ack->data + 14);
 
     if(sys_para->system_identifier_code != this->system_identifier_code){
         ESP_LOGW(this->TAG, "sys_para system identifier is %d not %d", 
             sys_para->system_identifier_code, this->system_identifier_code);
     }
 
-    sys_para->status_register = conv_8_to_16(receive_data->data + 0);
-    sys_para->system_identifier_code = conv_8_to_16(receive_data->data + 2);
-    sys_para->finger_library_size = conv_8_to_16(receive_data->data + 4);
-    sys_para->security_level = conv_8_to_16(receive_data->data + 6);
-    memcpy(sys_para->device_address, receive_data->data+8, 4);
-    sys_para->data_package_length = (R502_data_len_t)conv_8_to_16(receive_data->data + 12);
-    sys_para->baud_setting = (R502_baud_t)conv_8_to_16(receive_data->data + 14);
-
-    return ESP_OK;
+    if(ack->conf_code == R502_ok && data_len_bytes(sys_para->data_package_length)){
+        this->cur_data_pkg_len = data_len_bytes(sys_para->data_package_length);
+    }
 }
 
 esp_err_t R502_template_num(R502Interface *this, R502_conf_code_t *res, 
@@ -496,6 +1064,32 @@ esp_err_t R502_template_num(R502Interface *this, R502_conf_code_t *res,
     return ESP_OK;
 }
 
+esp_err_t R502_read_index_table(R502Interface *this, uint8_t index_page,
+    R502_conf_code_t *res, uint8_t table[R502_INDEX_TABLE_LEN])
+{
+    R502_DataPkg_t pkg;
+    R502_ReadIndexTable_t *data = &pkg.data.read_index_table;
+
+    // Fill package
+    set_headers(this, &pkg, R502_pid_command, sizeof(R502_ReadIndexTable_t));
+    data->instr_code = R502_ic_read_index_table;
+    data->index_page = index_page;
+    fill_checksum(&pkg);
+
+    // Send package, get response
+    R502_DataPkg_t receive_pkg;
+    R502_ReadIndexTableAck_t *receive_data = &receive_pkg.data.read_index_table_ack;
+    esp_err_t err = send_command_package(this, &pkg, &receive_pkg, 
+        sizeof(*receive_data), this->default_read_delay);
+    if(err) return err;
+
+    // Return result
+    *res = (R502_conf_code_t)receive_data->conf_code;
+    memcpy(table, receive_data->index, R502_INDEX_TABLE_LEN);
+
+    return ESP_OK;
+}
+
 esp_err_t R502_gen_image(R502Interface *this, R502_conf_code_t *res)
 {
     R502_DataPkg_t pkg;
@@ -642,7 +1236,17 @@ esp_err_t R502_reg_model(R502Interface *this, R502_conf_code_t *res)
     return ESP_OK;
 }
 
-esp_err_t R502_up_char(R502Interface *this, R502_data_len_t data_len, uint8_t buffer_id, 
+esp_err_t R502_up_char(R502Interface *this, uint8_t buffer_id, 
+    R502_conf_code_t *res)
+{
+    esp_err_t err = R502_lock(this, portMAX_DELAY);
+    if(err) return err;
+    err = up_char(this, buffer_id, res);
+    R502_unlock(this);
+    return err;
+}
+
+static esp_err_t up_char(R502Interface *this, uint8_t buffer_id, 
     R502_conf_code_t *res)
 {
     R502_DataPkg_t pkg;
@@ -674,53 +1278,94 @@ esp_err_t R502_up_char(R502Interface *this, R502_data_len_t data_len, uint8_t bu
         // The esp side of things is ok, but the module isn't ready to send
         return ESP_OK;
     }
-    int data_len_i = 0;
-    switch(data_len){
-        case R502_data_len_32:
-            data_len_i = 32;
-            break;
-        case R502_data_len_64:
-            data_len_i = 64;
-            break;
-        case R502_data_len_128:
-            data_len_i = 128;
-            break;
-        case R502_data_len_256:
-            data_len_i = 256;
-            break;
-        default:
-            ESP_LOGE(this->TAG, "invalid data length, use enum");
-            return ESP_ERR_INVALID_ARG;
-    }
+    int data_len_i = this->cur_data_pkg_len;
 
-    // receive data packages
+    // receive data packages, handing each payload to the callback in place
     R502_pid_t pid = R502_pid_data;
-    //uint8_t data_cb_buffer[R502_max_data_len];
     uint8_t *rec_data = receive_pkg.data.data.content;
     int bytes_received = 0;
     while(pid == R502_pid_data){
         err = receive_package(this, &receive_pkg, 
-            data_len_i + R502_cs_len + this->header_size, this->default_read_delay);
+            data_len_i + R502_cs_len + this->header_size, data_read_delay(this));
         if(err) return err;
         bytes_received += data_len_i;
 
         pid = (R502_pid_t)receive_pkg.pid;
 
-        // transcribe receive data into data buffer
-        for(int i = 0; i < data_len_i; i++){
-            // Full byte
-            data_cb_buffer[i] = rec_data[i];
-        }
-
         // call callback
-        this->up_char_cb(data_cb_buffer, data_len_i);
+        this->up_char_cb(rec_data, data_len_i);
     }
     ESP_LOGI(this->TAG, "bytes received %d", bytes_received);
 
     return ESP_OK;
 }
 
-esp_err_t R502_down_char(R502Interface *this, R502_data_len_t data_len, uint8_t buffer_id, 
+esp_err_t R502_up_char_into(R502Interface *this, uint8_t buffer_id, uint8_t *dest,
+    int dest_len, int *received_len, R502_conf_code_t *res)
+{
+    *received_len = 0;
+    esp_err_t err = R502_lock(this, portMAX_DELAY);
+    if(err) return err;
+    err = up_char_into(this, buffer_id, dest, dest_len, received_len, res);
+    R502_unlock(this);
+    return err;
+}
+
+static esp_err_t up_char_into(R502Interface *this, uint8_t buffer_id, uint8_t *dest,
+    int dest_len, int *received_len, R502_conf_code_t *res)
+{
+    R502_DataPkg_t pkg;
+    R502_UpChar_t *data = &pkg.data.up_char;
+
+    *received_len = 0;
+
+    // Fill package
+    set_headers(this, &pkg, R502_pid_command, sizeof(R502_UpChar_t));
+    data->instr_code = R502_ic_up_char;
+    data->buffer_id = buffer_id;
+    fill_checksum(&pkg);
+
+    // Send package, get response
+    R502_DataPkg_t receive_pkg;
+    R502_GeneralAck_t *receive_data = &receive_pkg.data.general_ack;
+    esp_err_t err = send_command_package(this, &pkg, &receive_pkg, 
+        sizeof(*receive_data), this->read_delay_gen_image);
+    if(err) return err;
+
+    *res = (R502_conf_code_t)receive_data->conf_code;
+    if(*res != R502_ok){ 
+        // The esp side of things is ok, but the module isn't ready to send
+        return ESP_OK;
+    }
+
+    // receive data packages, each straight after the previous one in dest
+    R502_pid_t pid = R502_pid_data;
+    int bytes_received = 0;
+    while(pid == R502_pid_data){
+        int data_len_i = 0;
+        err = receive_data_package(this, &receive_pkg, dest + bytes_received, 
+            dest_len - bytes_received, &data_len_i, data_read_delay(this));
+        if(err) return err;
+        bytes_received += data_len_i;
+
+        pid = (R502_pid_t)receive_pkg.pid;
+    }
+    *received_len = bytes_received;
+
+    return ESP_OK;
+}
+
+esp_err_t R502_down_char(R502Interface *this, uint8_t buffer_id, 
+    uint8_t * char_data, R502_conf_code_t *res)
+{
+    esp_err_t err = R502_lock(this, portMAX_DELAY);
+    if(err) return err;
+    err = down_char(this, buffer_id, char_data, res);
+    R502_unlock(this);
+    return err;
+}
+
+static esp_err_t down_char(R502Interface *this, uint8_t buffer_id, 
     uint8_t * char_data, R502_conf_code_t *res)
 {
     R502_DataPkg_t pkg;
@@ -730,6 +1375,10 @@ esp_err_t R502_down_char(R502Interface *this, R502_data_len_t data_len, uint8_t
         ESP_LOGW(this->TAG, "down_char data not supplied");
         return ESP_ERR_INVALID_STATE;
     }
+    if(!this->tx_buf){
+        ESP_LOGE(this->TAG, "down_char needs R502_init");
+        return ESP_ERR_INVALID_STATE;
+    }
     
     // TODO: Check stored parameters to see if the R502 has an image ready
     // to send. If not, still perform the transfer, but send a warning
@@ -753,62 +1402,26 @@ esp_err_t R502_down_char(R502Interface *this, R502_data_len_t data_len, uint8_t
         return ESP_OK;
     }
 
-    int data_len_i = 0;
-    uint16_t length = 0;
-
-    switch(data_len){
-        case R502_data_len_32:
-            data_len_i = 32;
-            length = sizeof(R502_Data32_t);
-            break;
-        case R502_data_len_64:
-            data_len_i = 64;
-            length = sizeof(R502_Data64_t);
-            break;
-        case R502_data_len_128:
-            data_len_i = 128;
-            length = sizeof(R502_Data128_t);
-            break;
-        case R502_data_len_256:
-            data_len_i = 256;
-            length = sizeof(R502_Data_t);
-            break;
-        default:
-            ESP_LOGE(this->TAG, "invalid data length, use enum");
-            return ESP_ERR_INVALID_ARG;
-    }
-
-    // transmit data packages
-    R502_DataPkg_t pkg2;
-    R502_Data_t *data2 = &pkg2.data.data;
+    int data_len_i = this->cur_data_pkg_len;
+    uint16_t length = data_len_i + R502_cs_len;
 
+    // Encode every data package of the template back to back, then hand
+    // the whole burst to the UART driver at once
     int char_data_length = R502_template_size;
-    int packet_num = char_data_length / data_len_i;
-
-    int i = 1;
-    while (i <= packet_num) {
-        // Fill data package
-        if (i == packet_num) {
-            set_headers(this, &pkg2, R502_pid_end_of_data, length);
-        } else {
-            set_headers(this, &pkg2, R502_pid_data, length);
-        }
-
-        for (int j = 0; j < data_len_i; j++) {
-            (data2->content)[j] = char_data[data_len_i*(i-1) + j];
-        }
-        fill_checksum(&pkg2);
-
-        // Send package, get response
-        err = send_package(this, &pkg2);
-        if(err) return err;
+    int tx_len = encode_data_packages(this, this->tx_buf, char_data, 
+        char_data_length, data_len_i, length);
+    err = send_bytes(this, this->tx_buf, tx_len);
+    if(err) return err;
 
-        i++;
+    // Return once the last byte is on the wire
+    int tx_ms = tx_len * 10 * 1000 / (9600 * this->cur_baud);
+    if(uart_wait_tx_done(this->uart_num, 
+        (tx_ms + this->default_read_delay) / portTICK_RATE_MS) != ESP_OK)
+    {
+        ESP_LOGE(this->TAG, "uart write error, tx not done");
+        return ESP_ERR_TIMEOUT;
     }
 
-    // Wait 20ms for R502 to internally acknowledge completion (empirically tested)
-    vTaskDelay(20 / portTICK_PERIOD_MS);
-
     ESP_LOGI(this->TAG, "bytes sent %d", char_data_length);
 
     return ESP_OK;
@@ -844,6 +1457,36 @@ esp_err_t R502_store(R502Interface *this, uint8_t buffer_id, uint16_t page_id,
     return ESP_OK;
 }
 
+esp_err_t R502_load_char(R502Interface *this, uint8_t buffer_id, uint16_t page_id,
+    R502_conf_code_t *res)
+{
+    R502_DataPkg_t pkg;
+    R502_LoadChar_t *data = &pkg.data.load_char;
+
+    uint8_t page_id_i[2];
+
+    // Fill package
+    set_headers(this, &pkg, R502_pid_command, sizeof(R502_LoadChar_t));
+    data->instr_code = R502_ic_load_char;
+    data->buffer_id = buffer_id;
+    conv_16_to_8(page_id, page_id_i);
+    for(int i = 0; i < 2; i++){
+        data->page_id[i] = page_id_i[i];
+    }
+    fill_checksum(&pkg);
+
+    // Send package, get response
+    R502_DataPkg_t receive_pkg;
+    R502_GeneralAck_t *receive_data = &receive_pkg.data.general_ack;
+    esp_err_t err = send_command_package(this, &pkg, &receive_pkg, 
+        sizeof(*receive_data), this->read_delay_gen_image);
+    if(err) return err;
+
+    // Return result
+    *res = (R502_conf_code_t)receive_data->conf_code;
+    return ESP_OK;
+}
+
 esp_err_t R502_delet_char(R502Interface *this, uint16_t page_id,
     uint16_t num_of_templates, R502_conf_code_t *res)
 {
@@ -0,0 +1,106 @@
+#ifndef R502ASYNC_H_
+#define R502ASYNC_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "R502Interface.h"
+
+/**
+ * \brief Non-blocking command api for the R502
+ * 
+ * R502_async_start creates a driver task that owns the interface. Commands
+ * submitted with R502_async_submit are queued and executed by that task in
+ * order; the submitter gets a handle back immediately and is told about the
+ * result through a callback (run on the driver task) and/or a queue of
+ * R502_async_result_t.
+ * 
+ * The driver task holds R502_lock while a command runs. Blocking R502_*
+ * calls take the lock themselves, so they can be made from other tasks
+ * while the driver task is running. A sequence of them that relies on the
+ * module's state in between (its char buffers) still needs
+ * R502_lock/R502_unlock around it.
+ */
+
+#define R502_ASYNC_QUEUE_SIZE   4       // commands waiting for the driver task
+#define R502_ASYNC_STACK_SIZE   4096
+
+typedef uint32_t R502_async_handle_t;
+
+/**
+ * \brief Commands that can be run asynchronously
+ */
+typedef enum {
+    R502_async_gen_image,       //!< R502_gen_image
+    R502_async_img_2_tz,        //!< R502_img_2_tz(buffer_id)
+    R502_async_reg_model,       //!< R502_reg_model
+    R502_async_store,           //!< R502_store(buffer_id, page_id)
+    R502_async_delet_char,      //!< R502_delet_char(page_id, count)
+    R502_async_search,          //!< R502_search(buffer_id, page_id, count)
+    R502_async_template_num,    //!< R502_template_num
+    R502_async_led_config,      //!< R502_led_config(led_ctrl, led_speed, led_color, count)
+} R502_async_cmd_t;
+
+/**
+ * \brief A command and its parameters. Fields not used by cmd are ignored
+ */
+typedef struct R502_async_req_t {
+    R502_async_cmd_t cmd;
+    uint8_t buffer_id;
+    uint16_t page_id;           //!< store, delet_char: page. search: start page
+    uint16_t count;             //!< delet_char: templates. search: pages. led_config: cycles
+    R502_led_ctrl_t led_ctrl;
+    uint8_t led_speed;
+    R502_led_color_t led_color;
+} R502_async_req_t;
+
+/**
+ * \brief Outcome of a command
+ */
+typedef struct R502_async_result_t {
+    R502_async_handle_t handle; //!< as returned by R502_async_submit
+    R502_async_cmd_t cmd;
+    esp_err_t err;              //!< return value of the R502_* call
+    R502_conf_code_t res;       //!< confirmation code from the R502
+    uint16_t page_id;           //!< search: matched page. template_num: template count
+    uint16_t match_score;       //!< search: match score
+    void *ctx;                  //!< as passed to R502_async_submit
+} R502_async_result_t;
+
+/**
+ * \brief Completion callback, called on the driver task. Must not block
+ */
+typedef void (*R502_async_cb_t)(const R502_async_result_t *result);
+
+/**
+ * \brief Start the driver task. R502_init must have been called
+ * \param priority FreeRTOS priority of the driver task
+ * \retval ESP_OK: successful (or already started)
+ *         ESP_ERR_INVALID_STATE: interface not initialized
+ *         ESP_ERR_NO_MEM: task or queue could not be created
+ */
+esp_err_t R502_async_start(R502Interface *this, UBaseType_t priority);
+
+/**
+ * \brief Stop the driver task once the command in flight completes. Queued
+ * commands complete with ESP_ERR_INVALID_STATE. Called by R502_deinit
+ */
+esp_err_t R502_async_stop(R502Interface *this);
+
+/**
+ * \brief Queue a command for the driver task
+ * \param req command to run, copied
+ * \param cb IN optional callback for the result, may be NULL
+ * \param done_queue IN optional queue of R502_async_result_t to post the
+ * result to, may be NULL
+ * \param ctx passed back in the result
+ * \param handle OUT optional, identifies the command in its result
+ * \param wait_ticks how long to wait if the command queue is full
+ * \retval ESP_OK: queued
+ *         ESP_ERR_INVALID_STATE: driver task not started
+ *         ESP_ERR_TIMEOUT: command queue full
+ */
+esp_err_t R502_async_submit(R502Interface *this, const R502_async_req_t *req,
+    R502_async_cb_t cb, QueueHandle_t done_queue, void *ctx,
+    R502_async_handle_t *handle, TickType_t wait_ticks);
+
+#endif /* R502ASYNC_H_ */
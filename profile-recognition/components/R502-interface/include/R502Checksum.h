@@ -0,0 +1,32 @@
+#ifndef R502CHECKSUM_H_
+#define R502CHECKSUM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * \brief Package checksum routines shared by package build and verify
+ *
+ * The R502 checksum is the 16 bit sum of the pid, length and data bytes of a
+ * package. These sum a word at a time, keeping each byte of the word in its
+ * own 16 bit lane, instead of a byte at a time. No ESP-IDF dependencies, so
+ * they build and are tested on the host too (see host_test)
+ */
+
+/**
+ * \brief Add len bytes of data to a running checksum
+ * \param sum running checksum, e.g. the pid and length bytes of the package
+ * \param data bytes to add, any alignment
+ * \param len number of bytes
+ * \retval sum plus every byte of data, modulo 2^16
+ */
+uint16_t R502_checksum(uint16_t sum, const uint8_t *data, size_t len);
+
+/**
+ * \brief R502_checksum of src, copying it to dst in the same pass
+ * \param dst OUT len bytes, any alignment, must not overlap src
+ * \retval sum plus every byte of src, modulo 2^16
+ */
+uint16_t R502_checksum_copy(uint16_t sum, uint8_t *dst, const uint8_t *src, size_t len);
+
+#endif
@@ -17,12 +17,14 @@
 #define R502_IMAGE_SIZE 36 * 1024 // Why isn't this 72 according to docs?
 #define R502_CS_LEN 2
 #define R502_MAX_DATA_LEN 256
+#define R502_INDEX_TABLE_LEN 32 // bytes per index page (256 templates)
 
 // Use these instead //
 static const int R502_template_size = R502_TEMPLATE_SIZE;
 static const int R502_image_size = R502_IMAGE_SIZE;
 static const int R502_cs_len = R502_CS_LEN;
 static const int R502_max_data_len = R502_MAX_DATA_LEN;
+static const int R502_index_table_len = R502_INDEX_TABLE_LEN;
 
 /**
  * \brief Package identifiers
@@ -61,6 +63,7 @@ typedef enum {
     R502_ic_write_notepad = 0x18,
     R502_ic_read_notepad = 0x19,
     R502_ic_template_num = 0x1D,
+    R502_ic_read_index_table = 0x1F,
     R502_ic_led_config = 0x35
 } R502_instr_code_t;
 
@@ -240,6 +243,16 @@ typedef struct R502_Store_t {
     uint8_t checksum[R502_CS_LEN]; //!< checksum
 } R502_Store_t;
 
+/**
+ * \brief Data section of the LoadChar command
+ */
+typedef struct R502_LoadChar_t {
+    uint8_t instr_code; //!< instruction code
+    uint8_t buffer_id; //!< character file buffer number
+    uint8_t page_id[2]; //!< flash location of the template
+    uint8_t checksum[R502_CS_LEN]; //!< checksum
+} R502_LoadChar_t;
+
 /**
  * \brief Data section of the DeletChar command
  */
@@ -250,6 +263,15 @@ typedef struct R502_DeletChar_t {
     uint8_t checksum[R502_CS_LEN]; //!< checksum
 } R502_DeletChar_t;
 
+/**
+ * \brief Data section of the ReadIndexTable command
+ */
+typedef struct R502_ReadIndexTable_t {
+    uint8_t instr_code; //!< instruction code
+    uint8_t index_page; //!< index page, 0-3 (256 templates per page)
+    uint8_t checksum[R502_CS_LEN]; //!< checksum
+} R502_ReadIndexTable_t;
+
 /**
  * \brief Data section of the Search command
  */
@@ -304,6 +326,15 @@ typedef struct R502_TemplateNumAck_t {
     uint8_t checksum[R502_CS_LEN]; //!< checksum
 } R502_TemplateNumAck_t;
 
+/**
+ * \brief Data section of a ReadIndexTable acknowledge package from R502
+ */
+typedef struct R502_ReadIndexTableAck_t {
+    uint8_t conf_code; //!< confirmation code
+    uint8_t index[R502_INDEX_TABLE_LEN]; //!< 1 bit per template, LSB of byte 0 is template 0
+    uint8_t checksum[R502_CS_LEN]; //!< checksum
+} R502_ReadIndexTableAck_t;
+
 /**
  * \brief Data section of a search acknowledge package from R502
  */
@@ -367,12 +398,15 @@ typedef struct R502_DataPkg_t {
         R502_UpChar_t up_char;
         R502_DownChar_t down_char;
         R502_Store_t store;
+        R502_LoadChar_t load_char;
         R502_DeletChar_t delet_char;
+        R502_ReadIndexTable_t read_index_table;
         R502_Search_t search;
         R502_LedConfig_t led_config;
         R502_GeneralAck_t general_ack;
         R502_ReadSysParaAck_t read_sys_para_ack;
         R502_TemplateNumAck_t template_num_ack;
+        R502_ReadIndexTableAck_t read_index_table_ack;
         R502_SearchAck_t search_ack;
 
         R502_Data_t data;
@@ -2,10 +2,13 @@
 #define R502INTERFACE_H_
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_timer.h"
@@ -31,6 +34,23 @@
 
 extern void IRAM_ATTR gpio_isr_handler(void* arg);
 
+// Rate R502_init moves the module to. 115200 is the highest the R502/R503 support
+#define R502_BAUD_FASTEST R502_baud_115200
+// Data package length R502_init selects, fewest packets per template transfer
+#define R502_DATA_LEN_LARGEST R502_data_len_256
+// Reply timeout while probing for the module's baud rate, ms
+#define R502_PROBE_READ_DELAY 50
+
+// Depth of the UART driver event queue that wakes receive_package
+#define R502_UART_QUEUE_SIZE 20
+
+// Bytes of a template sent as data packages at the smallest package size
+// (32 bytes of payload each), i.e. the most a DownChar burst can take
+#define R502_DOWN_CHAR_TX_SIZE ((R502_TEMPLATE_SIZE) / 32 * \
+    (offsetof(R502_DataPkg_t, data) + 32 + R502_CS_LEN))
+// UART driver TX ring buffer, holds a whole DownChar burst
+#define R502_UART_TX_BUFFER_SIZE R502_DOWN_CHAR_TX_SIZE
+
 typedef void (*up_image_cb_t)(uint8_t*, int);
 typedef void (*up_char_cb_t)(uint8_t*, int);
 
@@ -52,12 +72,23 @@ typedef struct R502Interface {
 
     // shouldn't need these here. Try not to store data members for parameters
     R502_baud_t cur_baud;
+    // Active data package length in bytes, used by up_char and down_char.
+    // Kept in step by R502_init, set_data_package_length and read_sys_para
     int cur_data_pkg_len;
 
     bool initialized;
     int interrupt;
 
     uart_port_t uart_num;
+    QueueHandle_t uart_queue; // UART driver events, set by R502_init
+    SemaphoreHandle_t lock; // recursive, see R502_lock
+    uint8_t *tx_buf; // R502_DOWN_CHAR_TX_SIZE bytes, DownChar packages are encoded here
+
+    // async driver (R502Async.h)
+    TaskHandle_t async_task;
+    QueueHandle_t async_queue;
+    uint32_t async_next_handle;
+    int async_submitters; // R502_async_submit calls between check and queue
     gpio_num_t pin_txd;
     gpio_num_t pin_rxd;
     gpio_num_t pin_irq;
@@ -84,6 +115,10 @@ typedef struct R502Interface {
  * \param _pin_txd Pin to transmit to R502
  * \param _pin_rxd Pin to receive from R502
  * \param _pin_irq Pin to receive inturrupt requests from R502 on
+ * \param _baud Expected baud rate of the module. The other rates are probed
+ * if it does not answer, and the module is then moved to R502_BAUD_FASTEST
+ * and R502_DATA_LEN_LARGEST. A module that answers at no rate does not fail
+ * init
  */
 esp_err_t R502_init(R502Interface *this, uart_port_t _uart_num, gpio_num_t _pin_txd, 
     gpio_num_t _pin_rxd, gpio_num_t _pin_irq, 
@@ -94,6 +129,24 @@ esp_err_t R502_init(R502Interface *this, uart_port_t _uart_num, gpio_num_t _pin_
  */
 esp_err_t R502_deinit(R502Interface *this);
 
+/**
+ * \brief Take exclusive use of the module. Every blocking call takes it
+ * for its own exchanges; take it around a sequence of calls that relies on
+ * the module's state in between, like its char buffers, when other tasks
+ * such as the R502Async driver task may use the module too.
+ * Recursive: may be taken again by the task that holds it
+ * \param wait_ticks how long to wait for the module
+ * \retval ESP_OK: taken
+ *         ESP_ERR_TIMEOUT: held by another task for wait_ticks
+ *         ESP_ERR_INVALID_STATE: interface not initialized
+ */
+esp_err_t R502_lock(R502Interface *this, TickType_t wait_ticks);
+
+/**
+ * \brief Release the module after R502_lock
+ */
+void R502_unlock(R502Interface *this);
+
 /**
  * \brief Return pointer to 4 byte length module address
  */
@@ -153,7 +206,8 @@ esp_err_t R502_set_security_level(R502Interface *this, uint8_t security_level, R
  * \note Can only set data package length to 128 or 256. Setting to 64 or 32
  * only sets the module to 128. This is contrary to the documentation, and
  * perhaps this is an exception for only my module, so I've left the 32 and
- * 64 byte options accessible
+ * 64 byte options accessible. The length is read back afterwards so
+ * cur_data_pkg_len always holds what the module really uses
  */
 esp_err_t R502_set_data_package_length(R502Interface *this, R502_data_len_t data_length,
     R502_conf_code_t *res);
@@ -174,6 +228,17 @@ esp_err_t R502_read_sys_para(R502Interface *this, R502_conf_code_t *res, R502_sy
  */
 esp_err_t R502_template_num(R502Interface *this, R502_conf_code_t *res, uint16_t *template_num);
 
+/**
+ * \brief Read one page of the template index table
+ * \param index_page page number, 0-3. Page n covers templates 256n to 256n+255
+ * \param res OUT confirmation code provided by the R502
+ * \param table OUT 32 byte bitmap, bit set if the template is stored. Bit 0
+ * of byte 0 is the first template of the page
+ * \retval See vfy_pass for description of all possible return values
+ */
+esp_err_t R502_read_index_table(R502Interface *this, uint8_t index_page,
+    R502_conf_code_t *res, uint8_t table[R502_INDEX_TABLE_LEN]);
+
 /// Fingerprint Processing Commands ///
 
 /**
@@ -210,27 +275,40 @@ esp_err_t R502_reg_model(R502Interface *this, R502_conf_code_t *res);
 
 /**
  * \brief Upload the character file or template of char_buffer to upper computer
- * \param data_len The configured data_package_length of the module, so
- * the data receiver knows how long each data package will be. Query the 
- * data package length of the module using read_sys_para()
+ * in data packages of cur_data_pkg_len bytes
  * \param buffer_id char buffer id
  * \param res OUT confirmation code
  * \retval See vfy_pass for description of all possible return values
  */
-esp_err_t R502_up_char(R502Interface *this, R502_data_len_t data_len, uint8_t buffer_id,
+esp_err_t R502_up_char(R502Interface *this, uint8_t buffer_id,
     R502_conf_code_t *res);
 
 /**
- * \brief Upper computer download template to module buffer
- * \param data_len The configured data_package_length of the module, so
- * the data receiver knows how long each data package will be. Query the 
- * data package length of the module using read_sys_para()
+ * \brief Upload the template in a character buffer directly into dest
+ * \param buffer_id character buffer to upload, 1 or 2
+ * \param dest OUT template destination, R502_TEMPLATE_SIZE bytes for a full
+ * template
+ * \param dest_len room in dest
+ * \param received_len OUT number of bytes written to dest
+ * \param res OUT confirmation code provided by the R502
+ * Each data package is received at its final position in dest and its
+ * checksum verified there; works with any data package length and needs no
+ * up_char callback
+ * \retval See vfy_pass for description of all possible return values.
+ *         ESP_ERR_INVALID_SIZE: template larger than dest_len
+ */
+esp_err_t R502_up_char_into(R502Interface *this, uint8_t buffer_id, uint8_t *dest,
+    int dest_len, int *received_len, R502_conf_code_t *res);
+
+/**
+ * \brief Upper computer download template to module buffer in data packages
+ * of cur_data_pkg_len bytes
  * \param buffer_id char buffer id
  * \param char_data data buffer
  * \param res OUT confirmation code
  * \retval See vfy_pass for description of all possible return values
  */
-esp_err_t R502_down_char(R502Interface *this, R502_data_len_t data_len, uint8_t buffer_id,
+esp_err_t R502_down_char(R502Interface *this, uint8_t buffer_id,
     uint8_t * char_data, R502_conf_code_t *res);
 
 /**
@@ -243,6 +321,17 @@ esp_err_t R502_down_char(R502Interface *this, R502_data_len_t data_len, uint8_t
  */
 esp_err_t R502_store(R502Interface *this, uint8_t buffer_id, uint16_t page_id, R502_conf_code_t *res);
 
+/**
+ * \brief Read the template at a location of the Flash library into a
+ * char buffer
+ * \param buffer_id char buffer id
+ * \param page_id Flash location of template
+ * \param res OUT confirmation code
+ * \retval See vfy_pass for description of all possible return values
+ */
+esp_err_t R502_load_char(R502Interface *this, uint8_t buffer_id, uint16_t page_id,
+    R502_conf_code_t *res);
+
 /**
  * \brief Delete segment of templates of Flash library started from the
  * specified location
@@ -286,100 +375,6 @@ esp_err_t R502_search(R502Interface *this, uint8_t buffer_id, uint16_t start_pag
 esp_err_t R502_led_config(R502Interface *this, R502_led_ctrl_t ctrl, uint8_t speed,
     R502_led_color_t color_index, uint8_t count, R502_conf_code_t *res);
 
-/**
- * Private functions (implement as static functions in .c file, then remove from .h file)
- */
-
-/**
- * \brief Set system parameters baud rate, security level, and 
- * data package length
- * \param parameter_num Select which parameter to be set
- * \param value The value to set the parameter to
- * \param res OUT confirmation code provided by the R502
- * \retval See vfy_pass for description of all possible return values
- * 
- * Set to private and broken out to three public methods instead
- *  Parameter Num       | Value Meaning
- *  ------------------- | -----------------------------------------------
- *  Baud Control        | N=[1,2,4,6,12]. Baud rate = N*9600 
- *  Security Level      | [1,2,3,4,5]. At 1 FAR is high, at 5 FRR is high
- *  Data Package Length | [0,1,2,3] corresponds to 32, 64, 128, 256 bytes
- */
-static esp_err_t set_sys_para(R502Interface *this, R502_para_num parameter_num, int value, 
-    R502_conf_code_t *res);
-
-/**
- * \brief Send a command to the module, and read its acknowledgement
- * \param pkg data to send
- * \param receivePkg OUT package to read response data into
- * \param data_rec_length number of data bytes to receive into
- * receivePkg.data
- * \param read_delay_ms Max number of ms to wait for a response
- * \retval ESP_OK: successful
- *         ESP_ERR_INVALID_STATE: Error sending or recieving via UART
- *         ESP_ERR_INVALID_SIZE: Not all data was sent out
- *         ESP_ERR_NOT_FOUND: No response from the module
-             ESP_ERR_INVALID_RESPONSE: Not enough bytes received
-            ESP_ERR_INVALID_CRC: Response had failed CRC
-    */
-static esp_err_t send_command_package(R502Interface *this, const R502_DataPkg_t *pkg,
-    R502_DataPkg_t *receivePkg, int data_rec_length, 
-    int read_delay_ms);
-
-/**
- * \brief Send a filled package to the module
- * \param pkg A filled package, depends on length being filled
- * \retval ESP_OK: successful
-             ESP_ERR_INVALID_ARG: Package length not set correctly
-    *         ESP_ERR_INVALID_STATE: Error sending or recieving via UART
-    *         ESP_ERR_INVALID_SIZE: Not all data was sent out
-    */
-static esp_err_t send_package(R502Interface *this, const R502_DataPkg_t *pkg);
-
-/**
- * \brief Receive a package from the module
- * \param rec_pkg OUT Package to be filled
- * \param data_length Expected amount of data to be read
- * \param read_delay_ms Max number of ms to wait for a response
- * \retval ESP_OK: successful
- *         ESP_ERR_INVALID_STATE: Error sending or recieving via UART
- *         ESP_ERR_NOT_FOUND: No data was received
- *         ESP_ERR_INVALID_SIZE: Less than data_rec_length was received
- */
-static esp_err_t receive_package(R502Interface *this, const R502_DataPkg_t *rec_pkg, 
-    int data_length, int read_delay_ms);
-
-static void set_headers(R502Interface *this, R502_DataPkg_t *package, R502_pid_t pid,
-    uint16_t length);
-
-static void fill_checksum(R502_DataPkg_t *package);
-
-static bool verify_checksum(const R502_DataPkg_t *package);
-
-/**
- * \brief Verify the header fields of the package are correct
- * \param pkg package to verify
- * \param length Expected value of length field
- * \retval ESP_OK: successful
- *         ESP_ERR_INVALID_RESPONSE: package header is incorrect
- */
-static esp_err_t verify_headers(R502Interface *this, const R502_DataPkg_t *pkg, uint16_t length);
-
-/**
- * \brief Return the total number of bytes in a filled package
- * \param pkg Package to measure
- * This uses the filled length parameter, so it doesn't need to know what
- * type of package data it is. But length needs to be properly filled before
- * calling
- * Includes start, adder, pid, length, data and checksum bytes
- */
-static uint16_t package_length(const R502_DataPkg_t *pkg);
-
-static uint16_t conv_8_to_16(const uint8_t in[2]);
-static void conv_16_to_8(const uint16_t in, uint8_t out[2]);
-
-static void busy_delay(int64_t microseconds);
-
 extern void IRAM_ATTR irq_intr(void *arg);
 
 #endif /* R502INTERFACE_H */
\ No newline at end of file
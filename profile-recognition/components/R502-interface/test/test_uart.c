@@ -1,6 +1,7 @@
 #include <limits.h>
 #include "unity.h"
 #include "R502Interface.h"
+#include "R502Async.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "esp32/rom/uart.h"
@@ -299,6 +300,27 @@ TEST_CASE("TemplateNum", "[system]")
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
 }
 
+TEST_CASE("ReadIndexTable", "[system]")
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+    R502_conf_code_t conf_code;
+    uint16_t template_num = 0;
+    err = R502_template_num(&R502, &conf_code, &template_num);
+    TEST_ESP_OK(err);
+
+    // Number of bits set in page 0 should match the template count
+    uint8_t table[R502_INDEX_TABLE_LEN];
+    err = R502_read_index_table(&R502, 0, &conf_code, table);
+    TEST_ESP_OK(err);
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    int count = 0;
+    for (int i = 0; i < R502_index_table_len; i++) {
+        count += __builtin_popcount(table[i]);
+    }
+    TEST_ASSERT_EQUAL(template_num, count);
+}
+
 TEST_CASE("GenImage", "[fingerprint processing]")
 {
     esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
@@ -474,11 +496,14 @@ TEST_CASE("UpChar", "[fingerprint processing command][dataExchange]")
     err = R502_read_sys_para(&R502, &conf_code, &sys_para);
     TEST_ESP_OK(err);
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
-    R502_data_len_t starting_data_len = sys_para.data_package_length;
+
+    // init selects the largest data packages and tracks them
+    TEST_ASSERT_EQUAL(R502_DATA_LEN_LARGEST, sys_para.data_package_length);
+    TEST_ASSERT_EQUAL(256, R502.cur_data_pkg_len);
 
     // Attempt up_char without setting the callback
     uint8_t buffer_id = 1;
-    err = R502_up_char(&R502, starting_data_len, buffer_id, &conf_code);
+    err = R502_up_char(&R502, buffer_id, &conf_code);
     TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
 
     // reset counter to measure size of the uploaded image
@@ -486,7 +511,7 @@ TEST_CASE("UpChar", "[fingerprint processing command][dataExchange]")
 
     up_char_size = 0;
 
-    err = R502_up_char(&R502, starting_data_len, buffer_id, &conf_code);
+    err = R502_up_char(&R502, buffer_id, &conf_code);
     TEST_ESP_OK(err);
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
     TEST_ASSERT_EQUAL(R502_template_size, up_char_size);
@@ -530,8 +555,9 @@ TEST_CASE("UpChar-Advanced", "[fingerprint processing][dataExchange]")
                 &conf_code);
             TEST_ESP_OK(err);
             TEST_ASSERT_EQUAL(R502_ok, conf_code);
+            TEST_ASSERT_EQUAL(32 << test_data_lens[data_i], R502.cur_data_pkg_len);
 
-            err = R502_up_char(&R502, test_data_lens[data_i], buffer_id, &conf_code);
+            err = R502_up_char(&R502, buffer_id, &conf_code);
             TEST_ESP_OK(err);
             TEST_ASSERT_EQUAL(R502_ok, conf_code);
             TEST_ASSERT_EQUAL(R502_template_size, up_char_size);
@@ -547,6 +573,33 @@ TEST_CASE("UpChar-Advanced", "[fingerprint processing][dataExchange]")
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
 }
 
+TEST_CASE("UpCharInto", "[fingerprint processing][dataExchange]")
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+    R502_conf_code_t conf_code;
+
+    // Download a known template, read it back straight into a buffer
+    populate_buffer();
+    uint8_t buffer_id = 1;
+    err = R502_down_char(&R502, buffer_id, character_buffer, &conf_code);
+    TEST_ESP_OK(err);
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+
+    static uint8_t template[R502_TEMPLATE_SIZE];
+    int received_len = 0;
+    err = R502_up_char_into(&R502, buffer_id, template, sizeof(template), 
+        &received_len, &conf_code);
+    TEST_ESP_OK(err);
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    TEST_ASSERT_EQUAL(R502_template_size, received_len);
+
+    // A destination that is too small is refused, not overrun
+    err = R502_up_char_into(&R502, buffer_id, template, R502_TEMPLATE_SIZE / 2, 
+        &received_len, &conf_code);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_SIZE, err);
+}
+
 TEST_CASE("DownChar", "[fingerprint processing][dataExchange]")
 {
     populate_buffer();
@@ -556,22 +609,27 @@ TEST_CASE("DownChar", "[fingerprint processing][dataExchange]")
     R502_conf_code_t conf_code;
 
     // main test
-    // read and save current data_package_length and baud rate
-    R502_sys_para_t sys_para;
-    //R502_conf_code_t conf_code;
-    err = R502_read_sys_para(&R502, &conf_code, &sys_para);
+    uint8_t buffer_id = 1;
+    err = R502_down_char(&R502, buffer_id, character_buffer, &conf_code);
     TEST_ESP_OK(err);
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
-    R502_data_len_t starting_data_len = sys_para.data_package_length;
+}
 
-    // Attempt up_char without setting the callback
+TEST_CASE("Store", "[fingerprint processing]")
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+    R502_conf_code_t conf_code;
+
+    // main test
     uint8_t buffer_id = 1;
-    err = R502_down_char(&R502, starting_data_len, buffer_id, character_buffer, &conf_code);
+    uint16_t page_id = 0;
+    err = R502_store(&R502, buffer_id, page_id, &conf_code);
     TEST_ESP_OK(err);
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
 }
 
-TEST_CASE("Store", "[fingerprint processing]")
+TEST_CASE("LoadChar", "[fingerprint processing]")
 {
     esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
     TEST_ESP_OK(err);
@@ -580,7 +638,7 @@ TEST_CASE("Store", "[fingerprint processing]")
     // main test
     uint8_t buffer_id = 1;
     uint16_t page_id = 0;
-    err = R502_store(&R502, buffer_id, page_id, &conf_code);
+    err = R502_load_char(&R502, buffer_id, page_id, &conf_code);
     TEST_ESP_OK(err);
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
 }
@@ -687,4 +745,172 @@ TEST_CASE("LedConfig-speed", "[other]")
     err = R502_led_config(&R502, ctrl, 1, color, cycles, &conf_code);
     TEST_ESP_OK(err);
     TEST_ASSERT_EQUAL(R502_ok, conf_code);
-}
\ No newline at end of file
+}
+
+static volatile int async_cb_count = 0;
+static void async_callback(const R502_async_result_t *result)
+{
+    async_cb_count++;
+}
+
+TEST_CASE("Async-TemplateNum", "[async]")
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+    R502_conf_code_t conf_code;
+    uint16_t template_num = 0;
+    err = R502_template_num(&R502, &conf_code, &template_num);
+    TEST_ESP_OK(err);
+
+    err = R502_async_start(&R502, 5);
+    TEST_ESP_OK(err);
+    QueueHandle_t done_queue = xQueueCreate(2, sizeof(R502_async_result_t));
+
+    // Submit returns straight away, the result arrives on both paths
+    R502_async_req_t req = { .cmd = R502_async_template_num };
+    R502_async_handle_t handle = 0;
+    async_cb_count = 0;
+    int64_t time_start = esp_timer_get_time();
+    err = R502_async_submit(&R502, &req, async_callback, done_queue, &R502, &handle, 0);
+    TEST_ESP_OK(err);
+    TEST_ASSERT_LESS_THAN(10000, esp_timer_get_time() - time_start);
+
+    R502_async_result_t result;
+    TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(done_queue, &result, 1000 / portTICK_PERIOD_MS));
+    TEST_ESP_OK(result.err);
+    TEST_ASSERT_EQUAL(R502_ok, result.res);
+    TEST_ASSERT_EQUAL(handle, result.handle);
+    TEST_ASSERT_EQUAL_PTR(&R502, result.ctx);
+    TEST_ASSERT_EQUAL(template_num, result.page_id);
+    TEST_ASSERT_EQUAL(1, async_cb_count);
+
+    // Blocking calls take the module themselves, alongside the driver task
+    err = R502_template_num(&R502, &conf_code, &template_num);
+    TEST_ESP_OK(err);
+
+    vQueueDelete(done_queue);
+}
+
+TEST_CASE("Async-NotStarted", "[async]")
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+    R502_async_req_t req = { .cmd = R502_async_gen_image };
+    err = R502_async_submit(&R502, &req, NULL, NULL, NULL, NULL, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
+}
+
+// One submit that waits for room in the command queue, reports how it went
+static QueueHandle_t async_done_queue;
+static QueueHandle_t async_report_queue;
+static void submit_task(void *arg)
+{
+    R502_async_req_t req = { .cmd = R502_async_template_num };
+    // Any ctx: the driver task must not take it for the stopper's
+    esp_err_t err = R502_async_submit(&R502, &req, NULL, async_done_queue, &R502,
+        NULL, portMAX_DELAY);
+    xQueueSend(async_report_queue, &err, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+static void stop_task(void *arg)
+{
+    esp_err_t err = R502_async_stop(&R502);
+    xQueueSend(async_report_queue, &err, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Async-SubmitBehindStop", "[async]")
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+    async_done_queue = xQueueCreate(16, sizeof(R502_async_result_t));
+    async_report_queue = xQueueCreate(3, sizeof(esp_err_t));
+    R502_async_req_t req = { .cmd = R502_async_template_num };
+
+    // The queue wakes its waiters in no set order, so take a few rounds
+    for(int round = 0; round < 5; round++){
+        // Hold the module: the driver task blocks on its first command, the
+        // rest fill the command queue
+        TEST_ESP_OK(R502_lock(&R502, portMAX_DELAY));
+        TEST_ESP_OK(R502_async_start(&R502, 5));
+        for(int i = 0; i <= R502_ASYNC_QUEUE_SIZE; i++){
+            TEST_ESP_OK(R502_async_submit(&R502, &req, NULL, async_done_queue,
+                &R502, NULL, 100 / portTICK_PERIOD_MS));
+        }
+
+        // Two submits past their check, waiting for room, then the stop
+        xTaskCreate(submit_task, "submit_a", 4096, NULL, 5, NULL);
+        xTaskCreate(submit_task, "submit_b", 4096, NULL, 5, NULL);
+        vTaskDelay(20 / portTICK_PERIOD_MS);
+        xTaskCreate(stop_task, "stop", 4096, NULL, 5, NULL);
+        vTaskDelay(20 / portTICK_PERIOD_MS);
+        R502_unlock(&R502);
+
+        // All three return, the submits queued and the driver task gone
+        for(int i = 0; i < 3; i++){
+            TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(async_report_queue, &err,
+                2000 / portTICK_PERIOD_MS));
+            TEST_ESP_OK(err);
+        }
+
+        // Every command that got queued has its result, run or failed
+        R502_async_result_t result;
+        int results = 0;
+        while(xQueueReceive(async_done_queue, &result, 0) == pdTRUE){
+            TEST_ASSERT_EQUAL_PTR(&R502, result.ctx);
+            results++;
+        }
+        TEST_ASSERT_EQUAL(R502_ASYNC_QUEUE_SIZE + 3, results);
+    }
+
+    // And a later submit is refused, not queued for nobody
+    err = R502_async_submit(&R502, &req, NULL, async_done_queue, NULL, NULL, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_STATE, err);
+    vQueueDelete(async_report_queue);
+    vQueueDelete(async_done_queue);
+}
+
+// Template uploads, each a run of data packages, checked as they go
+static void up_char_task(void *arg)
+{
+    static uint8_t template[R502_TEMPLATE_SIZE];
+    R502_conf_code_t conf_code = R502_fail;
+    int received_len = 0;
+    esp_err_t err = ESP_OK;
+    for(int i = 0; i < 10 && !err; i++){
+        err = R502_up_char_into(&R502, 1, template, sizeof(template), 
+            &received_len, &conf_code);
+        if(!err && (conf_code != R502_ok || received_len != R502_template_size)){
+            err = ESP_FAIL;
+        }
+    }
+    xQueueSend(async_report_queue, &err, portMAX_DELAY);
+    vTaskDelete(NULL);
+}
+
+TEST_CASE("Blocking-TwoTasks", "[async]")
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+    R502_conf_code_t conf_code;
+    populate_buffer();
+    err = R502_down_char(&R502, 1, character_buffer, &conf_code);
+    TEST_ESP_OK(err);
+    async_report_queue = xQueueCreate(1, sizeof(esp_err_t));
+
+    // Plain blocking calls from two tasks, no R502_lock in sight: neither
+    // sees the other's packages
+    xTaskCreate(up_char_task, "up_char", 4096, NULL, 5, NULL);
+    for(int i = 0; i < 50; i++){
+        uint16_t template_num = 0;
+        conf_code = R502_fail;
+        err = R502_template_num(&R502, &conf_code, &template_num);
+        TEST_ESP_OK(err);
+        TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    }
+    TEST_ASSERT_EQUAL(pdTRUE, xQueueReceive(async_report_queue, &err, 
+        5000 / portTICK_PERIOD_MS));
+    TEST_ESP_OK(err);
+    vQueueDelete(async_report_queue);
+}
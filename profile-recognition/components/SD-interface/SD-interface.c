@@ -1,7 +1,24 @@
 #include "SD-interface.h"
+#include "esp32/rom/crc.h"
 
 static const char *TAG = "SD-interface";
 
+/**
+ * Private variables
+ */
+
+static FILE *db_file = NULL;                        // profile database, open for the lifetime of the system
+static uint8_t db_bitmap[SD_DB_BITMAP_SIZE];        // copy of the slot bitmap
+static uint32_t db_crc[SD_DB_SLOTS];                // copy of the CRC directory
+static uint32_t db_sync[SD_DB_SLOTS];               // copy of the sensor sync manifest
+static bool db_sync_dirty = false;                  // db_sync differs from the card
+
+static SD_db_record_t db_window[SD_DB_READ_AHEAD];  // read-ahead window
+static int db_window_start = -1;                    // first slot held by db_window, -1 if empty
+static int db_window_count = 0;                     // number of records held by db_window
+
+static esp_err_t SD_openProfileDb();
+
 esp_err_t SD_init(void)
 {
 
@@ -102,119 +119,505 @@ esp_err_t SD_init(void)
     //deinitialize the bus after all devices are removed
     //spi_bus_free(host.slot);
 #endif*/
-    return ESP_OK;
+
+    // Open the profile database once; all profile access goes through it
+    return SD_openProfileDb();
 }
 
-esp_err_t SD_readProfile(int profile_id, uint8_t *pin_p, int pin_n,
-    uint8_t *priv_p, int priv_n, uint8_t *fp_p, int fp_n) {
+/**
+ * -------------------------------------
+ * Private functions
+ * -------------------------------------
+ */
+
+static long SD_recordOffset(int profile_id) {
+    return (long)SD_DB_HEADER_SIZE + (long)profile_id * sizeof(SD_db_record_t);
+}
+
+static uint32_t SD_recordCrc(const SD_db_record_t *record) {
+    return crc32_le(0, (const uint8_t *)record, sizeof(SD_db_record_t));
+}
+
+static bool SD_bitmapTest(int profile_id) {
+    return (db_bitmap[profile_id >> 3] >> (profile_id & 7)) & 1;
+}
+
+static void SD_bitmapWrite(int profile_id, bool isUsed) {
+    if (isUsed) {
+        db_bitmap[profile_id >> 3] |= (1 << (profile_id & 7));
+    } else {
+        db_bitmap[profile_id >> 3] &= ~(1 << (profile_id & 7));
+    }
+}
+
+// Drop the read-ahead window if it holds profile_id
+static void SD_windowInvalidate(int profile_id) {
+    if ((profile_id >= db_window_start) && (profile_id < db_window_start + db_window_count)) {
+        db_window_start = -1;
+        db_window_count = 0;
+    }
+}
 
-    const char* directory = "/sdcard/profiles/";
-    const char* fileName = "profile";
-    const char* fileType = ".bin";
+// Write the bitmap and CRC directory back to the card
+static esp_err_t SD_commitHeader() {
+    if (fseek(db_file, sizeof(SD_db_header_t), SEEK_SET) != 0) {
+        ESP_LOGE("SD_commitHeader", "Failed to seek to directory");
+        return ESP_FAIL;
+    }
+    if (fwrite(db_bitmap, 1, sizeof(db_bitmap), db_file) != sizeof(db_bitmap)) {
+        ESP_LOGE("SD_commitHeader", "Bitmap not fully written");
+        return ESP_FAIL;
+    }
+    if (fwrite(db_crc, 1, sizeof(db_crc), db_file) != sizeof(db_crc)) {
+        ESP_LOGE("SD_commitHeader", "CRC directory not fully written");
+        return ESP_FAIL;
+    }
+    if ((fflush(db_file) != 0) || (fsync(fileno(db_file)) != 0)) {
+        ESP_LOGE("SD_commitHeader", "Directory not flushed to the card");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
 
-    char name_buffer[512];
+// Read a pre-database /sdcard/profiles/profile%d.bin file into a record
+static esp_err_t SD_readLegacyProfile(int profile_id, SD_db_record_t *record) {
+    char name_buffer[64];
     struct stat st;
 
-    sprintf(name_buffer, "%s%s%d%s", directory, fileName, profile_id, fileType);
-    ESP_LOGI("SD_readProfile", "Looking for file %s", name_buffer);
+    sprintf(name_buffer, "%s%s%d%s", SD_DB_LEGACY_DIR, "profile", profile_id, ".bin");
 
     // Check if file exists
     if (stat(name_buffer, &st) != 0) {
         return ESP_ERR_NOT_FOUND;
     }
-    ESP_LOGI("SD_readProfile", "File found");
 
-    // Open file
     FILE *f = fopen(name_buffer, "r");
     if (f == NULL) {
-        ESP_LOGE("SD_readProfile", "Failed to open file");
+        ESP_LOGE("SD_readLegacyProfile", "Failed to open file %s", name_buffer);
         return ESP_FAIL;
     }
 
-    // Read 4-byte PIN from file
-    if (fread(pin_p, sizeof(uint8_t), pin_n, f) != pin_n) {
-        ESP_LOGE("SD_readProfile", "PIN not fully read");
+    memset(record, 0, sizeof(*record));
+    bool ok = (fread(record->pin, 1, SD_DB_PIN_LEN, f) == SD_DB_PIN_LEN) &&
+              (fread(record->privilege, 1, SD_DB_PRIV_LEN, f) == SD_DB_PRIV_LEN) &&
+              (fread(record->fingerprint, 1, SD_DB_FP_LEN, f) == SD_DB_FP_LEN);
+    fclose(f);
+
+    if (!ok) {
+        ESP_LOGE("SD_readLegacyProfile", "File %s not fully read", name_buffer);
         return ESP_FAIL;
     }
+    return ESP_OK;
+}
 
-    // Read 1-byte privilege from file
-    if (fread(priv_p, sizeof(uint8_t), priv_n, f) != priv_n) {
-        ESP_LOGE("SD_readProfile", "Privilege not fully read");
+// Read and check the header of a database. ESP_ERR_INVALID_VERSION if the
+// format is not ours; the slot count is left for the caller to check
+static esp_err_t SD_readDbHeader(FILE *f, SD_db_header_t *header) {
+    if (fseek(f, 0, SEEK_SET) != 0 || fread(header, 1, sizeof(*header), f) != sizeof(*header)) {
+        ESP_LOGE("SD_readDbHeader", "Header not fully read");
         return ESP_FAIL;
     }
+    if ((header->magic != SD_DB_MAGIC) || (header->version != SD_DB_VERSION) ||
+        (header->record_size != sizeof(SD_db_record_t))) {
+        ESP_LOGE("SD_readDbHeader", "Unsupported database: magic 0x%08x, version %d, %d slots of %d bytes",
+            header->magic, header->version, header->slot_count, header->record_size);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    return ESP_OK;
+}
 
-    // Read 384x4 (1536) byte fingerprint template from file
-    if (fread(fp_p, sizeof(uint8_t), fp_n, f) != fp_n) {
-        ESP_LOGE("SD_readProfile", "Fingerprint not fully read");
+// Previous database being migrated to a new slot count
+typedef struct SD_old_db_t {
+    FILE *f;
+    int slot_count;
+    uint8_t *bitmap;
+    uint32_t *crc;
+} SD_old_db_t;
+
+// Read a record of the previous database. NOT_FOUND for free or corrupt slots
+static esp_err_t SD_readOldProfile(SD_old_db_t *old, int profile_id, SD_db_record_t *record) {
+    if ((profile_id >= old->slot_count) || !((old->bitmap[profile_id >> 3] >> (profile_id & 7)) & 1)) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    long offset = (long)SD_DB_HEADER_SIZE_FOR(old->slot_count) + (long)profile_id * sizeof(SD_db_record_t);
+    if ((fseek(old->f, offset, SEEK_SET) != 0) ||
+        (fread(record, 1, sizeof(*record), old->f) != sizeof(*record))) {
+        ESP_LOGE("SD_readOldProfile", "Profile %d not fully read", profile_id);
         return ESP_FAIL;
     }
+    if (SD_recordCrc(record) != old->crc[profile_id]) {
+        ESP_LOGE("SD_readOldProfile", "Profile %d is corrupt, not migrated", profile_id);
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
 
-    fclose(f);
+// Write the header and every record of a new database to db_file, importing
+// profiles from old or legacy files, see SD_createProfileDb
+static esp_err_t SD_writeProfileDb(SD_old_db_t *old) {
+    // a) header. Directory is written below, pad with zeroes up to the first record
+    SD_db_header_t header = {
+        .magic = SD_DB_MAGIC,
+        .version = SD_DB_VERSION,
+        .slot_count = SD_DB_SLOTS,
+        .record_size = sizeof(SD_db_record_t),
+        .reserved = 0
+    };
+    static const uint8_t zero[SD_DB_SECTOR_SIZE] = {0};
+    if (fwrite(&header, 1, sizeof(header), db_file) != sizeof(header)) {
+        ESP_LOGE("SD_createProfileDb", "Header not fully written");
+        return ESP_FAIL;
+    }
+    for (long pos = sizeof(header); pos < SD_DB_HEADER_SIZE; ) {
+        long n = SD_DB_HEADER_SIZE - pos;
+        n = (n > sizeof(zero)) ? sizeof(zero) : n;
+        if (fwrite(zero, 1, n, db_file) != n) {
+            ESP_LOGE("SD_createProfileDb", "Header not fully written");
+            return ESP_FAIL;
+        }
+        pos += n;
+    }
 
-    return ESP_OK;
+    // b) records. Legacy profiles are imported, other slots are zero-filled
+    memset(db_bitmap, 0, sizeof(db_bitmap));
+    memset(db_crc, 0, sizeof(db_crc));
+    int imported = 0;
+    for (int i = 0; i < SD_DB_SLOTS; i++) {
+        SD_db_record_t *record = &db_window[0];
+        esp_err_t err = (old != NULL) ? SD_readOldProfile(old, i, record) : SD_readLegacyProfile(i, record);
+        if (err == ESP_OK) {
+            SD_bitmapWrite(i, true);
+            db_crc[i] = SD_recordCrc(record);
+            imported++;
+        } else {
+            memset(record, 0, sizeof(*record));
+        }
+        if (fwrite(record, 1, sizeof(*record), db_file) != sizeof(*record)) {
+            ESP_LOGE("SD_createProfileDb", "Record %d not fully written", i);
+            return ESP_FAIL;
+        }
+    }
+    db_window_start = -1;
+    db_window_count = 0;
+    ESP_LOGI("SD_createProfileDb", "Imported %d %s profiles", imported, (old != NULL) ? "migrated" : "legacy");
+
+    return SD_commitHeader();
 }
 
-esp_err_t SD_writeProfile(int profile_id, uint8_t *pin_p, int pin_n,
-    uint8_t *priv_p, int priv_n, uint8_t *fp_p, int fp_n) {
+// Create an empty database, preallocating every record, then import profiles
+// from old (a database with another slot count) or, if NULL, from legacy files.
+// A database that could not be completed is removed, not left for the next
+// boot to open
+static esp_err_t SD_createProfileDb(SD_old_db_t *old) {
+    ESP_LOGI("SD_createProfileDb", "Creating profile database %s", SD_DB_PATH);
 
-    const char* directory = "/sdcard/profiles/";
-    const char* fileName = "profile";
-    const char* fileType = ".bin";
+    db_file = fopen(SD_DB_PATH, "w+");
+    if (db_file == NULL) {
+        ESP_LOGE("SD_createProfileDb", "Failed to create database");
+        return ESP_FAIL;
+    }
 
-    char name_buffer[512];
+    esp_err_t err = SD_writeProfileDb(old);
+    if (err != ESP_OK) {
+        fclose(db_file);
+        db_file = NULL;
+        remove(SD_DB_PATH);
+        memset(db_bitmap, 0, sizeof(db_bitmap));
+        memset(db_crc, 0, sizeof(db_crc));
+    }
+    return err;
+}
+
+// Load the sync manifest. Missing or malformed manifests read as all zero
+static void SD_loadSyncManifest() {
+    uint32_t header[2];
 
-    sprintf(name_buffer, "%s%s%d%s", directory, fileName, profile_id, fileType);
-    ESP_LOGI("SD_writeProfile", "Writing to file %s", name_buffer);
+    memset(db_sync, 0, sizeof(db_sync));
+    db_sync_dirty = false;
 
-    // Open file
-    FILE* f = fopen(name_buffer, "w");
+    FILE *f = fopen(SD_SYNC_PATH, "r");
     if (f == NULL) {
-        ESP_LOGE("SD_writeProfile", "Failed to open file for writing");
-        return ESP_FAIL;
+        ESP_LOGI("SD_loadSyncManifest", "No sync manifest, sensor will be fully synced");
+        return;
+    }
+    if ((fread(header, 1, sizeof(header), f) != sizeof(header)) ||
+        (header[0] != SD_SYNC_MAGIC) || (header[1] != SD_DB_SLOTS) ||
+        (fread(db_sync, 1, sizeof(db_sync), f) != sizeof(db_sync))) {
+        ESP_LOGW("SD_loadSyncManifest", "Invalid sync manifest, sensor will be fully synced");
+        memset(db_sync, 0, sizeof(db_sync));
     }
+    fclose(f);
+}
+
+// Rebuild the database from SD_DB_OLD_PATH with SD_DB_SLOTS slots. The old
+// file is only removed once the new one is complete
+static esp_err_t SD_migrateProfileDb() {
+    SD_db_header_t header;
+    SD_old_db_t old = {0};
+    esp_err_t err;
 
-    // Write 4-byte PIN to file
-    if (fwrite(pin_p, sizeof(uint8_t), pin_n, f) != pin_n) {
-        ESP_LOGE("SD_writeProfile", "PIN not fully written");
+    old.f = fopen(SD_DB_OLD_PATH, "r");
+    if (old.f == NULL) {
+        ESP_LOGE("SD_migrateProfileDb", "Failed to open %s", SD_DB_OLD_PATH);
         return ESP_FAIL;
     }
+    err = SD_readDbHeader(old.f, &header);
+    if (err != ESP_OK) {
+        fclose(old.f);
+        return err;
+    }
+    ESP_LOGW("SD_migrateProfileDb", "Resizing database from %d to %d slots", header.slot_count, SD_DB_SLOTS);
+
+    old.slot_count = header.slot_count;
+    old.bitmap = malloc(SD_DB_BITMAP_SIZE_FOR(old.slot_count));
+    old.crc = malloc(old.slot_count * sizeof(uint32_t));
+    if ((old.bitmap == NULL) || (old.crc == NULL) ||
+        (fread(old.bitmap, 1, SD_DB_BITMAP_SIZE_FOR(old.slot_count), old.f) != SD_DB_BITMAP_SIZE_FOR(old.slot_count)) ||
+        (fread(old.crc, sizeof(uint32_t), old.slot_count, old.f) != old.slot_count)) {
+        ESP_LOGE("SD_migrateProfileDb", "Old directory not read");
+        err = ESP_FAIL;
+    } else {
+        for (int i = SD_DB_SLOTS; i < old.slot_count; i++) {
+            if ((old.bitmap[i >> 3] >> (i & 7)) & 1) {
+                ESP_LOGW("SD_migrateProfileDb", "Profile %d does not fit, dropped", i);
+            }
+        }
+        err = SD_createProfileDb(&old);
+    }
+
+    free(old.bitmap);
+    free(old.crc);
+    fclose(old.f);
+    if (err == ESP_OK) {
+        remove(SD_DB_OLD_PATH);
+    }
+    return err;
+}
+
+static esp_err_t SD_openProfileDb() {
+    struct stat st;
+    esp_err_t err;
+
+    if (db_file != NULL) {
+        return ESP_OK;
+    }
 
-    // Write 1-byte privilege to file
-    if (fwrite(priv_p, sizeof(uint8_t), priv_n, f) != priv_n) {
-        ESP_LOGE("SD_writeProfile", "Privilege not fully written");
+    SD_loadSyncManifest();
+
+    // A migration was interrupted: the new database is incomplete, redo it
+    if (stat(SD_DB_OLD_PATH, &st) == 0) {
+        remove(SD_DB_PATH);
+        return SD_migrateProfileDb();
+    }
+
+    db_file = fopen(SD_DB_PATH, "r+");
+    if (db_file == NULL) {
+        return SD_createProfileDb(NULL);
+    }
+
+    // Validate the header before trusting the directory
+    SD_db_header_t header;
+    err = SD_readDbHeader(db_file, &header);
+    if (err != ESP_OK) {
+        fclose(db_file);
+        db_file = NULL;
+        return err;
+    }
+    if (header.slot_count != SD_DB_SLOTS) {
+        // Capacity changed: rebuild with the new geometry
+        fclose(db_file);
+        db_file = NULL;
+        if (rename(SD_DB_PATH, SD_DB_OLD_PATH) != 0) {
+            ESP_LOGE("SD_openProfileDb", "Failed to move database aside");
+            return ESP_FAIL;
+        }
+        return SD_migrateProfileDb();
+    }
+
+    if ((fread(db_bitmap, 1, sizeof(db_bitmap), db_file) != sizeof(db_bitmap)) ||
+        (fread(db_crc, 1, sizeof(db_crc), db_file) != sizeof(db_crc))) {
+        ESP_LOGE("SD_openProfileDb", "Directory not fully read");
+        fclose(db_file);
+        db_file = NULL;
+        memset(db_bitmap, 0, sizeof(db_bitmap));
+        memset(db_crc, 0, sizeof(db_crc));
         return ESP_FAIL;
     }
+    db_window_start = -1;
+    db_window_count = 0;
+
+    return ESP_OK;
+}
+
+// Fill the read-ahead window starting at profile_id with a single read
+static esp_err_t SD_windowFill(int profile_id) {
+    int count = SD_DB_SLOTS - profile_id;
+    count = (count > SD_DB_READ_AHEAD) ? SD_DB_READ_AHEAD : count;
 
-    // Write 384x4 (1536) byte fingerprint template to file
-    if (fwrite(fp_p, sizeof(uint8_t), fp_n, f) != fp_n) {
-        ESP_LOGE("SD_writeProfile", "Fingerprint not fully written");
+    db_window_start = -1;
+    db_window_count = 0;
+    if (fseek(db_file, SD_recordOffset(profile_id), SEEK_SET) != 0) {
+        ESP_LOGE("SD_windowFill", "Failed to seek to profile %d", profile_id);
+        return ESP_FAIL;
+    }
+    if (fread(db_window, sizeof(SD_db_record_t), count, db_file) != count) {
+        ESP_LOGE("SD_windowFill", "Records %d-%d not fully read", profile_id, profile_id + count - 1);
         return ESP_FAIL;
     }
+    db_window_start = profile_id;
+    db_window_count = count;
+    return ESP_OK;
+}
+
+/**
+ * -------------------------------------
+ * Public API
+ * -------------------------------------
+ */
 
+bool SD_isProfileUsed(int profile_id) {
+    if ((profile_id < 0) || (profile_id >= SD_DB_SLOTS)) {
+        return false;
+    }
+    return SD_bitmapTest(profile_id);
+}
+
+uint32_t SD_getProfileCrc(int profile_id) {
+    if (!SD_isProfileUsed(profile_id)) {
+        return 0;
+    }
+    return db_crc[profile_id];
+}
+
+uint32_t SD_getSyncCrc(int profile_id) {
+    if ((profile_id < 0) || (profile_id >= SD_DB_SLOTS)) {
+        return 0;
+    }
+    return db_sync[profile_id];
+}
+
+void SD_setSyncCrc(int profile_id, uint32_t crc) {
+    if ((profile_id < 0) || (profile_id >= SD_DB_SLOTS)) {
+        return;
+    }
+    if (db_sync[profile_id] != crc) {
+        db_sync[profile_id] = crc;
+        db_sync_dirty = true;
+    }
+}
+
+esp_err_t SD_commitSyncManifest() {
+    if (!db_sync_dirty) {
+        return ESP_OK;
+    }
+
+    FILE *f = fopen(SD_SYNC_PATH, "w");
+    if (f == NULL) {
+        ESP_LOGE("SD_commitSyncManifest", "Failed to open manifest for writing");
+        return ESP_FAIL;
+    }
+    uint32_t header[2] = {SD_SYNC_MAGIC, SD_DB_SLOTS};
+    bool ok = (fwrite(header, 1, sizeof(header), f) == sizeof(header)) &&
+              (fwrite(db_sync, 1, sizeof(db_sync), f) == sizeof(db_sync));
     fclose(f);
+    if (!ok) {
+        ESP_LOGE("SD_commitSyncManifest", "Manifest not fully written");
+        return ESP_FAIL;
+    }
 
+    db_sync_dirty = false;
     return ESP_OK;
 }
 
-esp_err_t SD_deleteProfile(int profile_id) {
-    // Check if destination file exists before renaming
-    struct stat st;
-    const char* directory = "/sdcard/profiles/";
-    const char* fileName = "profile";
-    const char* fileType = ".bin";
+esp_err_t SD_readProfile(int profile_id, uint8_t *pin_p, int pin_n,
+    uint8_t *priv_p, int priv_n, uint8_t *fp_p, int fp_n) {
 
-    char name_buffer[512];
+    if ((profile_id < 0) || (profile_id >= SD_DB_SLOTS) ||
+        (pin_n > SD_DB_PIN_LEN) || (priv_n > SD_DB_PRIV_LEN) || (fp_n > SD_DB_FP_LEN)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (db_file == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
 
-    sprintf(name_buffer, "%s%s%d%s", directory, fileName, profile_id, fileType);
-    ESP_LOGI("SD_deleteProfile", "Looking for file %s", name_buffer);
+    // Empty slots are answered from the bitmap without touching the card
+    if (!SD_bitmapTest(profile_id)) {
+        return ESP_ERR_NOT_FOUND;
+    }
 
-    // Check if file exists
-    if (stat(name_buffer, &st) == 0) {
-        // Delete it if it exists
-        unlink(name_buffer);
-    } else {
-        ESP_LOGE("SD_deleteProfile", "profile %d does not exist", profile_id);
+    // Serve from the read-ahead window, refilling it if needed
+    if ((profile_id < db_window_start) || (profile_id >= db_window_start + db_window_count)) {
+        if (SD_windowFill(profile_id) != ESP_OK) {
+            return ESP_FAIL;
+        }
+    }
+    const SD_db_record_t *record = &db_window[profile_id - db_window_start];
+
+    if (SD_recordCrc(record) != db_crc[profile_id]) {
+        ESP_LOGE("SD_readProfile", "Profile %d failed CRC check", profile_id);
+        return ESP_ERR_INVALID_CRC;
     }
 
+    memcpy(pin_p, record->pin, pin_n);
+    memcpy(priv_p, record->privilege, priv_n);
+    memcpy(fp_p, record->fingerprint, fp_n);
+
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+esp_err_t SD_writeProfile(int profile_id, uint8_t *pin_p, int pin_n,
+    uint8_t *priv_p, int priv_n, uint8_t *fp_p, int fp_n) {
+
+    if ((profile_id < 0) || (profile_id >= SD_DB_SLOTS) ||
+        (pin_n > SD_DB_PIN_LEN) || (priv_n > SD_DB_PRIV_LEN) || (fp_n > SD_DB_FP_LEN)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (db_file == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    ESP_LOGI("SD_writeProfile", "Writing profile %d", profile_id);
+
+    // Build record. Unused bytes are zeroed so the CRC is reproducible
+    static SD_db_record_t record;
+    memset(&record, 0, sizeof(record));
+    memcpy(record.pin, pin_p, pin_n);
+    memcpy(record.privilege, priv_p, priv_n);
+    memcpy(record.fingerprint, fp_p, fp_n);
+
+    SD_windowInvalidate(profile_id);
+
+    // 1: Update record in place
+    if (fseek(db_file, SD_recordOffset(profile_id), SEEK_SET) != 0) {
+        ESP_LOGE("SD_writeProfile", "Failed to seek to profile %d", profile_id);
+        return ESP_FAIL;
+    }
+    if (fwrite(&record, 1, sizeof(record), db_file) != sizeof(record)) {
+        ESP_LOGE("SD_writeProfile", "Record not fully written");
+        return ESP_FAIL;
+    }
+
+    // 2: Commit directory. A torn record write is caught by the CRC on next read
+    SD_bitmapWrite(profile_id, true);
+    db_crc[profile_id] = SD_recordCrc(&record);
+    return SD_commitHeader();
+}
+
+esp_err_t SD_deleteProfile(int profile_id) {
+    if ((profile_id < 0) || (profile_id >= SD_DB_SLOTS)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (db_file == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!SD_bitmapTest(profile_id)) {
+        ESP_LOGE("SD_deleteProfile", "profile %d does not exist", profile_id);
+        return ESP_OK;
+    }
+
+    // Record contents are left in place; clearing the bitmap bit frees the slot
+    SD_windowInvalidate(profile_id);
+    SD_bitmapWrite(profile_id, false);
+    db_crc[profile_id] = 0;
+    return SD_commitHeader();
+}
@@ -2,6 +2,7 @@
 #define SD_INTERFACE_H_
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/unistd.h>
 #include <sys/stat.h>
@@ -32,7 +33,84 @@
  * \brief Provides command-level api to interact with the SD card reader
  */
 
+// Host builds mount the card somewhere else (see host_test)
+#ifndef MOUNT_POINT
 #define MOUNT_POINT "/sdcard"
+#endif
+
+/**
+ * Profile database layout
+ * All profiles live in one fixed-record file that is opened once by SD_init.
+ *  Offset              | Contents
+ *  ------------------- | -----------------------------------------------
+ *  0                   | SD_db_header_t (magic, version, geometry)
+ *  16                  | slot bitmap, 1 bit per slot (bit set = used)
+ *  16 + bitmap         | CRC32 directory, 1 word per slot
+ *  SD_DB_HEADER_SIZE   | SD_DB_SLOTS x SD_db_record_t
+ * The header is padded to a whole number of sectors so records never share a
+ * sector with the header, and records are word aligned. A database with a
+ * different slot count (CONFIG_EZ_MAX_PROFILES changed) is migrated at SD_init.
+ */
+#define SD_DB_PATH          MOUNT_POINT"/profiles.db"
+#define SD_DB_LEGACY_DIR    MOUNT_POINT"/profiles/"  // pre-database profile%d.bin files
+
+#define SD_DB_MAGIC         0x42445A45  // "EZDB"
+#define SD_DB_VERSION       1
+#ifdef CONFIG_EZ_MAX_PROFILES
+#define SD_DB_SLOTS         CONFIG_EZ_MAX_PROFILES  // same as MAX_PROFILES
+#else
+#define SD_DB_SLOTS         200
+#endif
+#define SD_DB_PIN_LEN       4
+#define SD_DB_PRIV_LEN      1
+#define SD_DB_FP_LEN        (384 * 4)   // R502 template size
+#define SD_DB_SECTOR_SIZE   512
+
+#define SD_DB_BITMAP_SIZE_FOR(slots)    ((((slots) + 31) / 32) * 4)
+#define SD_DB_HEADER_SIZE_FOR(slots)    ((((16 + SD_DB_BITMAP_SIZE_FOR(slots) + (slots) * 4) + \
+                                          SD_DB_SECTOR_SIZE - 1) / SD_DB_SECTOR_SIZE) * SD_DB_SECTOR_SIZE)
+#define SD_DB_BITMAP_SIZE   SD_DB_BITMAP_SIZE_FOR(SD_DB_SLOTS)
+#define SD_DB_HEADER_SIZE   SD_DB_HEADER_SIZE_FOR(SD_DB_SLOTS)
+#define SD_DB_OLD_PATH      MOUNT_POINT"/profiles.old"  // previous database while resizing
+
+#define SD_DB_READ_AHEAD    4           // records fetched per read of the database
+
+/**
+ * Sensor sync manifest
+ * Records, per slot, the database CRC of the template that was last loaded
+ * into the fingerprint sensor (0 if none). At boot, slots whose manifest entry
+ * matches the database CRC do not need to be downloaded to the sensor again,
+ * once one of their templates read back from the sensor matches the database
+ * (a swapped sensor gets everything).
+ *  Offset              | Contents
+ *  ------------------- | -----------------------------------------------
+ *  0                   | magic (SD_SYNC_MAGIC), slot count
+ *  8                   | SD_DB_SLOTS x CRC32
+ * A missing or truncated manifest reads as all zero (everything re-syncs).
+ */
+#define SD_SYNC_PATH        MOUNT_POINT"/r503sync.bin"
+#define SD_SYNC_MAGIC       0x4D535A45  // "EZSM"
+
+/**
+ * \brief Fixed part of the database header
+ */
+typedef struct SD_db_header_t {
+    uint32_t magic;         //!< SD_DB_MAGIC
+    uint16_t version;       //!< SD_DB_VERSION
+    uint16_t slot_count;    //!< number of records in the file
+    uint32_t record_size;   //!< sizeof(SD_db_record_t)
+    uint32_t reserved;
+} SD_db_header_t;
+
+/**
+ * \brief One profile record, stored at SD_DB_HEADER_SIZE + slot * sizeof(record)
+ */
+typedef struct SD_db_record_t {
+    uint8_t pin[SD_DB_PIN_LEN];         //!< 4-digit PIN
+    uint8_t privilege[SD_DB_PRIV_LEN];  //!< privilege level
+    uint8_t reserved[3];                //!< pad fingerprint to a word boundary
+    uint8_t fingerprint[SD_DB_FP_LEN];  //!< R502 character template
+} SD_db_record_t;
 
 // This example can use SDMMC and SPI peripherals to communicate with SD card.
 // By default, SDMMC peripheral is used.
@@ -69,28 +147,40 @@
 #endif //USE_SPI_MODE
 
 /**
- * \brief Initialize SD interface, must call first
- * \retval See vfy_pass for description of all possible return values
+ * \brief Initialize SD interface, must call first. Mounts the card and opens
+ * the profile database, creating it (and importing any legacy per-profile
+ * files) if it does not exist yet
+ * \retval ESP_OK: successful
+ *         ESP_FAIL: card could not be mounted or database could not be opened
+ *         ESP_ERR_INVALID_VERSION: database has an unknown layout
  */
 esp_err_t SD_init();
 
 /**
- * \brief Read profile contents from submodule buffer to SD card
- * \param profile_id Profile number, 1 to MAX_PROFILES
+ * \brief Read profile contents from SD card to submodule buffer
+ * \param profile_id Profile number, 0 to MAX_PROFILES-1
  * \param pin_p Pointer to PIN buffer
  * \param pin_n Size of PIN buffer
  * \param priv_p Pointer to privilege buffer
  * \param priv_n Size of privilege buffer
  * \param fp_p Pointer to fingerprint buffer
  * \param fp_n Size of fingerprint buffer
- * \retval See vfy_pass for description of all possible return values
+ * \retval ESP_OK: successful
+ *         ESP_ERR_NOT_FOUND: slot is empty
+ *         ESP_ERR_INVALID_ARG: profile_id or buffer size out of range
+ *         ESP_ERR_INVALID_CRC: record does not match its directory CRC
+ *         ESP_FAIL: read error
+ *
+ * Reads are served from a read-ahead window of SD_DB_READ_AHEAD records, so
+ * reading slots in ascending order costs one file read per window.
  */
 esp_err_t SD_readProfile(int profile_id, uint8_t *pin_p, int pin_n,
     uint8_t *priv_p, int priv_n, uint8_t *fp_p, int fp_n);
 
 /**
- * \brief Write profile contents from submodule buffer to SD card
- * \param profile_id Profile number, 1 to MAX_PROFILES
+ * \brief Write profile contents from submodule buffer to SD card. The record
+ * is updated in place, then its bitmap bit and CRC are committed
+ * \param profile_id Profile number, 0 to MAX_PROFILES-1
  * \param pin_p Pointer to PIN buffer
  * \param pin_n Size of PIN buffer
  * \param priv_p Pointer to privilege buffer
@@ -103,10 +193,45 @@ esp_err_t SD_writeProfile(int profile_id, uint8_t *pin_p, int pin_n,
     uint8_t *priv_p, int priv_n, uint8_t *fp_p, int fp_n);
 
 /**
- * \brief Delete profile contents in SD card
- * \param profile_id Profile number, 1 to MAX_PROFILES
+ * \brief Delete profile contents in SD card (clears the slot bitmap bit)
+ * \param profile_id Profile number, 0 to MAX_PROFILES-1
  * \retval See vfy_pass for description of all possible return values
  */
 esp_err_t SD_deleteProfile(int profile_id);
 
+/**
+ * \brief Check the slot bitmap without touching the card
+ * \param profile_id Profile number, 0 to MAX_PROFILES-1
+ * \retval true if the slot holds a profile
+ */
+bool SD_isProfileUsed(int profile_id);
+
+/**
+ * \brief Return the directory CRC of a profile record
+ * \param profile_id Profile number, 0 to MAX_PROFILES-1
+ * \retval CRC32 of the record, 0 if the slot is empty
+ */
+uint32_t SD_getProfileCrc(int profile_id);
+
+/**
+ * \brief Return the manifest CRC of the template loaded into the sensor
+ * \param profile_id Profile number, 0 to MAX_PROFILES-1
+ * \retval CRC32 of the record last loaded into the sensor, 0 if none
+ */
+uint32_t SD_getSyncCrc(int profile_id);
+
+/**
+ * \brief Update the manifest entry of a slot (in memory only)
+ * \param profile_id Profile number, 0 to MAX_PROFILES-1
+ * \param crc record CRC now loaded into the sensor, 0 if the slot was cleared
+ */
+void SD_setSyncCrc(int profile_id, uint32_t crc);
+
+/**
+ * \brief Write the sync manifest to the SD card if it changed
+ * \retval ESP_OK: successful
+ *         ESP_FAIL: write error
+ */
+esp_err_t SD_commitSyncManifest();
+
 #endif /* SD_INTERFACE_H_ */
\ No newline at end of file
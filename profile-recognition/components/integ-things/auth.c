@@ -0,0 +1,152 @@
+#include "auth.h"
+#include "input.h"
+#include "integ-things.h"
+
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+#include "CFAL1602.h" // PRIV_REQUIRES
+#include "latency-trace.h" // PRIV_REQUIRES
+extern CFAL1602Interface CFAL1602;
+
+/** --------------------------------------------------------------------------
+ * SUBSYSTEM    : integThings
+ * Components   :
+ *      - Profile recognition
+ * Description  : Authentication task, and the input task's side of it.
+ *      See auth.h
+ * --------------------------------------------------------------------------
+ */
+
+// externs to main function:
+extern bool isHelp;
+extern int accessAdmin;
+extern uint8_t flags;
+extern uint8_t ret_code;
+extern uint8_t privilege;
+
+static QueueHandle_t touch_queue = NULL;
+static QueueHandle_t result_queue = NULL;
+
+// private functions
+
+static void auth_pass_on(uint32_t io_num);
+static void auth_task(void* arg);
+
+// Hand a touch to the input task. Waits for room like the keypad does: the
+// claim is not held here, so the input task can always drain the queue
+static void auth_pass_on(uint32_t io_num) {
+    input_event_t event = {
+        .source = INPUT_EVENT_GPIO,
+        .gpio_num = io_num,
+    };
+    if (!input_post(&event, portMAX_DELAY)) {
+        ESP_LOGW("auth_task", "Touch on GPIO %d lost, no input queue", (int)io_num);
+    }
+}
+
+static void auth_task(void* arg) {
+    uint32_t io_num;
+    for (;;) {
+        if (!xQueueReceive(touch_queue, &io_num, portMAX_DELAY)) {
+            continue;
+        }
+
+        // 1: Claim the FSM in verifyUser, or the input task handles the touch.
+        // Also when inputs are queued: the input task may be between events
+        // without the claim, and those come first (a '*' leaving verifyUser)
+        if (gpio_get_level(io_num) || !input_try_acquire()) {
+            auth_pass_on(io_num);
+            continue;
+        }
+        if (input_pending() || ((flags & FL_FSM) != FL_VERIFYUSER) || isHelp) {
+            input_release();
+            auth_pass_on(io_num);
+            continue;
+        }
+
+        // 2: Take the touch's place in the input queue, for the display. It
+        // can't wait for room holding the claim: if the queue is full, the
+        // input task handles the touch once it has caught up
+        input_event_t scanning = { .source = INPUT_EVENT_AUTH };
+        if (!input_post(&scanning, 0)) {
+            input_release();
+            ESP_LOGW("auth_task", "Input queue full, touch passed on");
+            auth_pass_on(io_num);
+            continue;
+        }
+        LT_mark(LT_task_wake);
+
+        // 3: Capture and search. No display or log calls until the relay
+        auth_event_t event = { .privilege = 0, .admin = accessAdmin };
+        verifyUser_fingerprint_match(&event.match, &event.privilege, &event.res);
+        LT_mark(LT_outcome);
+
+        // 4: Decide: a door user gets the relay now, the display comes later
+        if ((event.match == FP_MATCH_found) && !event.admin) {
+            relay_pulse();
+        }
+        xQueueSend(result_queue, &event, portMAX_DELAY);
+        input_release();
+        LT_end();
+    }
+}
+
+// public functions
+
+esp_err_t auth_start(void) {
+    if (touch_queue != NULL) {
+        return ESP_OK;
+    }
+
+    // Queues before the task: it reads them from its first line
+    result_queue = xQueueCreate(AUTH_QUEUE_SIZE, sizeof(auth_event_t));
+    QueueHandle_t queue = xQueueCreate(AUTH_QUEUE_SIZE, sizeof(uint32_t));
+    if ((result_queue == NULL) || (queue == NULL)) {
+        return ESP_FAIL;
+    }
+    // From here the ISR hands touches over, they wait for the auth task
+    touch_queue = queue;
+
+    if (xTaskCreate(auth_task, "auth", AUTH_TASK_STACK_SIZE, NULL,
+        AUTH_TASK_PRIORITY, NULL) != pdPASS) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool IRAM_ATTR auth_touch_from_isr(uint32_t gpio_num) {
+    if (touch_queue == NULL) {
+        return false;
+    }
+    return xQueueSendFromISR(touch_queue, &gpio_num, NULL) == pdTRUE;
+}
+
+void auth_input_handler(void) {
+    auth_event_t event;
+
+    // 1: While the auth task matches. It doesn't touch the display or the
+    // PIN buffer, so no claim needed
+    // new input: stop showing the last outcome
+    WS2_msg_flush(&CFAL1602);
+
+    // clear PIN display and contents
+    print_buffer_clear();
+    verifyUser_fingerprint_scanning();
+
+    // 2: The outcome, before any input that came after the touch
+    xQueueReceive(result_queue, &event, portMAX_DELAY);
+    input_acquire();
+    verifyUser_fingerprint_result(event.match, event.res);
+
+    // handle all 5 verifyUser outcomes, relay already decided
+    accessAdmin = event.admin;
+    ret_code = (event.match == FP_MATCH_found) ? 0 : 1;
+    if (event.match == FP_MATCH_found) {
+        privilege = event.privilege;
+    }
+    verifyUser_outcome_show();
+    input_release();
+}
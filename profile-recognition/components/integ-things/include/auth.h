@@ -0,0 +1,60 @@
+#ifndef AUTH_H_
+#define AUTH_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "prof-recog.h"
+
+/**
+ * @brief Fingerprint authentication, apart from the display
+ *
+ * The auth task takes finger detect events straight from the ISR. In
+ * verifyUser it claims the FSM (see input.h), captures, searches, decides
+ * and pulses the relay the moment Search matches a door user, with no
+ * display or log calls on the way.
+ *
+ * For the display it posts an INPUT_EVENT_AUTH to the input queue when it
+ * starts, so the touch keeps its place among the other inputs, and the
+ * result to auth_input_handler, which the input task calls for that event.
+ *
+ * Touches it can't claim the FSM for (another input is being handled or
+ * queued, help is showing, addProfile, no room for the INPUT_EVENT_AUTH) go
+ * on to the input queue as INPUT_EVENT_GPIO, behind those inputs.
+ */
+
+#define AUTH_TASK_PRIORITY      15      // above the keypad and input tasks
+#define AUTH_TASK_STACK_SIZE    3072
+#define AUTH_QUEUE_SIZE         4       // touches and results waiting
+
+/**
+ * @brief A match, from the auth task to auth_input_handler
+ */
+typedef struct {
+    fp_match_t match;
+    uint8_t privilege;          //!< if found
+    R502_conf_code_t res;       //!< last R502 result
+    int admin;                  //!< accessAdmin the decision was made with
+} auth_event_t;
+
+/**
+ * @brief Start the auth task. After input_init
+ * @return ESP_OK, or ESP_FAIL if the task or its queues could not be created
+ */
+esp_err_t auth_start(void);
+
+/**
+ * @brief Hand a finger detect interrupt to the auth task. From the ISR
+ * @param gpio_num pin that interrupted
+ * @return true if queued, false before auth_start or if the queue is full
+ */
+bool auth_touch_from_isr(uint32_t gpio_num);
+
+/**
+ * @brief Show a touch the auth task took, for an INPUT_EVENT_AUTH: Scanning,
+ *        then the outcome once the match is done. From the input task,
+ *        without the FSM claim; takes it for the outcome
+ * @return none
+ */
+void auth_input_handler(void);
+
+#endif /* AUTH_H_ */
@@ -0,0 +1,92 @@
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include <stdbool.h>
+#include "esp_err.h"
+
+/**
+ * @brief One queue for every input, and the claim on the FSM
+ *
+ * Keypad presses, GPIO interrupts (door button, finger touches the auth task
+ * passes on) and touches the auth task took are all input_event_t on one
+ * queue, handled in the order they happened by the input task in main.
+ * Nothing is dropped while a handler runs: the next input waits in the
+ * queue.
+ *
+ * The FSM (flags, accessAdmin, the PIN buffer) belongs to whoever holds the
+ * claim. Two tasks take it with a compare and swap: the input task around
+ * each event, and the auth task around a fingerprint match. The auth task
+ * only tries (input_try_acquire) and passes the touch on to the queue if it
+ * can't; the input task waits (input_acquire).
+ */
+
+#define INPUT_QUEUE_SIZE    32      // a fast PIN and a touch, with room to spare
+
+typedef enum {
+    INPUT_EVENT_KEY,        //!< keypad press
+    INPUT_EVENT_GPIO,       //!< GPIO interrupt
+    INPUT_EVENT_AUTH,       //!< touch the auth task took, see auth.h
+} input_source_t;
+
+typedef struct {
+    input_source_t source;
+    char key;               //!< INPUT_EVENT_KEY
+    uint32_t gpio_num;      //!< INPUT_EVENT_GPIO
+} input_event_t;
+
+/**
+ * @brief Create the input queue. Before any input is posted
+ * @return ESP_OK, or ESP_FAIL if out of memory
+ */
+esp_err_t input_init(void);
+
+/**
+ * @brief Post an input to the end of the queue
+ * @param event input to post, copied
+ * @param ticks_to_wait how long to wait for room
+ * @return true if queued
+ */
+bool input_post(const input_event_t *event, TickType_t ticks_to_wait);
+
+/**
+ * @brief Post a GPIO interrupt. From the ISR
+ * @param gpio_num pin that interrupted
+ * @return true if queued, false before input_init or if the queue is full
+ */
+bool input_post_gpio_from_isr(uint32_t gpio_num);
+
+/**
+ * @brief Take the next input
+ * @param event filled in with the input
+ * @param ticks_to_wait how long to wait for one
+ * @return true if an input was taken
+ */
+bool input_receive(input_event_t *event, TickType_t ticks_to_wait);
+
+/**
+ * @brief Whether inputs are waiting in the queue
+ * @return true if at least one, false if empty or before input_init
+ */
+bool input_pending(void);
+
+/**
+ * @brief Claim the FSM if nobody has it. Lock-free, from any task
+ * @return true if claimed: release it with input_release
+ */
+bool input_try_acquire(void);
+
+/**
+ * @brief Claim the FSM, waiting for the holder to release it
+ * @return none
+ */
+void input_acquire(void);
+
+/**
+ * @brief Release the FSM claim, and what the holder wrote with it
+ * @return none
+ */
+void input_release(void);
+
+#endif /* INPUT_H_ */
@@ -21,6 +21,7 @@
 
 #define RELAY_OUTPUT 21
 #define DOOR_INPUT 22
+#define RELAY_PULSE_MS 1000     // door strike held open for
 
 /**
  * ------------------------------------------------
@@ -29,13 +30,13 @@
  */
 
 /**
- * @brief attempt to acquire lock
+ * @brief accept an input, from the input task holding the FSM claim
  *        - blocked if help is activated
- *        - successful acquire
+ *        - accepted: end any message dwell, the new input is shown at once
  * @param checkForHelp set true if blocked during help messages
- * @return true if lock successfully acquired
+ * @return true if the input is to be handled
  */
-bool my_acquire_lock(bool checkForHelp);
+bool my_accept_input(bool checkForHelp);
 
 /**
  * @brief clear print buffer
@@ -73,14 +74,35 @@ void restore_to_verifyUser();
 void restore_to_idleState();
 
 /**
- * @brief open door.
+ * @brief open door. Returns at once, the relay goes off on a timer
  *        - Toggle GPIO21 on (relay output)
  *        - print "door open"
- *        - Toggle GPIO21 off (relay output)
+ *        - Toggle GPIO21 off (relay output) RELAY_PULSE_MS later
  * @return none
  */
 void open_door();
 
+/**
+ * @brief create the relay off timer. Once, before any task can open the
+ *        door (input task, auth task)
+ * @return ESP_OK, or the esp_timer_create error
+ */
+esp_err_t relay_init();
+
+/**
+ * @brief relay side of open_door, no display or log calls. Needs relay_init
+ *        - Toggle GPIO21 on (relay output)
+ *        - Toggle GPIO21 off (relay output) RELAY_PULSE_MS later
+ * @return none
+ */
+void relay_pulse();
+
+/**
+ * @brief display side of open_door: print "door open" for the pulse
+ * @return none
+ */
+void print_door_open();
+
 /**
  * @brief toggle next admin control option 0-2. Choose direction
  *        - determine direction of toggle
@@ -115,4 +137,12 @@ void help_mode_handler();
  */
 void verifyUser_outcome_handler();
 
+/**
+ * @brief verifyUser_outcome_handler once the relay is decided: the screens
+ *        and state changes of all 5 outcomes, with the door already open for
+ *        a door user (see relay_pulse)
+ * @return none
+ */
+void verifyUser_outcome_show();
+
 #endif /* INTEG_THINGS_H_ */
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "input.h"
+
+#include "freertos/semphr.h"
+#include "esp_attr.h"
+
+/** --------------------------------------------------------------------------
+ * SUBSYSTEM    : integThings
+ * Components   :
+ *      - Profile recognition
+ * Description  : Input event queue and the FSM claim. See input.h
+ * --------------------------------------------------------------------------
+ */
+
+static QueueHandle_t input_queue = NULL;
+// the FSM claim, true while held. Only ever touched atomically
+static bool input_claimed = false;
+// given on every release, for input_acquire to try again
+static SemaphoreHandle_t input_released = NULL;
+
+// public functions
+
+esp_err_t input_init(void) {
+    if (input_queue != NULL) {
+        return ESP_OK;
+    }
+    input_released = xSemaphoreCreateBinary();
+    if (input_released == NULL) {
+        return ESP_FAIL;
+    }
+    input_queue = xQueueCreate(INPUT_QUEUE_SIZE, sizeof(input_event_t));
+    if (input_queue == NULL) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+bool input_post(const input_event_t *event, TickType_t ticks_to_wait) {
+    if (input_queue == NULL) {
+        return false;
+    }
+    return xQueueSend(input_queue, event, ticks_to_wait) == pdTRUE;
+}
+
+bool IRAM_ATTR input_post_gpio_from_isr(uint32_t gpio_num) {
+    if (input_queue == NULL) {
+        return false;
+    }
+    input_event_t event = {
+        .source = INPUT_EVENT_GPIO,
+        .gpio_num = gpio_num,
+    };
+    return xQueueSendFromISR(input_queue, &event, NULL) == pdTRUE;
+}
+
+bool input_receive(input_event_t *event, TickType_t ticks_to_wait) {
+    return xQueueReceive(input_queue, event, ticks_to_wait) == pdTRUE;
+}
+
+bool input_pending(void) {
+    if (input_queue == NULL) {
+        return false;
+    }
+    return uxQueueMessagesWaiting(input_queue) > 0;
+}
+
+bool input_try_acquire(void) {
+    bool expected = false;
+    return __atomic_compare_exchange_n(&input_claimed, &expected, true, false,
+        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+void input_acquire(void) {
+    while (!input_try_acquire()) {
+        xSemaphoreTake(input_released, portMAX_DELAY);
+    }
+}
+
+void input_release(void) {
+    __atomic_store_n(&input_claimed, false, __ATOMIC_RELEASE);
+    xSemaphoreGive(input_released);
+}
@@ -2,6 +2,8 @@
 
 // NEW
 #include "CFAL1602.h" // NEW: PRIV_REQUIRES
+#include "latency-trace.h" // PRIV_REQUIRES
+#include "esp_timer.h"
 extern CFAL1602Interface CFAL1602;
 
 
@@ -22,7 +24,7 @@ extern CFAL1602Interface CFAL1602;
 extern bool isHelp;
 
 extern int accessAdmin; // currently seeking admin mode (by pressing admin query button)
-extern volatile uint8_t flags; // used to track inputs
+extern uint8_t flags; // used to track inputs
 
 extern char * pinCharTemp;
 extern char pinChar[17];
@@ -36,8 +38,16 @@ char * help2;
 
 
 
+static esp_timer_handle_t relay_timer = NULL;
+
 // private functions
 
+// end of the door pulse, on the esp_timer task
+static void relay_off(void* arg) {
+    // Toggle GPIO21 off (relay output)
+    gpio_set_level((gpio_num_t)RELAY_OUTPUT, 0); // turn off relay (GPIO21)
+}
+
 // public functions
 
 /**
@@ -46,18 +56,14 @@ char * help2;
  * ------------------------------------------------
  */
 
-bool my_acquire_lock(bool checkForHelp) {
-    if (!(flags & FL_INPUT_READY)) {
-        printf("Wait\n");
-        return false;
-    }
+bool my_accept_input(bool checkForHelp) {
     // blocked if help is activated
     if (checkForHelp && isHelp) {
         printf("Turn off help before trying again\n");
         return false;
     }
-    // successful acquire
-    flags &= ~FL_INPUT_READY;
+    // new input: stop showing the last outcome
+    WS2_msg_flush(&CFAL1602);
     return true;
 }
 
@@ -114,19 +120,37 @@ void restore_to_idleState() {
     WS2_msg_print(&CFAL1602, item1, 1, false);
 }
 
-void open_door() {
+esp_err_t relay_init() {
+    if (relay_timer != NULL) {
+        return ESP_OK;
+    }
+    esp_timer_create_args_t relay_timer_args = {
+        .callback = &relay_off,
+        .name = "relay_off"
+    };
+    return esp_timer_create(&relay_timer_args, &relay_timer);
+}
+
+void relay_pulse() {
     // Toggle GPIO21 on (relay output)
     gpio_set_level((gpio_num_t)RELAY_OUTPUT, 1); // turn on relay (GPIO21)
+    LT_mark(LT_relay);
 
+    // Toggle GPIO21 off in RELAY_PULSE_MS. Opening again restarts the pulse
+    esp_timer_stop(relay_timer);
+    ESP_ERROR_CHECK(esp_timer_start_once(relay_timer, RELAY_PULSE_MS * 1000));
+}
+
+void print_door_open() {
     // Print 0: Door open (1 second)
     // Print 1: 
-    WS2_msg_print(&CFAL1602, door_open, 0, false);
-    WS2_msg_clear(&CFAL1602, 1);
+    WS2_msg_screen(&CFAL1602, door_open, "", WS2_prio_outcome, RELAY_PULSE_MS);
     printf("Hello there, opening door\n");
-    vTaskDelay(1000 / portTICK_PERIOD_MS);
+}
 
-    // Toggle GPIO21 off (relay output)
-    gpio_set_level((gpio_num_t)RELAY_OUTPUT, 0); // turn off relay (GPIO21)
+void open_door() {
+    relay_pulse();
+    print_door_open();
 }
 
 void idleState_toggle_menu(bool increasing) {
@@ -201,6 +225,16 @@ void help_mode_handler() {
  */
 
 void verifyUser_outcome_handler() {
+    LT_mark(LT_outcome);
+
+    // open the door first, then show it
+    if ((ret_code == 0x0) && !accessAdmin) {
+        relay_pulse();
+    }
+    verifyUser_outcome_show();
+}
+
+void verifyUser_outcome_show() {
     // case 1: bad fingerprint, denied
     if (ret_code != 0x0) {
         // reset system to verifyUser initial state.
@@ -213,15 +247,12 @@ void verifyUser_outcome_handler() {
             if (privilege) {
                 // Print 0: Access granted (0.5 seconds)
                 // Print 1:
-                WS2_msg_print(&CFAL1602, access_granted, 0, false);
-                WS2_msg_clear(&CFAL1602, 1);
+                WS2_msg_screen(&CFAL1602, access_granted, "", WS2_prio_outcome, 500);
                 printf("Access granted\n");
-                vTaskDelay(500 / portTICK_PERIOD_MS);
 
                 // Print 0: Entering admin.. (1 second)
-                WS2_msg_print(&CFAL1602, entering_admin, 0, false);
+                WS2_msg_screen(&CFAL1602, entering_admin, NULL, WS2_prio_status, 1000);
                 printf("Entering admin..\n");
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
                 
                 // reset system to idleState initial state.
                 restore_to_idleState();
@@ -232,10 +263,8 @@ void verifyUser_outcome_handler() {
             else {
                 // Print 0: Access denied (1 second)
                 // Print 1:
-                WS2_msg_print(&CFAL1602, access_denied, 0, false);
-                WS2_msg_clear(&CFAL1602, 1);
+                WS2_msg_screen(&CFAL1602, access_denied, "", WS2_prio_outcome, 1000);
                 printf("Sorry, not admin\n");
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
 
                 // reset system to verifyUser initial state.
                 restore_to_verifyUser();
@@ -247,13 +276,11 @@ void verifyUser_outcome_handler() {
         else {
             // Print 0: Access granted (0.5 second)
             // Print 1:
-            WS2_msg_print(&CFAL1602, access_granted, 0, false);
-            WS2_msg_clear(&CFAL1602, 1);
+            WS2_msg_screen(&CFAL1602, access_granted, "", WS2_prio_outcome, 500);
             printf("Access granted\n");
-            vTaskDelay(500 / portTICK_PERIOD_MS);
 
-            // open door.
-            open_door();
+            // door open (relay already pulsed)
+            print_door_open();
 
             // reset system to verifyUser initial state
             restore_to_verifyUser();
@@ -0,0 +1,107 @@
+#ifndef LATENCY_TRACE_H_
+#define LATENCY_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * \brief Finger to unlock latency, broken down by stage
+ *
+ * A trace follows one touch through the verify user path. The finger detect
+ * interrupt starts it, the auth task claims it when it takes the touch (or
+ * the input task, when the touch is passed on to it through the input
+ * queue), and the trace points along the capture, search, outcome and relay
+ * stamp it with esp_timer_get_time.
+ * LT_end folds the stages that were reached into per-stage histograms.
+ *
+ * Points stamped by any other task, or while no trace is running, are
+ * ignored, so the shared functions (open_door, the outcome handler) can be
+ * traced unconditionally. A touch in add profile mode is traced the same way
+ * and stops after Img2Tz.
+ *
+ * The histograms have 4 buckets per power of two microseconds, so p50 and
+ * p99 are within 19% (reported as the top of their bucket), min and max are
+ * exact. LT_console_start lets them be read and reset over the console.
+ */
+
+/**
+ * \brief Trace points, in the order the verify user path reaches them
+ */
+typedef enum {
+    LT_finger_irq,      //!< GPIO4 finger detect interrupt, starts the trace
+    LT_task_wake,       //!< touch taken by the auth or input task, claims the trace
+    LT_scan_start,      //!< about to send GenImg
+    LT_gen_img,         //!< GenImg acknowledged
+    LT_img_2_tz,        //!< Img2Tz acknowledged
+    LT_search,          //!< Search acknowledged
+    LT_outcome,         //!< verifyUser_outcome_handler entered
+    LT_relay,           //!< relay energized
+    LT_point_count
+} LT_point_t;
+
+/**
+ * \brief The stage ending at each point (from the point before it), then
+ * the whole of finger to relay
+ */
+#define LT_STAGE_TOTAL  LT_point_count
+#define LT_STAGE_COUNT  (LT_point_count + 1)
+
+#define LT_CONSOLE_STACK_SIZE 3072
+
+/**
+ * \brief Summary of one stage's histogram, in microseconds
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+} LT_stage_stats_t;
+
+/**
+ * \brief Start a trace, from the finger detect interrupt. Does nothing if
+ * one is already running, unless no task claimed it for 10 seconds
+ */
+void LT_start_from_isr(void);
+
+/**
+ * \brief Stamp point on the running trace
+ *
+ * LT_task_wake claims the trace for the calling task, later points are only
+ * taken from that task.
+ */
+void LT_mark(LT_point_t point);
+
+/**
+ * \brief End the running trace and add its stages to the histograms. Only
+ * a trace that reached the relay counts toward finger to relay
+ */
+void LT_end(void);
+
+/**
+ * \brief Clear the histograms
+ */
+void LT_reset(void);
+
+/**
+ * \brief Summary of a stage
+ * \param stage LT_point_t of the point ending it (LT_task_wake and on), or
+ * LT_STAGE_TOTAL
+ * \param stats OUT all zero if the stage has no samples
+ */
+void LT_get_stats(int stage, LT_stage_stats_t *stats);
+
+/**
+ * \brief Print every stage as a table: count, min, p50, p99 and max in ms
+ */
+void LT_print(FILE *out);
+
+/**
+ * \brief Start a task that reads console lines: "lat" prints the table,
+ * "lat reset" clears the histograms
+ */
+void LT_console_start(int priority);
+
+#endif
@@ -0,0 +1,240 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_attr.h"
+#include "latency-trace.h"
+
+// 4 buckets per power of two: values under 4 us get one bucket each, then
+// [4,5) [5,6) [6,7) [7,8) [8,10) ... up to 2^32 us
+#define LT_SUB_BITS     2
+#define LT_SUB_COUNT    (1 << LT_SUB_BITS)
+#define LT_BUCKETS      ((32 - LT_SUB_BITS + 1) << LT_SUB_BITS)
+
+// An unclaimed trace this old lost its touch (touch or input queue full), start over
+#define LT_STALE_US     10000000
+
+// Console line, "lat reset" and some slack
+#define LT_LINE_LEN     32
+// stdin returns EOF while the UART has nothing, poll it this often
+#define LT_CONSOLE_POLL_MS 100
+
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t buckets[LT_BUCKETS];
+} LT_histogram_t;
+
+typedef struct {
+    bool active;
+    TaskHandle_t owner;         // NULL until LT_task_wake
+    uint32_t seen;              // bit per LT_point_t stamped
+    int64_t time_us[LT_point_count];
+} LT_trace_t;
+
+static const char *stage_names[LT_STAGE_COUNT] = {
+    [LT_task_wake] = "queue",
+    [LT_scan_start] = "pre-scan",
+    [LT_gen_img] = "GenImg",
+    [LT_img_2_tz] = "Img2Tz",
+    [LT_search] = "Search",
+    [LT_outcome] = "to outcome",
+    [LT_relay] = "to relay",
+    [LT_STAGE_TOTAL] = "finger to relay",
+};
+
+static portMUX_TYPE lt_mux = portMUX_INITIALIZER_UNLOCKED;
+static LT_trace_t trace;
+// Index 0 (LT_finger_irq) ends no stage and stays empty
+static LT_histogram_t histograms[LT_STAGE_COUNT];
+
+// Private functions
+
+static int bucket_of(uint32_t us);
+static uint32_t bucket_top(int bucket);
+static void histogram_add(LT_histogram_t *histogram, int64_t us);
+static uint32_t histogram_percentile(const LT_histogram_t *histogram, int percent);
+static void console_task(void *arg);
+
+static int bucket_of(uint32_t us)
+{
+    if(us < LT_SUB_COUNT) return us;
+    int msb = 31 - __builtin_clz(us);
+    int shift = msb - LT_SUB_BITS;
+    return ((shift + 1) << LT_SUB_BITS) + ((us >> shift) & (LT_SUB_COUNT - 1));
+}
+
+static uint32_t bucket_top(int bucket)
+{
+    if(bucket < LT_SUB_COUNT) return bucket;
+    int shift = (bucket >> LT_SUB_BITS) - 1;
+    uint64_t bottom = (uint64_t)(LT_SUB_COUNT | (bucket & (LT_SUB_COUNT - 1))) << shift;
+    return bottom + (1ULL << shift) - 1;
+}
+
+static void histogram_add(LT_histogram_t *histogram, int64_t us)
+{
+    // A stage can't take negative time, or longer than 71 minutes
+    if(us < 0) us = 0;
+    if(us > UINT32_MAX) us = UINT32_MAX;
+    uint32_t value = us;
+
+    if(histogram->count == 0 || value < histogram->min_us) histogram->min_us = value;
+    if(histogram->count == 0 || value > histogram->max_us) histogram->max_us = value;
+    histogram->count++;
+    histogram->buckets[bucket_of(value)]++;
+}
+
+static uint32_t histogram_percentile(const LT_histogram_t *histogram, int percent)
+{
+    // Rank of the sample at percent, rounded up: p50 of 1 sample is that sample
+    uint32_t rank = ((uint64_t)histogram->count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for(int i = 0; i < LT_BUCKETS; i++){
+        seen += histogram->buckets[i];
+        if(seen >= rank){
+            // The top of the bucket, but never outside what was measured
+            uint32_t top = bucket_top(i);
+            if(top > histogram->max_us) top = histogram->max_us;
+            if(top < histogram->min_us) top = histogram->min_us;
+            return top;
+        }
+    }
+    return histogram->max_us;
+}
+
+static void console_task(void *arg)
+{
+    char line[LT_LINE_LEN];
+    size_t len = 0;
+    for(;;){
+        int c = getchar();
+        if(c == EOF){
+            clearerr(stdin);
+            vTaskDelay(LT_CONSOLE_POLL_MS / portTICK_PERIOD_MS);
+            continue;
+        }
+        if(c != '\n' && c != '\r'){
+            // Overlong lines are kept short and won't match a command
+            if(len < sizeof(line) - 1) line[len++] = c;
+            continue;
+        }
+        line[len] = '\0';
+        len = 0;
+
+        if(strcmp(line, "lat") == 0){
+            LT_print(stdout);
+        }
+        else if(strcmp(line, "lat reset") == 0){
+            LT_reset();
+            printf("Latency histograms cleared\n");
+        }
+        else if(line[0] != '\0'){
+            printf("Commands: lat, lat reset\n");
+        }
+    }
+}
+
+// Public functions
+
+void IRAM_ATTR LT_start_from_isr(void)
+{
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL_ISR(&lt_mux);
+    bool stale = trace.owner == NULL &&
+        now - trace.time_us[LT_finger_irq] > LT_STALE_US;
+    if(!trace.active || stale){
+        trace.active = true;
+        trace.owner = NULL;
+        trace.seen = 1 << LT_finger_irq;
+        trace.time_us[LT_finger_irq] = now;
+    }
+    portEXIT_CRITICAL_ISR(&lt_mux);
+}
+
+void LT_mark(LT_point_t point)
+{
+    if(point <= LT_finger_irq || point >= LT_point_count) return;
+    int64_t now = esp_timer_get_time();
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&lt_mux);
+    if(trace.active){
+        if(point == LT_task_wake && trace.owner == NULL){
+            trace.owner = self;
+        }
+        // Only the first stamp of a point counts, a retry is part of its stage
+        if(trace.owner == self && !(trace.seen & (1 << point))){
+            trace.seen |= 1 << point;
+            trace.time_us[point] = now;
+        }
+    }
+    portEXIT_CRITICAL(&lt_mux);
+}
+
+void LT_end(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    portENTER_CRITICAL(&lt_mux);
+    if(!trace.active || trace.owner != self){
+        portEXIT_CRITICAL(&lt_mux);
+        return;
+    }
+    for(int point = LT_task_wake; point < LT_point_count; point++){
+        uint32_t both = (1 << point) | (1 << (point - 1));
+        if((trace.seen & both) == both){
+            histogram_add(&histograms[point],
+                trace.time_us[point] - trace.time_us[point - 1]);
+        }
+    }
+    if(trace.seen & (1 << LT_relay)){
+        histogram_add(&histograms[LT_STAGE_TOTAL],
+            trace.time_us[LT_relay] - trace.time_us[LT_finger_irq]);
+    }
+    trace.active = false;
+    portEXIT_CRITICAL(&lt_mux);
+}
+
+void LT_reset(void)
+{
+    portENTER_CRITICAL(&lt_mux);
+    memset(histograms, 0, sizeof(histograms));
+    portEXIT_CRITICAL(&lt_mux);
+}
+
+void LT_get_stats(int stage, LT_stage_stats_t *stats)
+{
+    memset(stats, 0, sizeof(LT_stage_stats_t));
+    if(stage <= LT_finger_irq || stage >= LT_STAGE_COUNT) return;
+
+    portENTER_CRITICAL(&lt_mux);
+    const LT_histogram_t *histogram = &histograms[stage];
+    if(histogram->count){
+        stats->count = histogram->count;
+        stats->min_us = histogram->min_us;
+        stats->p50_us = histogram_percentile(histogram, 50);
+        stats->p99_us = histogram_percentile(histogram, 99);
+        stats->max_us = histogram->max_us;
+    }
+    portEXIT_CRITICAL(&lt_mux);
+}
+
+void LT_print(FILE *out)
+{
+    LT_stage_stats_t stats;
+    fprintf(out, "%-16s %6s %9s %9s %9s %9s  (ms)\n", "stage", "count", "min", "p50", "p99",
+        "max");
+    for(int stage = LT_task_wake; stage < LT_STAGE_COUNT; stage++){
+        LT_get_stats(stage, &stats);
+        fprintf(out, "%-16s %6u %9.1f %9.1f %9.1f %9.1f\n", stage_names[stage],
+            (unsigned)stats.count, stats.min_us / 1000.0, stats.p50_us / 1000.0,
+            stats.p99_us / 1000.0, stats.max_us / 1000.0);
+    }
+}
+
+void LT_console_start(int priority)
+{
+    xTaskCreate(console_task, "lt_console", LT_CONSOLE_STACK_SIZE, NULL, priority, NULL);
+}
@@ -1,8 +1,9 @@
 #ifndef PROF_RECOG_H_
 #define PROF_RECOG_H_
 
+#include "sdkconfig.h"
 #include "R502Interface.h"
-#include "SD-Interface.h"
+#include "SD-interface.h"
 
 //#include "CFAL1602.h"
 
@@ -21,8 +22,7 @@
  */
 
 // TEMP: May need to move to its own header
-#define FL_INPUT_READY      0x01    // if 0, reject all input entries (finger, ENTER key)
-
+// 0x01 free: inputs wait for the FSM claim instead, see input.h
 #define FL_PROFILEID        0x02    // profile id (deleteProfile)
 #define FL_FP_0             0x04    // finger entry 1 (verifyUser, addProfile)
 #define FL_FP_1             0x08    // finger entry 2 (addProfile)
@@ -36,17 +36,33 @@
 #define FL_DELETEPROFILE    0x80    // fsm = 2
 #define FL_ADDPROFILE       0xC0    // fsm = 3
 
+// Number of profile slots, set through menuconfig (Profile recognition)
+#ifdef CONFIG_EZ_MAX_PROFILES
+#define MAX_PROFILES CONFIG_EZ_MAX_PROFILES
+#else
 #define MAX_PROFILES 200
+#endif
+
+// 1: at boot, only download templates that differ from the R503 library
+//    (compared through the SD sync manifest). 0: empty the R503 and reload
+//    every template on each boot
+#define PROFILE_FAST_BOOT 1
+
+// Extra GenImg attempts while the R503 reports no finger, for a finger still
+// landing when the touch interrupt fires
+#define GENIMG_RETRIES 3
 
 /**
- * \brief Profile buffer array containing non-fingerprint data
+ * \brief Copy of one profile's non-fingerprint data, as returned by
+ * profile_idx_getCurrProfile. Profiles themselves are stored packed; use
+ * the profile_* accessors to read a given slot
  */
 typedef struct profile_t {
     uint8_t isUsed;
     uint8_t PIN[4];
     uint8_t privilege;
-    int idx;
-} profile_t; // index of array = position
+    int idx;            //!< slot of the profile
+} profile_t;
 
 /**
  * @brief externally defined CFAL1602 struct, defined in main
@@ -68,7 +84,39 @@ typedef struct profile_t {
 esp_err_t profileRecog_init();
 
 /**
- * \brief Search the library for profile with matching fingerprint
+ * \brief Outcome of verifyUser_fingerprint_match
+ */
+typedef enum {
+    FP_MATCH_found,         //!< the finger matches a profile
+    FP_MATCH_bad_entry,     //!< GenImg or Img2Tz failed
+    FP_MATCH_not_found,     //!< Search found no match
+} fp_match_t;
+
+/**
+ * \brief Sensor side of verifyUser_fingerprint: capture, Img2Tz and Search,
+ * with no display or log calls
+ * \param match OUT outcome
+ * \param privilege OUT privilege of the matching profile, set if found
+ * \param res OUT confirmation code of the last R502 command
+ * \retval ESP_OK if found
+ */
+esp_err_t verifyUser_fingerprint_match(fp_match_t *match, uint8_t *privilege,
+    R502_conf_code_t *res);
+
+/**
+ * \brief Show that a capture is under way (display and log)
+ */
+void verifyUser_fingerprint_scanning();
+
+/**
+ * \brief Show a bad entry or a denial (display and log). A match is shown
+ * by verifyUser_outcome_handler
+ */
+void verifyUser_fingerprint_result(fp_match_t match, R502_conf_code_t res);
+
+/**
+ * \brief Search the library for profile with matching fingerprint. Blocking,
+ * with display calls, see verifyUser_fingerprint_match for the sensor only
  * \param flags status flags
  * \param ret_code OUT for the return code
  * \param privilege OUT for the privilege level of verified users
@@ -149,21 +197,42 @@ void profile_idx_reset();
 
 /**
  * \brief from current seeker position, return profile slot
- * \return 0-199: profile id of full slot. -1: all slots are empty (improbable)
+ * \return copy of the profile at the seeker position. Overwritten by the next call
  */
 profile_t * profile_idx_getCurrProfile();
 
+/**
+ * \brief check if a profile slot is in use
+ * \param profile_id slot, 0 to MAX_PROFILES-1
+ * \retval true if used, false if free or out of range
+ */
+bool profile_isUsed(int profile_id);
+
+/**
+ * \brief get the PIN of a profile
+ * \param profile_id slot, 0 to MAX_PROFILES-1
+ * \param PIN OUT for the 4 PIN digits
+ */
+void profile_getPIN(int profile_id, uint8_t *PIN);
+
+/**
+ * \brief get the privilege level of a profile (0-3)
+ * \param profile_id slot, 0 to MAX_PROFILES-1
+ * \retval privilege level
+ */
+uint8_t profile_getPrivilege(int profile_id);
+
 /**
  * \brief from current seeker position, find next empty slot
  * \param direction true if forward, false if backward
- * \return 0-199: profile id of empty slot. -1: all slots are filled
+ * \return 0 to MAX_PROFILES-1: profile id of empty slot. -1: all slots are filled
  */
 int profile_idx_seekEmptySlot(bool direction);
 
 /**
  * \brief from current seeker position, find next full slot
  * \param direction true if forward, false if backward
- * \return 0-199: profile id of full slot. -1: all slots are empty (improbable)
+ * \return 0 to MAX_PROFILES-1: profile id of full slot. -1: all slots are empty (improbable)
  */
 int profile_idx_seekFullSlot(bool direction);
 
@@ -1,7 +1,9 @@
 #include "prof-recog.h"
+#include "freertos/queue.h"
 
 // NEW
 #include "CFAL1602.h" // NEW: PRIV_REQUIRES
+#include "latency-trace.h" // PRIV_REQUIRES
 extern CFAL1602Interface CFAL1602;
 
 
@@ -32,29 +34,75 @@ static uint8_t fingerprintBuffer[R502_TEMPLATE_SIZE];    // temp storage for fin
 static uint8_t pinBuffer[4];           // temp storage for PIN (addProfile)
 static uint8_t privBuffer;             // temp storage for privilege (addProfile)
 
-profile_t profiles[MAX_PROFILES] = {
-    {
-        .isUsed = 1,    // Slot 0. Default admin profile (no fingerprint)
-        .PIN = {1, 2, 3, 4},
-        .privilege = 1,
-        .idx = 0,
-    },                  /// Slots 1-199. Deallocated. Not seen
-};
+// Profile table, stored as parallel arrays indexed by slot. A slot is in use
+// if its bit is set in slot_used. Slot 0 is the default admin profile (no
+// fingerprint); other slots start deallocated
+#define PIN_INVALID 0xFFFF
+static uint16_t profile_pin[MAX_PROFILES] = {1234};         // packed PIN (see pin_pack)
+static uint8_t profile_priv[(MAX_PROFILES + 3) / 4] = {1};  // 2-bit privilege per slot
+static profile_t curr_profile;                              // profile_idx_getCurrProfile view
 
 int profile_idx = 0; // index of profile in profiles. Initialized to 0 (factory set profile)
 
+// PIN index: packed 4-digit PIN (0-9999) -> profile slot + 1 (0 = PIN unused)
+#define PIN_INDEX_SIZE 10000
+static uint16_t pin_index[PIN_INDEX_SIZE];
+
 // useful extern for integ-things
 extern char pinChar[17];
 
-R502_data_len_t starting_data_len;
 static R502_conf_code_t conf_code;
 static R502_sys_para_t sys_para;
-static uint16_t page_id;
-static uint16_t match_score;
-static int up_char_size = 0;
 
 static int numProfilesFull = 1;
 
+// Slot allocator: bit set = slot used.
+// Searches test 32 slots per word, so they stay short as MAX_PROFILES grows
+#define SLOT_WORDS ((MAX_PROFILES + 31) / 32)
+static uint32_t slot_used[SLOT_WORDS] = {0x1};  // slot 0: default admin profile
+static int slot_capacity = MAX_PROFILES;        // slots the R503 library can hold
+
+// Boot import pipeline: reader task (SD) fills import_ring, init task (R503) drains it
+#define IMPORT_RING_SIZE 3
+
+typedef struct import_slot_t {
+    int profile_id;                             // -1 marks end of import
+    esp_err_t err;                              // SD_readProfile result
+    uint8_t PIN[4];
+    uint8_t privilege;
+    uint8_t fingerprint[R502_TEMPLATE_SIZE];
+} import_slot_t;
+
+typedef struct import_stats_t {
+    int64_t read_us;        // reader: time in SD_readProfile
+    int64_t read_wait_us;   // reader: time waiting for a free buffer
+    int64_t down_us;        // loader: time in R502_down_char
+    int64_t store_us;       // loader: time in R502_store
+    int64_t load_wait_us;   // loader: time waiting for a filled buffer
+    int read_count;
+    int load_count;
+    int skip_count;         // loader: already in sync with the R503
+    int delete_count;       // R503 templates with no matching profile
+} import_stats_t;
+
+static import_slot_t import_ring[IMPORT_RING_SIZE];
+static QueueHandle_t import_free_queue = NULL;  // import_slot_t* ready to be filled
+static QueueHandle_t import_full_queue = NULL;  // import_slot_t* ready to be loaded
+static volatile bool import_abort;              // set by loader to stop the reader early
+static import_stats_t import_stats;
+
+// R503 library state at boot. Bit set if the R503 holds a template in the slot
+static uint8_t sensor_library[(MAX_PROFILES + 7) / 8];
+// Slots whose R503 template is known to match the SD card after import
+static uint8_t import_loaded[(MAX_PROFILES + 7) / 8];
+// The manifest is only trusted once a template it names was read back from
+// the R503 and matched: a swapped or re-enrolled sensor has other templates
+static bool sync_checked;
+static bool sync_trusted;
+
+#define BIT_TEST(map, i) (((map)[(i) >> 3] >> ((i) & 7)) & 1)
+#define BIT_SET(map, i) ((map)[(i) >> 3] |= (1 << ((i) & 7)))
+
 // The object under test
 R502Interface R502 = {
     .up_image_cb = NULL,
@@ -73,6 +121,159 @@ R502Interface R502 = {
 };
 
 
+// Pack a 4-digit PIN into its pin_index key. Returns -1 if a digit is out of range
+static int pin_pack(const uint8_t *PIN) {
+    int key = 0;
+    for (int j = 0; j < 4; j++) {
+        if (PIN[j] > 9) {
+            return -1;
+        }
+        key = key * 10 + PIN[j];
+    }
+    return key;
+}
+
+// Return slot of the profile using PIN, or -1 if none
+static int pin_index_find(const uint8_t *PIN) {
+    int key = pin_pack(PIN);
+    if (key < 0 || pin_index[key] == 0) {
+        return -1;
+    }
+    return pin_index[key] - 1;
+}
+
+// Index the PIN of a slot. Must be called after the slot is filled.
+// addProfile refuses a PIN in use, but an imported database may share one:
+// the lowest slot holding it is indexed, as a scan of the slots would find
+static void pin_index_add(int slot) {
+    int key = profile_pin[slot];
+    if (key == PIN_INVALID) {
+        ESP_LOGW("pin_index", "Profile %d has an invalid PIN, not indexed", slot);
+        return;
+    }
+    if (pin_index[key] != 0 && pin_index[key] != slot + 1) {
+        ESP_LOGW("pin_index", "Profile %d shares its PIN with profile %d", slot, pin_index[key] - 1);
+        if (pin_index[key] < slot + 1) {
+            return;
+        }
+    }
+    pin_index[key] = slot + 1;
+}
+
+// Unindex the PIN of a slot. Must be called before the slot is cleared.
+// If another profile shares the PIN, it is indexed instead
+static void pin_index_remove(int slot) {
+    int key = profile_pin[slot];
+    if (key == PIN_INVALID || pin_index[key] != slot + 1) {
+        return;
+    }
+    pin_index[key] = 0;
+    for (int i = slot + 1; i < MAX_PROFILES; i++) {
+        if (profile_isUsed(i) && profile_pin[i] == key) {
+            pin_index[key] = i + 1;
+            return;
+        }
+    }
+}
+
+// Mark a slot used or free, keeping numProfilesFull in step
+static void slot_set_used(int slot, bool used) {
+    uint32_t mask = 1u << (slot & 31);
+    if (((slot_used[slot >> 5] & mask) != 0) == used) {
+        return;
+    }
+    if (used) {
+        slot_used[slot >> 5] |= mask;
+        numProfilesFull++;
+    } else {
+        slot_used[slot >> 5] &= ~mask;
+        numProfilesFull--;
+    }
+}
+
+// Fill a slot (replacing any profile in it) and index its PIN. Privilege is
+// kept in 2 bits; larger values saturate to 3 so they remain privileged
+static void profile_set(int slot, const uint8_t *PIN, uint8_t privilege) {
+    if (profile_isUsed(slot)) {
+        pin_index_remove(slot);
+    }
+    int key = pin_pack(PIN);
+    profile_pin[slot] = (key < 0) ? PIN_INVALID : key;
+
+    privilege = (privilege > 3) ? 3 : privilege;
+    int shift = (slot & 3) * 2;
+    profile_priv[slot >> 2] = (profile_priv[slot >> 2] & ~(3 << shift)) | (privilege << shift);
+
+    slot_set_used(slot, true);
+    pin_index_add(slot);
+}
+
+// Free a slot and drop its PIN from the index
+static void profile_clear(int slot) {
+    pin_index_remove(slot);
+    slot_set_used(slot, false);
+}
+
+// Word w of the bitmap as seen by a search for used (or free) slots below limit
+static uint32_t slot_word(int w, bool used, int limit) {
+    uint32_t word = used ? slot_used[w] : ~slot_used[w];
+    int bits = limit - w * 32;
+    if (bits < 32) {
+        word &= (1u << bits) - 1;
+    }
+    return word;
+}
+
+// First used (or free) slot in [from, limit), -1 if none
+static int slot_find_next(int from, bool used, int limit) {
+    for (int w = from >> 5; w < (limit + 31) >> 5; w++) {
+        uint32_t word = slot_word(w, used, limit);
+        if (w == (from >> 5)) {
+            word &= ~0u << (from & 31);
+        }
+        if (word) {
+            return w * 32 + __builtin_ctz(word);
+        }
+    }
+    return -1;
+}
+
+// Last used (or free) slot in [0, from], -1 if none
+static int slot_find_prev(int from, bool used, int limit) {
+    from = (from >= limit) ? limit - 1 : from;
+    for (int w = from >> 5; w >= 0; w--) {
+        uint32_t word = slot_word(w, used, limit);
+        if (w == (from >> 5) && (from & 31) != 31) {
+            word &= (1u << ((from & 31) + 1)) - 1;
+        }
+        if (word) {
+            return w * 32 + 31 - __builtin_clz(word);
+        }
+    }
+    return -1;
+}
+
+// Next used (or free) slot after from, wrapping around. May return from itself
+static int slot_seek(int from, bool used, bool direction, int limit) {
+    int slot = -1;
+    if (direction) {
+        if (from + 1 < limit) {
+            slot = slot_find_next(from + 1, used, limit);
+        }
+        if (slot < 0) {
+            slot = slot_find_next(0, used, limit);
+        }
+    } else {
+        if (from > 0) {
+            slot = slot_find_prev(from - 1, used, limit);
+        }
+        if (slot < 0) {
+            slot = slot_find_prev(limit - 1, used, limit);
+        }
+    }
+    return slot;
+}
+
 static void print_buffer() {
     // a) PIN
 #if TEST_SHOW_BUFFER >= 1
@@ -113,167 +314,411 @@ static void print_buffer() {
 }
 
 // private functions
-static esp_err_t genImg_Img2Tz(uint8_t buffer_id) {
-
-    // 1: Wait for fingerprint. When received, wait for 500ms.
-    vTaskDelay(20 / portTICK_PERIOD_MS);
-                    
-    // 2: Action. GenImg(). Abort if fail
-    R502_gen_image(&R502, &conf_code);
-    ESP_LOGI("genImg_Img2Tz", "genImg res: %d", (int)conf_code);
-    if (conf_code != R502_ok) {
+
+// Capture into buffer_id. No display or log calls, the caller reports *res
+static esp_err_t genImg_Img2Tz(uint8_t buffer_id, R502_conf_code_t *res) {
+
+    // 1: Fingerprint detected. Capture at once; a finger still landing
+    //    reads as no finger, so GenImg again instead of sleeping first
+    LT_mark(LT_scan_start);
+    for (int i = 0; i <= GENIMG_RETRIES; i++) {
+        // 2: Action. GenImg(). Abort if fail
+        R502_gen_image(&R502, res);
+        if (*res != R502_err_no_finger) {
+            break;
+        }
+    }
+    LT_mark(LT_gen_img);
+    if (*res != R502_ok) {
         return ESP_FAIL;
     } 
 
     // 3: Action: Img2Tz(). Abort if fail
-    R502_img_2_tz(&R502, buffer_id, &conf_code);
-    ESP_LOGI("genImg_Img2Tz", "Img2Tz res: %d", (int)conf_code);
+    R502_img_2_tz(&R502, buffer_id, res);
+    LT_mark(LT_img_2_tz);
+    if (*res != R502_ok) {
+        return ESP_FAIL;
+    }
+
+    return ESP_OK;
+}
+
+// Reader task: read every used slot from the SD card into the import ring
+static void import_reader_task(void *arg) {
+    import_slot_t *slot;
+
+    for (int i = 0; (i < MAX_PROFILES) && !import_abort; i++) {
+        // Skip empty slots without waiting on a buffer
+        if (!SD_isProfileUsed(i)) {
+            continue;
+        }
+
+        int64_t t0 = esp_timer_get_time();
+        xQueueReceive(import_free_queue, &slot, portMAX_DELAY);
+        int64_t t1 = esp_timer_get_time();
+
+        slot->profile_id = i;
+        slot->err = SD_readProfile(i, slot->PIN, 4, &slot->privilege, 1,
+            slot->fingerprint, R502_TEMPLATE_SIZE);
+        int64_t t2 = esp_timer_get_time();
+
+        import_stats.read_wait_us += t1 - t0;
+        import_stats.read_us += t2 - t1;
+        import_stats.read_count++;
+
+        xQueueSend(import_full_queue, &slot, portMAX_DELAY);
+    }
+
+    // Hand over the end marker
+    xQueueReceive(import_free_queue, &slot, portMAX_DELAY);
+    slot->profile_id = -1;
+    xQueueSend(import_full_queue, &slot, portMAX_DELAY);
+
+    vTaskDelete(NULL);
+}
+
+// Spot-check the sync manifest on the first slot it would skip: read the R503
+// template back and compare it with the SD record. On a mismatch no slot is
+// skipped, so the whole library is downloaded again
+static bool sync_verify(import_slot_t *slot) {
+    int received_len = 0;
+
+    if (sync_checked) {
+        return sync_trusted;
+    }
+    sync_checked = true;
+
+    esp_err_t err = R502_load_char(&R502, 1, (uint16_t)slot->profile_id, &conf_code);
+    if ((err == ESP_OK) && (conf_code == R502_ok)) {
+        err = R502_up_char_into(&R502, 1, fingerprintBuffer, sizeof(fingerprintBuffer),
+            &received_len, &conf_code);
+    }
+    sync_trusted = (err == ESP_OK) && (conf_code == R502_ok) &&
+        (received_len == R502_TEMPLATE_SIZE) &&
+        (memcmp(fingerprintBuffer, slot->fingerprint, R502_TEMPLATE_SIZE) == 0);
+    if (!sync_trusted) {
+        ESP_LOGW("profileRecog_init", "R503 template %d differs from the SD card, "
+            "sensor changed: downloading all profiles", slot->profile_id);
+    }
+    return sync_trusted;
+}
+
+// Loader: store one imported record to the ESP32 (PIN, priv) and R503 (fingerprint)
+static esp_err_t import_load_slot(import_slot_t *slot) {
+    int i = slot->profile_id;
+
+    if (slot->err == ESP_ERR_NOT_FOUND) {
+        return ESP_OK;
+    } else if (slot->err == ESP_ERR_INVALID_CRC) {
+        // Torn or corrupted record: leave the slot free rather than failing boot
+        ESP_LOGE("profileRecog_init", "Profile %d is corrupt, skipping", i);
+        return ESP_OK;
+    } else if (slot->err != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    // Load from buffers (ESP32: PIN, priv; R503: fingerprint)
+    profile_set(i, slot->PIN, slot->privilege); // slot 0 replaces the default admin profile
+
+    // Skip the R503 transfer if it already holds this exact record
+    uint32_t crc = SD_getProfileCrc(i);
+    if (BIT_TEST(sensor_library, i) && (SD_getSyncCrc(i) == crc) && sync_verify(slot)) {
+        BIT_SET(import_loaded, i);
+        import_stats.skip_count++;
+        return ESP_OK;
+    }
+    ESP_LOGI("profileRecog_init", "Load profile %d", i);
+
+    // Action: downChar(). Will download template to R503 char buffer
+    int64_t t0 = esp_timer_get_time();
+    R502_down_char(&R502, 1, slot->fingerprint, &conf_code);
+    int64_t t1 = esp_timer_get_time();
+    import_stats.down_us += t1 - t0;
     if (conf_code != R502_ok) {
+        ESP_LOGE("profileRecog_init", "Failed to download template, res: %d", (int)conf_code);
         return ESP_FAIL;
     }
 
+    R502_store(&R502, 1, (uint16_t)i, &conf_code);
+    import_stats.store_us += esp_timer_get_time() - t1;
+    if (conf_code != R502_ok) {
+        ESP_LOGE("profleRecog_init", "Failed to store, res: %d", (int)conf_code);
+        return ESP_FAIL;
+    }
+
+    SD_setSyncCrc(i, crc);
+    BIT_SET(import_loaded, i);
+    import_stats.load_count++;
     return ESP_OK;
 }
 
-void up_char_callback(uint8_t data[R502_max_data_len], 
-    int data_len)
-{
-    // this is where you would store or otherwise do something with the image
-    uint8_t *buffer_ptr = &fingerprintBuffer[up_char_size];
-    int total = 0;
-    while (total < data_len) {
-        buffer_ptr[total] = data[total];
-        total++;
+// Read which slots the R503 library holds into sensor_library
+static esp_err_t sensor_read_library() {
+    uint16_t template_num = 0;
+    uint8_t table[R502_INDEX_TABLE_LEN];
+
+    memset(sensor_library, 0, sizeof(sensor_library));
+
+    R502_template_num(&R502, &conf_code, &template_num);
+    if (conf_code != R502_ok) {
+        ESP_LOGE("profileRecog_init", "TemplateNum res: %d", (int)conf_code);
+        return ESP_FAIL;
+    }
+    ESP_LOGI("profileRecog_init", "R503 holds %d templates", template_num);
+    if (template_num == 0) {
+        return ESP_OK;
     }
 
-    up_char_size += data_len;
+    // One index page covers 256 slots
+    for (int page = 0; page * R502_INDEX_TABLE_LEN < sizeof(sensor_library); page++) {
+        R502_read_index_table(&R502, page, &conf_code, table);
+        if (conf_code != R502_ok) {
+            ESP_LOGE("profileRecog_init", "ReadIndexTable res: %d", (int)conf_code);
+            return ESP_FAIL;
+        }
+        int offset = page * R502_INDEX_TABLE_LEN;
+        int n = sizeof(sensor_library) - offset;
+        n = (n > R502_INDEX_TABLE_LEN) ? R502_INDEX_TABLE_LEN : n;
+        memcpy(&sensor_library[offset], table, n);
+    }
+    return ESP_OK;
+}
+
+// Delete R503 templates that no imported profile accounts for (deleted or
+// corrupt on the SD card), batching consecutive slots into one DeletChar
+static esp_err_t sensor_delete_orphans() {
+    int i = 0;
+    while (i < MAX_PROFILES) {
+        if (!BIT_TEST(sensor_library, i) || BIT_TEST(import_loaded, i)) {
+            i++;
+            continue;
+        }
+        int start = i;
+        while ((i < MAX_PROFILES) && BIT_TEST(sensor_library, i) && !BIT_TEST(import_loaded, i)) {
+            SD_setSyncCrc(i, 0);
+            i++;
+        }
+
+        R502_delet_char(&R502, start, i - start, &conf_code);
+        if (conf_code != R502_ok) {
+            ESP_LOGE("profileRecog_init", "Failed to delete orphan templates %d-%d, res: %d",
+                start, i - 1, (int)conf_code);
+            return ESP_FAIL;
+        }
+        import_stats.delete_count += i - start;
+    }
+    return ESP_OK;
+}
+
+// Per-stage throughput of the boot import
+static void import_print_report(int64_t total_us) {
+    const import_stats_t *st = &import_stats;
+    int64_t busy_us = st->read_us + st->down_us + st->store_us;
+
+    ESP_LOGI("profileRecog_init", "Import: %d read, %d loaded, %d in sync, %d deleted in %lld ms",
+        st->read_count, st->load_count, st->skip_count, st->delete_count, total_us / 1000);
+    ESP_LOGI("profileRecog_init", "  SD read  : %6lld ms, %4lld us/profile, stalled %lld ms",
+        st->read_us / 1000, st->read_count ? st->read_us / st->read_count : 0,
+        st->read_wait_us / 1000);
+    ESP_LOGI("profileRecog_init", "  downChar : %6lld ms, %4lld us/profile",
+        st->down_us / 1000, st->load_count ? st->down_us / st->load_count : 0);
+    ESP_LOGI("profileRecog_init", "  store    : %6lld ms, %4lld us/profile",
+        st->store_us / 1000, st->load_count ? st->store_us / st->load_count : 0);
+    ESP_LOGI("profileRecog_init", "  R503 load stalled %lld ms waiting on SD", st->load_wait_us / 1000);
+    if (total_us > 0) {
+        ESP_LOGI("profileRecog_init", "  overlap  : %lld%% (stage time / wall time)",
+            busy_us * 100 / total_us);
+    }
 }
 
 // public functions
 esp_err_t profileRecog_init() {
+    // 0: Index the default admin profile; imported profiles are indexed as they load
+    memset(pin_index, 0, sizeof(pin_index));
+    pin_index_add(0);
+
     // 1: Initiate R503 module and code
     ESP_LOGI("profileRecog_init", "Initializing R503...");
     R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
 
     R502_read_sys_para(&R502, &conf_code, &sys_para);
-    starting_data_len = sys_para.data_package_length;
 
-    R502_set_up_char_cb(&R502, up_char_callback);
-    up_char_size = 0;
-    ESP_LOGI("profileRecog_init", "starting_data_len: %d", starting_data_len);
+    // New profiles can only go in slots the sensor library has
+    slot_capacity = MAX_PROFILES;
+    if ((conf_code == R502_ok) && (sys_para.finger_library_size < MAX_PROFILES)) {
+        ESP_LOGW("profileRecog_init", "R503 library holds %d templates, capping profiles at %d",
+            sys_para.finger_library_size, sys_para.finger_library_size);
+        slot_capacity = sys_para.finger_library_size;
+    }
+
+    ESP_LOGI("profileRecog_init", "data package length: %d", R502.cur_data_pkg_len);
 
     if (SD_init() != ESP_OK) {
         return ESP_FAIL;
     }
 
+#if PROFILE_FAST_BOOT
+    // Find out what the R503 already holds; only differing slots are re-synced
+    if (sensor_read_library() != ESP_OK) {
+        return ESP_FAIL;
+    }
+#else
     // Clear R503 module (empty)
     R502_empty(&R502, &conf_code);
     ESP_LOGI("profileRecog_init", "Empty res: %d", (int)conf_code);
     if (conf_code != R502_ok) {
         return ESP_FAIL;
     }
+    memset(sensor_library, 0, sizeof(sensor_library));
+#endif
+    memset(import_loaded, 0, sizeof(import_loaded));
+    sync_checked = false;
+    sync_trusted = false;
 
     // 2: Initiate SD card and code
     ESP_LOGI("profileRecog_init", "Initializing profiles from SD card...");
 
-    // Import each file from SD "/sdcard/profiles/profile%d.bin"
-    // Update the profile slot that is open...
-    const int count = 200;
-    for (int i = 0; i < count; i++) {
-        // Populate idx
-        profiles[i].idx = i;
-        // Read profile from SD card to buffers
-        esp_err_t err = SD_readProfile(i, pinBuffer, 4, &privBuffer, 1, fingerprintBuffer, R502_TEMPLATE_SIZE);
-        if (err == ESP_ERR_NOT_FOUND) {
-            continue;
-        } else if (err != ESP_OK) {
-            return ESP_FAIL;
-        }
+    // Import each record from the SD profile database (SD_DB_PATH).
+    // The reader task streams records into import_ring while this task loads
+    // them into the R503, so SPI (SD) and UART (R503) transfers overlap.
+    int64_t import_start = esp_timer_get_time();
+    esp_err_t import_err = ESP_OK;
 
-        // Print buffers
-        print_buffer();
+    import_free_queue = xQueueCreate(IMPORT_RING_SIZE, sizeof(import_slot_t *));
+    import_full_queue = xQueueCreate(IMPORT_RING_SIZE, sizeof(import_slot_t *));
+    if ((import_free_queue == NULL) || (import_full_queue == NULL)) {
+        ESP_LOGE("profileRecog_init", "Failed to create import queues");
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < IMPORT_RING_SIZE; i++) {
+        import_slot_t *slot = &import_ring[i];
+        xQueueSend(import_free_queue, &slot, 0);
+    }
+    memset(&import_stats, 0, sizeof(import_stats));
+    import_abort = false;
 
-        // Load from buffers (ESP32: PIN, priv; R503: fingerprint)
-        ESP_LOGI("profileRecog_init", "Load PIN, privilege to ESP32");
-        profiles[i].isUsed = 1;
-        profiles[i].privilege = privBuffer;
-        for (int j = 0; j < 4; j++) {
-            profiles[i].PIN[j] = pinBuffer[j];
-        }
+    if (xTaskCreate(import_reader_task, "import_reader", 4096, NULL,
+        uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+        ESP_LOGE("profileRecog_init", "Failed to create import reader");
+        return ESP_FAIL;
+    }
 
-        // Action: downChar(). Will upload template to ESP32 char buffer
-        ESP_LOGI("profileRecog_init", "Load fingerprint file to R503");
+    for (;;) {
+        import_slot_t *slot;
+        int64_t t0 = esp_timer_get_time();
+        xQueueReceive(import_full_queue, &slot, portMAX_DELAY);
+        int64_t t1 = esp_timer_get_time();
+        import_stats.load_wait_us += t1 - t0;
 
-        R502_down_char(&R502, starting_data_len, 1, fingerprintBuffer, &conf_code);
-        ESP_LOGI("profileRecog_init", "downChar res: %d", (int)conf_code);
-        if (conf_code != R502_ok) {
-            ESP_LOGE("profileRecog_init", "Failed to download template");
-            return ESP_FAIL;
+        // Reader is finished once it hands over the end marker
+        if (slot->profile_id < 0) {
+            break;
         }
 
-        R502_store(&R502, 1, (uint16_t)i, &conf_code);
-        ESP_LOGI("profileRecog_init", "store res: %d", (int)conf_code);
-        if (conf_code != R502_ok) {
-            ESP_LOGE("profleRecog_init", "Failed to store");
-            return ESP_FAIL;
+        // Drain without loading after a failure, so the reader can exit cleanly
+        if (import_err == ESP_OK) {
+            import_err = import_load_slot(slot);
+            if (import_err != ESP_OK) {
+                import_abort = true;
+            }
         }
+        xQueueSend(import_free_queue, &slot, portMAX_DELAY);
+    }
 
-        ESP_LOGI("profileRecog_init", "Successful import");
-        numProfilesFull++;
+    vQueueDelete(import_free_queue);
+    vQueueDelete(import_full_queue);
+    import_free_queue = NULL;
+    import_full_queue = NULL;
+
+    // Remove R503 templates of profiles that are gone from the SD card, then
+    // record what the R503 now holds
+    if (import_err == ESP_OK) {
+        import_err = sensor_delete_orphans();
+    }
+    if (SD_commitSyncManifest() != ESP_OK) {
+        ESP_LOGW("profileRecog_init", "Sync manifest not saved, next boot will re-sync");
+    }
+
+    import_print_report(esp_timer_get_time() - import_start);
+    if (import_err != ESP_OK) {
+        return ESP_FAIL;
     }
     ESP_LOGI("profileRecog_init", "Number of profiles registered: %d", numProfilesFull);
 
     return ESP_OK;
 }
 
+esp_err_t verifyUser_fingerprint_match(fp_match_t *match, uint8_t *privilege,
+    R502_conf_code_t *res) {
+    uint16_t found_page = 0;
+    uint16_t score = 0;
+
+    // 1: capture into char buffer 1
+    *match = FP_MATCH_bad_entry;
+    if (genImg_Img2Tz(1, res) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    // 2: search up char file against library
+    R502_search(&R502, 1, 0, 0xffff, res, &found_page, &score);
+    LT_mark(LT_search);
+    if (*res != R502_ok) {
+        *match = FP_MATCH_not_found;
+        return ESP_FAIL;
+    }
+
+    // 3: found: privilege of the matching profile
+    *match = FP_MATCH_found;
+    *privilege = profile_getPrivilege(found_page);
+    return ESP_OK;
+}
+
+void verifyUser_fingerprint_scanning() {
+    // Print 0: Scanning... (duration of genImg_Img2Tz)
+    // Print 1:
+    WS2_msg_print(&CFAL1602, scanning, 0, false);
+    WS2_msg_clear(&CFAL1602, 1);
+    printf("Scanning fingerprint...\n");
+}
+
+void verifyUser_fingerprint_result(fp_match_t match, R502_conf_code_t res) {
+    ESP_LOGI("verifyUser_fingerprint", "match %d, res: %d", (int)match, (int)res);
+    if (match == FP_MATCH_bad_entry) {
+        // case 1: bad fingerprint entry
+        // Print 0,1: Bad fingerprint entry (1 second)
+        WS2_msg_screen(&CFAL1602, bad_fingerprint_entry_0, bad_fingerprint_entry_1, WS2_prio_error, 1000);
+        printf("Bad fingerprint entry\n");
+    }
+    else if (match == FP_MATCH_not_found) {
+        // case 2: access denied
+        // Print 0: Access denied (1 second)
+        WS2_msg_screen(&CFAL1602, access_denied, NULL, WS2_prio_outcome, 1000);
+        printf("Access denied\n");
+    }
+    // case 3: access granted, shown by verifyUser_outcome_handler
+}
+
 esp_err_t verifyUser_fingerprint(uint8_t *flags, uint8_t *ret_code, uint8_t *privilege) {
     *ret_code = 1;
     if (*flags & FL_FP_0) {
+        fp_match_t match;
 
-        // Print 0: Scanning... (duration of genImg_Img2Tz)
-        // Print 1:
-        WS2_msg_print(&CFAL1602, scanning, 0, false);
-        WS2_msg_clear(&CFAL1602, 1);
-        printf("Scanning fingerprint...\n");
-
-        // Perform task
-        if (genImg_Img2Tz(1) != ESP_OK) {
-            // case 1: bad fingerprint entry
-            // Print 0,1: Bad fingerprint entry (1 second)
-            WS2_msg_print(&CFAL1602, bad_fingerprint_entry_0, 0, false);
-            WS2_msg_print(&CFAL1602, bad_fingerprint_entry_1, 1, false);
-            printf("Bad fingerprint entry\n");
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-
+        verifyUser_fingerprint_scanning();
+        verifyUser_fingerprint_match(&match, privilege, &conf_code);
+        verifyUser_fingerprint_result(match, conf_code);
+        if (match != FP_MATCH_found) {
             return ESP_FAIL;
         }
 
-        // 4: search up char file against library and return resuit
-        R502_search(&R502, 1, 0, 0xffff, &conf_code, &page_id, &match_score);
-        ESP_LOGI("verifyUser_fingerprint", "Search res: %d", (int)conf_code);
-        if (conf_code != R502_ok) {
-            // case 2: access denied
-            // Print 0: Access denied (1 second)
-            WS2_msg_print(&CFAL1602, access_denied, 0, false);
-            printf("Access denied\n");
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-
-            //WS2_msg_clear(&CFAL1602, 0);
-            //flags |= FL_INPUT_READY;
-            return ESP_FAIL;
-        }
         // case 3: access granted
         *flags &= ~(FL_PIN | FL_FP_0); // clear PIN and FP flags
         *ret_code = 0; // 0 = SUCCESS
-        *privilege = profiles[page_id].privilege; // get privilege
     }
 
     return ESP_OK;
 }
 
 esp_err_t verifyUser_PIN(uint8_t *flags, uint8_t *pin_input, uint8_t *ret_code, uint8_t *privilege) {
-    bool isMatch = false;
-
     *ret_code = 1;
     if (*flags & FL_PIN) {
         // Print 0: 
@@ -282,42 +727,20 @@ esp_err_t verifyUser_PIN(uint8_t *flags, uint8_t *pin_input, uint8_t *ret_code,
         WS2_msg_clear(&CFAL1602, 1);
         printf("Checking PIN\n");
 
-        vTaskDelay(20 / portTICK_PERIOD_MS);
-                        
-
-        // Check profile PINs
-        for (int i = 0; i < MAX_PROFILES; i++) {
-            // Skip unused slots
-            if (profiles[i].isUsed == 0) {
-                continue;
-            }
-
-            //ESP_LOGI("verifyUser_PIN", "comparing profile: %d", i);
-            isMatch = true;
-
-            // Retrieve a PIN from a profile. If mismatch found, end comparison and move on to next one
-            for (int j = 0; j < 4; j++) {
-                if (pin_input[j] != profiles[i].PIN[j]) {
-                    //ESP_LOGI("verifyUser_PIN", "mismatch %d and %d\n", pin_input[j], profiles[i].PIN[j]);
-                    isMatch = false;
-                    break;
-                }
-            }
-
-            if (isMatch) {
-                // case 1: access granted
-                //ESP_LOGI("verifyUser_PIN", "Privilege level: %d\n", profiles[i].privilege);
-                *flags &= ~(FL_PIN | FL_FP_0); // clear PIN and FP flags
-                *ret_code = 0; // 0 = SUCCESS
-                *privilege = profiles[i].privilege; // get privilege
-                return ESP_OK;
-            }
+        // Look up the profile owning this PIN
+        int i = pin_index_find(pin_input);
+        if (i >= 0) {
+            // case 1: access granted
+            //ESP_LOGI("verifyUser_PIN", "Privilege level: %d\n", profile_getPrivilege(i));
+            *flags &= ~(FL_PIN | FL_FP_0); // clear PIN and FP flags
+            *ret_code = 0; // 0 = SUCCESS
+            *privilege = profile_getPrivilege(i); // get privilege
+            return ESP_OK;
         }
         // case 2: access denied
         // Print 0: Access denied (1 second)
-        WS2_msg_print(&CFAL1602, access_denied, 0, false);
+        WS2_msg_screen(&CFAL1602, access_denied, NULL, WS2_prio_outcome, 1000);
         printf("Access denied\n");
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
 
         // return
         *ret_code = 1; // 1 = FAIL
@@ -338,13 +761,13 @@ esp_err_t addProfile_fingerprint(uint8_t *flags, uint8_t *ret_code) {
         WS2_msg_clear(&CFAL1602, 1);
         printf("Scanning fingerprint 1...\n");
         
-        if (genImg_Img2Tz(1) != ESP_OK) {
+        esp_err_t err = genImg_Img2Tz(1, &conf_code);
+        ESP_LOGI("addProfile_fingerprint", "genImg/Img2Tz res: %d", (int)conf_code);
+        if (err != ESP_OK) {
             // Print 0: Bad fingerprint (1 second)
             // Print 1: entry (1 second)
-            WS2_msg_print(&CFAL1602, bad_fingerprint_entry_0, 0, false);
-            WS2_msg_print(&CFAL1602, bad_fingerprint_entry_1, 1, false);
+            WS2_msg_screen(&CFAL1602, bad_fingerprint_entry_0, bad_fingerprint_entry_1, WS2_prio_error, 1000);
             printf("Bad fingerprint entry\n");
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
             return ESP_FAIL;
         }
         
@@ -359,13 +782,13 @@ esp_err_t addProfile_fingerprint(uint8_t *flags, uint8_t *ret_code) {
         WS2_msg_clear(&CFAL1602, 1);
         printf("Scanning fingerprint 2...\n");
 
-        if (genImg_Img2Tz(2) != ESP_OK) {
+        esp_err_t err = genImg_Img2Tz(2, &conf_code);
+        ESP_LOGI("addProfile_fingerprint", "genImg/Img2Tz res: %d", (int)conf_code);
+        if (err != ESP_OK) {
             // Print 0: Bad fingerprint (1 second)
             // Print 1: entry (1 second)
-            WS2_msg_print(&CFAL1602, bad_fingerprint_entry_0, 0, false);
-            WS2_msg_print(&CFAL1602, bad_fingerprint_entry_1, 1, false);
+            WS2_msg_screen(&CFAL1602, bad_fingerprint_entry_0, bad_fingerprint_entry_1, WS2_prio_error, 1000);
             printf("Bad fingerprint entry\n");
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
 
             *ret_code = 2;
             return ESP_FAIL;
@@ -377,16 +800,12 @@ esp_err_t addProfile_fingerprint(uint8_t *flags, uint8_t *ret_code) {
         if (conf_code != R502_ok) {
             // Print 0: Fingerprints (1 second)
             // Print 1: don't match (1 second)
-            WS2_msg_print(&CFAL1602, fps_dont_match_0, 0, false);
-            WS2_msg_print(&CFAL1602, fps_dont_match_1, 1, false);
+            WS2_msg_screen(&CFAL1602, fps_dont_match_0, fps_dont_match_1, WS2_prio_error, 1000);
             printf("Finger entries do not match. Reenter both\n");
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
 
             // Print 0: Reenter FPs (0.5 second)
             // Print 1:
-            WS2_msg_print(&CFAL1602, reenter_fps, 0, false);
-            WS2_msg_clear(&CFAL1602, 1);
-            vTaskDelay(500 / portTICK_PERIOD_MS);
+            WS2_msg_screen(&CFAL1602, reenter_fps, "", WS2_prio_status, 500);
 
             *flags |= FL_FP_01;
             return ESP_FAIL;
@@ -404,8 +823,6 @@ esp_err_t addProfile_fingerprint(uint8_t *flags, uint8_t *ret_code) {
 }
 
 esp_err_t addProfile_PIN(uint8_t *flags, uint8_t *pin_input, uint8_t *ret_code) {
-    static bool isMatch;
-
     *ret_code = 1;
 
     if (*flags & FL_PIN) {
@@ -414,39 +831,17 @@ esp_err_t addProfile_PIN(uint8_t *flags, uint8_t *pin_input, uint8_t *ret_code)
         WS2_msg_clear(&CFAL1602, 0);
         WS2_msg_clear(&CFAL1602, 1);
         printf("Verifying PIN uniqueness\n");
-        vTaskDelay(20 / portTICK_PERIOD_MS);
-
-        // 2: Import a PIN from a profile in database
-        // 3: Compare input PIN to that of the profile (check for uniqueness)
-        for (int i = 0; i < MAX_PROFILES; i++) {
-            // Skip unused slots
-            if (profiles[i].isUsed == 0) {
-                continue;
-            }
-
-            // Profile is there. Start comparing
-            //ESP_LOGI("addProfile_PIN", "comparing profile: %d", i);
-            isMatch = true;
-
-            // Retrieve a PIN from a profile. If mismatch found, end comparison and move on to next one
-            for (int j = 0; j < 4; j++) {
-                if (pin_input[j] != profiles[i].PIN[j]) {
-                    //ESP_LOGI("addProfile_PIN","mismatch %d and %d\n", pin_input[j], profiles[i].PIN[j]);
-                    isMatch = false;
-                    break;
-                }
-            }
 
-            if (isMatch) {
-                // Print 0: PIN already used
-                WS2_msg_print(&CFAL1602, pin_already_used, 0, false);
-                printf("PIN already being used by profile %d\n", i);
-                printf("Select different PIN\n");
-                vTaskDelay(1000 / portTICK_PERIOD_MS);
+        // 2: Look up the input PIN in the PIN index (check for uniqueness)
+        int i = pin_index_find(pin_input);
+        if (i >= 0) {
+            // Print 0: PIN already used
+            WS2_msg_screen(&CFAL1602, pin_already_used, NULL, WS2_prio_error, 1000);
+            printf("PIN already being used by profile %d\n", i);
+            printf("Select different PIN\n");
 
-                // return
-                return ESP_FAIL;
-            }
+            // return
+            return ESP_FAIL;
         }
         // case 2: PIN is good for use
         printf("Accepted PIN ");
@@ -474,7 +869,6 @@ esp_err_t addProfile_privilege(uint8_t *flags, uint8_t privilege, uint8_t *ret_c
         WS2_msg_clear(&CFAL1602, 0);
         WS2_msg_clear(&CFAL1602, 1);
         printf("Updating privilege to %d\n", (int)privilege);
-        vTaskDelay(20 / portTICK_PERIOD_MS);
 
         privBuffer = privilege; // Update privilege entry
         *flags &= ~FL_PRIVILEGE; // clear PRIV flag
@@ -496,19 +890,16 @@ esp_err_t addProfile_compile(uint8_t *flags, uint8_t *ret_code) {
 
     // Store fingerprint template to R503 flash memory banks
     // A: Store to next available slot (on buffer)
-    int page_id = 0;
-    while (profiles[page_id].isUsed) {
-        page_id++;
-        if (page_id >= MAX_PROFILES) {
-            // Print 0: Error: ; Delete a profile (2 seconds, block scroll)
-            // Print 1: Slots full ; to free slot
-            WS2_msg_print(&CFAL1602, slots_full_0, 0, false);
-            WS2_msg_print(&CFAL1602, slots_full_1, 0, false);
-            printf("Slots full. Delete profile to add space\n");
+    int page_id = slot_find_next(0, false, slot_capacity);
+    if (page_id < 0) {
+        // Print 0: Error: ; Delete a profile (2 seconds, block scroll)
+        // Print 1: Slots full ; to free slot
+        WS2_msg_print(&CFAL1602, slots_full_0, 0, false);
+        WS2_msg_print(&CFAL1602, slots_full_1, 0, false);
+        printf("Slots full. Delete profile to add space\n");
 
-            // return
-            return ESP_FAIL;
-        }
+        // return
+        return ESP_FAIL;
     }
     ESP_LOGI("addProfile_compile", "Profile slot to fill: %d", page_id);
 
@@ -522,10 +913,12 @@ esp_err_t addProfile_compile(uint8_t *flags, uint8_t *ret_code) {
 
     printf("Uploading char file to ESP32\n");
 
-    // 5: Action: UpChar(). Will upload template to ESP32 char buffer
-    R502_up_char(&R502, starting_data_len, 1, &conf_code);
-    ESP_LOGI("addProfile_compile", "upChar res: %d", (int)conf_code);
-    if (conf_code != R502_ok) {
+    // 5: Action: UpChar(). Will upload template straight into fingerprintBuffer
+    int up_char_size = 0;
+    esp_err_t err = R502_up_char_into(&R502, 1, fingerprintBuffer, sizeof(fingerprintBuffer),
+        &up_char_size, &conf_code);
+    ESP_LOGI("addProfile_compile", "upChar res: %d, %d bytes", (int)conf_code, up_char_size);
+    if ((err != ESP_OK) || (conf_code != R502_ok) || (up_char_size != R502_TEMPLATE_SIZE)) {
         printf("Failed to upload template\n");
         return ESP_FAIL;
     }
@@ -537,35 +930,30 @@ esp_err_t addProfile_compile(uint8_t *flags, uint8_t *ret_code) {
     printf("-----------------------------------------------\n");
     printf("Profile to be sent to SD card: %d\n", page_id);
     print_buffer();
-    up_char_size = 0;
 
     // Update the profile slot that is open...
     printf("SD card needed to progress forward\n");
 
-    esp_err_t err = SD_writeProfile(page_id, pinBuffer, 4, &privBuffer, 1, fingerprintBuffer, R502_TEMPLATE_SIZE);
+    err = SD_writeProfile(page_id, pinBuffer, 4, &privBuffer, 1, fingerprintBuffer, R502_TEMPLATE_SIZE);
     if (err != ESP_OK) {
         ESP_LOGE("addProfile_compile", "Failed to write to SD card");
         return ESP_FAIL;
     }
 
+    // R503 already holds this template; no need to re-sync it next boot
+    SD_setSyncCrc(page_id, SD_getProfileCrc(page_id));
+    SD_commitSyncManifest();
+
     // Update ESP32 profile slot
-    profiles[page_id].isUsed = 1;
-    profiles[page_id].privilege = privBuffer;
-    for (int j = 0; j < 4; j++) {
-        profiles[page_id].PIN[j] = pinBuffer[j];
-    }
+    profile_set(page_id, pinBuffer, privBuffer);
 
     // Print 0: Profile created: (3 seconds)
     // Print 1: Profile ID: %d (variable) (3 seconds)
-    WS2_msg_print(&CFAL1602, profile_created, 0, false);
-
     // Print 1: Privilege: (edit pinChar, set pinEnter to +11)
     sprintf(pinChar, "%s%d", "ID: ", (int)page_id);
-    WS2_msg_print(&CFAL1602, pinChar, 1, false);
-    vTaskDelay(3000 / portTICK_PERIOD_MS);
+    WS2_msg_screen(&CFAL1602, profile_created, pinChar, WS2_prio_outcome, 3000);
 
     // Successful
-    numProfilesFull++;
     ESP_LOGI("profileRecog_init", "Number of profiles registered: %d", numProfilesFull);
     return ESP_OK;
 }
@@ -583,18 +971,17 @@ esp_err_t deleteProfile_remove(uint8_t *flags, int prof_id, uint8_t *ret_code) {
         }
         // 2: delete profile entry in SD card
         SD_deleteProfile(prof_id);
+        SD_setSyncCrc(prof_id, 0);
+        SD_commitSyncManifest();
 
         // 3: clear entry on buffers
-        profiles[prof_id].isUsed = 0;
-        numProfilesFull--;
+        profile_clear(prof_id);
         ESP_LOGI("profileRecog_init", "Number of profiles registered: %d", numProfilesFull);
 
         // Print 0: Profile deleted (2 seconds)
         // Print 1: 
-        WS2_msg_print(&CFAL1602, profile_deleted, 0, false);
-        WS2_msg_clear(&CFAL1602, 1);
+        WS2_msg_screen(&CFAL1602, profile_deleted, "", WS2_prio_outcome, 2000);
         printf("Profile deleted\n");
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
 
         // 4: reset 
         *ret_code = 0;
@@ -617,39 +1004,50 @@ void profile_idx_reset() {
     profile_idx = 0;
 }
 
-// get current profile
+// get current profile (snapshot, refreshed on every call)
 profile_t * profile_idx_getCurrProfile() {
-    return &profiles[profile_idx];
+    curr_profile.isUsed = profile_isUsed(profile_idx);
+    profile_getPIN(profile_idx, curr_profile.PIN);
+    curr_profile.privilege = profile_getPrivilege(profile_idx);
+    curr_profile.idx = profile_idx;
+    return &curr_profile;
+}
+
+bool profile_isUsed(int profile_id) {
+    if ((profile_id < 0) || (profile_id >= MAX_PROFILES)) {
+        return false;
+    }
+    return (slot_used[profile_id >> 5] >> (profile_id & 31)) & 1;
+}
+
+void profile_getPIN(int profile_id, uint8_t *PIN) {
+    int key = profile_pin[profile_id];
+    for (int j = 3; j >= 0; j--) {
+        PIN[j] = (key == PIN_INVALID) ? 0xFF : key % 10;
+        key /= 10;
+    }
+}
+
+uint8_t profile_getPrivilege(int profile_id) {
+    return (profile_priv[profile_id >> 2] >> ((profile_id & 3) * 2)) & 3;
 }
 
 // from current idx position, find next empty slot
 int profile_idx_seekEmptySlot(bool direction) {
-    if (numProfilesFull == MAX_PROFILES) {
+    int slot = slot_seek(profile_idx, false, direction, slot_capacity);
+    if (slot < 0) {
         return -1;
     }
-    do {
-        // increment to next position (circular ++ or --)
-        if (direction) {
-            profile_idx = (profile_idx == MAX_PROFILES-1) ? 0 : profile_idx+1;
-        } else {
-            profile_idx = (profile_idx == 0) ? MAX_PROFILES-1 : profile_idx-1;
-        }
-    } while (profiles[profile_idx].isUsed);
+    profile_idx = slot;
     return profile_idx;
 }
 
-// from current idx position, find next empty slot
+// from current idx position, find next full slot
 int profile_idx_seekFullSlot(bool direction) {
-    if (numProfilesFull == 0) {
+    int slot = slot_seek(profile_idx, true, direction, MAX_PROFILES);
+    if (slot < 0) {
         return -1;
     }
-    do {
-        // increment to next position (circular ++ or --)
-        if (direction) {
-            profile_idx = (profile_idx == MAX_PROFILES-1) ? 0 : profile_idx+1;
-        } else {
-            profile_idx = (profile_idx == 0) ? MAX_PROFILES-1 : profile_idx-1;
-        }
-    } while (!profiles[profile_idx].isUsed);
+    profile_idx = slot;
     return profile_idx;
-}
\ No newline at end of file
+}
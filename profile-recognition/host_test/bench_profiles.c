@@ -0,0 +1,409 @@
+/**
+ * \brief Times profileRecog_init, verifyUser_PIN, addProfile_compile,
+ * deleteProfile_remove and a fingerprint from touch to relay with
+ * MAX_PROFILES slots, against the simulated R502 and a profile database in a
+ * directory on the host
+ *
+ *   bench_profiles_<MAX_PROFILES> [-i iterations] [-c] [-s]
+ *
+ * Every slot but the last holds a profile before boot. By default the R503
+ * library and the sync manifest already match the database (a warm boot);
+ * -c starts with an empty library and no manifest, so every template is
+ * downloaded (a cold boot, about 160 ms per profile on the wire). -s keeps the
+ * manifest but swaps the sensor for one holding other fingers, which the boot
+ * must notice and download every template again.
+ *
+ * The UART runs at its real rate against the fake, so R502 commands take
+ * bench time. The SD card is host files, far faster than SPI at 20 MHz, so
+ * database time is a lower bound. "Delay" is the part of each operation spent
+ * in vTaskDelay, "work" is the rest. The fingerprint runs go through the
+ * auth task from the touch interrupt, the latency trace table breaks them
+ * down by stage.
+ *
+ * Exits non-zero if an operation fails, so the smallest size also runs as a
+ * test
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ftw.h>
+#include <sched.h>
+#include "prof-recog.h"
+#include "integ-things.h"
+#include "auth.h"
+#include "input.h"
+#include "CFAL1602.h"
+#include "latency-trace.h"
+#include "fake_r502.h"
+#include "esp32/rom/crc.h"
+
+#define DEFAULT_ITERATIONS 3
+// Each verifyUser_PIN is short, time more of them
+#define VERIFY_ITERATIONS_PER 10
+// Outside 0000 to MAX_PROFILES-1, which the seeded profiles use
+#define NEW_PIN 9999
+#define NEW_FINGER_ID (MAX_PROFILES + 1)
+// Fingers of the swapped sensor, none of them in the database
+#define SWAPPED_FINGER_ID (MAX_PROFILES + 2)
+// Holds PIN 0000 like slot 0
+#define SHARED_PIN_SLOT (MAX_PROFILES - 2)
+// A touch that hasn't opened the door by now never will
+#define BENCH_TIMEOUT_US 5000000
+
+/**
+ * \brief Timings of one operation
+ */
+typedef struct {
+    const char *name;
+    int runs;
+    int64_t total_us;
+    int64_t min_us;
+    int64_t max_us;
+    int64_t delay_us; //!< in vTaskDelay, over all runs
+} bench_result_t;
+
+static const char *TAG = "bench";
+
+// Globals main.c defines for the components
+bool isHelp = false;
+int accessAdmin;
+uint8_t flags = 0;
+char *pinCharTemp = NULL;
+char pinChar[17] = {0};
+int pin_idx = 0;
+uint8_t privilege = 0;
+uint8_t ret_code = 0;
+
+CFAL1602Interface CFAL1602 = {
+    .TAG = "CFAL1602C-PB",
+    .initialized = false,
+    .line_len = 16,
+    .line_count = 2,
+    .timer_period = 250000
+};
+
+static uint8_t template[R502_TEMPLATE_SIZE];
+static uint8_t held[R502_TEMPLATE_SIZE];
+static int failures;
+
+void IRAM_ATTR gpio_isr_handler(void *arg)
+{
+    // The application's handler is in main.c, touches only go to the auth
+    // task here
+    if((uintptr_t)arg == PIN_IRQ){
+        LT_start_from_isr();
+        auth_touch_from_isr(PIN_IRQ);
+    }
+}
+
+// Private functions
+
+static void pin_of(int n, uint8_t PIN[4])
+{
+    for(int j = 3; j >= 0; j--){
+        PIN[j] = n % 10;
+        n /= 10;
+    }
+}
+
+static void check(bool ok, const char *what)
+{
+    if(!ok){
+        ESP_LOGE(TAG, "FAILED: %s", what);
+        failures++;
+    }
+}
+
+/**
+ * \brief Write the database SD_init finds at boot: slots 0 to
+ * MAX_PROFILES-2 used, slot i with PIN i and the template of finger i, except
+ * SHARED_PIN_SLOT which shares PIN 0 with slot 0, as an old database may.
+ * With warm, also a sync manifest saying the R503 holds all of them. With
+ * swapped, the R503 holds other fingers in those slots instead
+ */
+static void seed_database(bool warm, bool swapped)
+{
+    static SD_db_record_t record;
+    static uint8_t bitmap[SD_DB_BITMAP_SIZE];
+    static uint32_t crc[SD_DB_SLOTS];
+    static const uint8_t zero[SD_DB_SECTOR_SIZE];
+
+    ESP_ERROR_CHECK(mkdir(MOUNT_POINT, 0755) == 0 ? ESP_OK : ESP_FAIL);
+    FILE *db = fopen(SD_DB_PATH, "w");
+    ESP_ERROR_CHECK(db ? ESP_OK : ESP_FAIL);
+
+    // Records first, the directory holds their CRCs
+    ESP_ERROR_CHECK(fseek(db, SD_DB_HEADER_SIZE, SEEK_SET) == 0 ? ESP_OK : ESP_FAIL);
+    for(int i = 0; i < SD_DB_SLOTS; i++){
+        memset(&record, 0, sizeof(record));
+        if(i < SD_DB_SLOTS - 1){
+            pin_of((i == SHARED_PIN_SLOT) ? 0 : i, record.pin);
+            record.privilege[0] = i % 4;
+            fake_r502_finger_template(i, record.fingerprint);
+            bitmap[i >> 3] |= 1 << (i & 7);
+            crc[i] = crc32_le(0, (const uint8_t *)&record, sizeof(record));
+        }
+        fwrite(&record, 1, sizeof(record), db);
+    }
+
+    SD_db_header_t header = {
+        .magic = SD_DB_MAGIC,
+        .version = SD_DB_VERSION,
+        .slot_count = SD_DB_SLOTS,
+        .record_size = sizeof(SD_db_record_t),
+        .reserved = 0
+    };
+    fseek(db, 0, SEEK_SET);
+    fwrite(&header, 1, sizeof(header), db);
+    fwrite(bitmap, 1, sizeof(bitmap), db);
+    fwrite(crc, 1, sizeof(crc), db);
+    long pad = SD_DB_HEADER_SIZE - ftell(db);
+    while(pad > 0){
+        long n = pad > sizeof(zero) ? sizeof(zero) : pad;
+        fwrite(zero, 1, n, db);
+        pad -= n;
+    }
+    ESP_ERROR_CHECK(fclose(db) == 0 ? ESP_OK : ESP_FAIL);
+
+    if(!warm) return;
+    FILE *sync = fopen(SD_SYNC_PATH, "w");
+    ESP_ERROR_CHECK(sync ? ESP_OK : ESP_FAIL);
+    uint32_t sync_header[2] = {SD_SYNC_MAGIC, SD_DB_SLOTS};
+    fwrite(sync_header, 1, sizeof(sync_header), sync);
+    fwrite(crc, 1, sizeof(crc), sync);
+    ESP_ERROR_CHECK(fclose(sync) == 0 ? ESP_OK : ESP_FAIL);
+
+    for(int i = 0; i < SD_DB_SLOTS - 1; i++){
+        fake_r502_finger_template(swapped ? SWAPPED_FINGER_ID + i : i, template);
+        fake_r502_set_template(i, template);
+    }
+}
+
+static int64_t bench_start(int64_t *delay_start)
+{
+    *delay_start = host_task_get_delay_us();
+    return esp_timer_get_time();
+}
+
+static void bench_stop(bench_result_t *result, int64_t start_us, int64_t delay_start)
+{
+    int64_t us = esp_timer_get_time() - start_us;
+    if(result->runs == 0 || us < result->min_us) result->min_us = us;
+    if(result->runs == 0 || us > result->max_us) result->max_us = us;
+    result->runs++;
+    result->total_us += us;
+    result->delay_us += host_task_get_delay_us() - delay_start;
+}
+
+/**
+ * \brief Enter PIN, privilege and two captures of a new finger, ready for
+ * addProfile_compile
+ */
+static void enter_new_profile(uint8_t *fl)
+{
+    uint8_t PIN[4];
+    uint8_t code;
+    pin_of(NEW_PIN, PIN);
+
+    *fl = FL_PIN | FL_PRIVILEGE | FL_FP_01;
+    check(addProfile_PIN(fl, PIN, &code) == ESP_OK && code == 0, "addProfile_PIN");
+    check(addProfile_privilege(fl, 1, &code) == ESP_OK && code == 0, "addProfile_privilege");
+    for(int i = 0; i < 2; i++){
+        fake_r502_place_finger(NEW_FINGER_ID);
+        LT_mark(LT_task_wake);
+        check(addProfile_fingerprint(fl, &code) == ESP_OK && code == 0,
+            "addProfile_fingerprint");
+        LT_end();
+    }
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    return remove(path);
+}
+
+static void print_result(const bench_result_t *result)
+{
+    if(result->runs == 0) return;
+    int64_t mean_us = result->total_us / result->runs;
+    int64_t delay_us = result->delay_us / result->runs;
+    printf("%-22s %5d %5d %10.1f %10.1f %10.1f %10.1f %10.1f\n", result->name, MAX_PROFILES,
+        result->runs, mean_us / 1000.0, result->min_us / 1000.0, result->max_us / 1000.0,
+        delay_us / 1000.0, (mean_us - delay_us) / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = DEFAULT_ITERATIONS;
+    bool warm = true;
+    bool swapped = false;
+    int opt;
+    while((opt = getopt(argc, argv, "i:cs")) != -1){
+        switch(opt){
+            case 'i': iterations = atoi(optarg); break;
+            case 'c': warm = false; break;
+            case 's': swapped = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-i iterations] [-c] [-s]\n", argv[0]);
+                return 2;
+        }
+    }
+    if(iterations < 1) iterations = 1;
+
+    // The card is a directory, in a scratch directory of its own
+    char work_dir[] = "/tmp/bench_profiles.XXXXXX";
+    ESP_ERROR_CHECK(mkdtemp(work_dir) ? ESP_OK : ESP_FAIL);
+    ESP_ERROR_CHECK(chdir(work_dir) == 0 ? ESP_OK : ESP_FAIL);
+
+    fake_r502_config_t config;
+    fake_r502_default_config(&config);
+    config.library_size = MAX_PROFILES;
+    ESP_ERROR_CHECK(fake_r502_start(&config));
+    seed_database(warm, swapped);
+
+    // Board bring-up as in app_main
+    gpio_install_isr_service(0);
+    WS2_init(&CFAL1602, -1, 15, 14, 13);
+
+    bench_result_t init = { .name = "profileRecog_init" };
+    bench_result_t verify_hit = { .name = "verifyUser_PIN" };
+    bench_result_t verify_miss = { .name = "verifyUser_PIN denied" };
+    bench_result_t compile = { .name = "addProfile_compile" };
+    bench_result_t delete = { .name = "deleteProfile_remove" };
+    bench_result_t finger = { .name = "fingerprint, open door" };
+    int64_t start_us, delay_start;
+    uint8_t fl, code, priv, PIN[4];
+
+    // 1: Boot
+    start_us = bench_start(&delay_start);
+    check(profileRecog_init() == ESP_OK, "profileRecog_init");
+    bench_stop(&init, start_us, delay_start);
+    check(profile_isUsed(MAX_PROFILES - 2) && !profile_isUsed(MAX_PROFILES - 1),
+        "profiles imported");
+    bool in_sync = true;
+    for(int i = 0; i < MAX_PROFILES - 1; i++){
+        fake_r502_finger_template(i, template);
+        in_sync = in_sync && fake_r502_get_template(i, held) &&
+            memcmp(held, template, R502_TEMPLATE_SIZE) == 0;
+    }
+    check(in_sync, "R503 holds the database templates");
+
+    // 2: Verify, a PIN from the middle of the table, then an unknown one
+    pin_of(MAX_PROFILES / 2, PIN);
+    for(int i = 0; i < iterations * VERIFY_ITERATIONS_PER; i++){
+        fl = FL_PIN;
+        start_us = bench_start(&delay_start);
+        check(verifyUser_PIN(&fl, PIN, &code, &priv) == ESP_OK && code == 0, "verifyUser_PIN");
+        bench_stop(&verify_hit, start_us, delay_start);
+    }
+    pin_of(NEW_PIN, PIN);
+    fl = FL_PIN;
+    start_us = bench_start(&delay_start);
+    check(verifyUser_PIN(&fl, PIN, &code, &priv) == ESP_FAIL && code == 1,
+        "verifyUser_PIN denied");
+    bench_stop(&verify_miss, start_us, delay_start);
+
+    // 3: Add a profile to the one free slot, then delete it again
+    for(int i = 0; i < iterations; i++){
+        enter_new_profile(&fl);
+        start_us = bench_start(&delay_start);
+        check(addProfile_compile(&fl, &code) == ESP_OK, "addProfile_compile");
+        bench_stop(&compile, start_us, delay_start);
+        check(profile_isUsed(MAX_PROFILES - 1), "new profile in the last slot");
+
+        fl = 0;
+        start_us = bench_start(&delay_start);
+        check(deleteProfile_remove(&fl, MAX_PROFILES - 1, &code) == ESP_OK && code == 0,
+            "deleteProfile_remove");
+        bench_stop(&delete, start_us, delay_start);
+        check(!profile_isUsed(MAX_PROFILES - 1), "profile deleted");
+    }
+
+    // 4: Touch a known finger and open the door, through the auth task as in
+    // app_main, and show it as the input task does. Timed from the touch
+    // until the relay is on
+    check(relay_init() == ESP_OK, "relay_init");
+    check(input_init() == ESP_OK, "input_init");
+    check(auth_start() == ESP_OK, "auth_start");
+    accessAdmin = 0;
+    for(int i = 0; i < iterations; i++){
+        input_event_t event;
+        flags = FL_VERIFYUSER | FL_PIN | FL_FP_0;
+        start_us = bench_start(&delay_start);
+        fake_r502_place_finger(MAX_PROFILES / 2);
+        int64_t timeout_us = start_us + BENCH_TIMEOUT_US;
+        while(gpio_get_level(RELAY_OUTPUT) == 0 && esp_timer_get_time() < timeout_us){
+            sched_yield();
+        }
+        bench_stop(&finger, start_us, delay_start);
+        check(gpio_get_level(RELAY_OUTPUT) == 1, "relay on");
+
+        // The touch is one input, shown in its turn
+        check(input_receive(&event, BENCH_TIMEOUT_US / 1000 / portTICK_PERIOD_MS) &&
+            event.source == INPUT_EVENT_AUTH, "touch queued for the input task");
+        auth_input_handler();
+        check(!input_receive(&event, 0), "touch queued once");
+        check(ret_code == 0 && privilege == (MAX_PROFILES / 2) % 4, "door user found");
+        check((flags & FL_FSM) == FL_VERIFYUSER, "back to verifyUser");
+
+        // The relay_pulse timer ends the pulse
+        vTaskDelay((RELAY_PULSE_MS + 100) / portTICK_PERIOD_MS);
+        check(gpio_get_level(RELAY_OUTPUT) == 0, "relay off after the pulse");
+    }
+
+    // 4b: A touch behind a full input queue waits for room, then reaches the
+    // input task
+    input_event_t event = { .source = INPUT_EVENT_KEY, .key = '#' };
+    for(int i = 0; i < INPUT_QUEUE_SIZE; i++){
+        check(input_post(&event, 0), "input queue filled");
+    }
+    fake_r502_place_finger(MAX_PROFILES / 2);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    for(int i = 0; i < INPUT_QUEUE_SIZE; i++){
+        check(input_receive(&event, 0) && event.source == INPUT_EVENT_KEY, "queued key");
+    }
+    check(input_receive(&event, BENCH_TIMEOUT_US / 1000 / portTICK_PERIOD_MS) &&
+        event.source == INPUT_EVENT_GPIO && event.gpio_num == PIN_IRQ,
+        "touch passed on to the input task");
+    // Take the finger as the input task's gpio_handler would
+    fp_match_t match;
+    R502_conf_code_t res;
+    check(verifyUser_fingerprint_match(&match, &priv, &res) == ESP_OK &&
+        match == FP_MATCH_found, "passed on touch matched");
+
+    // 5: Two profiles share a PIN. Deleting the first leaves the second's
+    // PIN working
+    pin_of(0, PIN);
+    fl = FL_PIN;
+    check(verifyUser_PIN(&fl, PIN, &code, &priv) == ESP_OK && priv == 0,
+        "shared PIN finds the first profile");
+    fl = 0;
+    check(deleteProfile_remove(&fl, 0, &code) == ESP_OK && code == 0,
+        "deleteProfile_remove shared PIN");
+    fl = FL_PIN;
+    check(verifyUser_PIN(&fl, PIN, &code, &priv) == ESP_OK && code == 0 &&
+        priv == SHARED_PIN_SLOT % 4, "shared PIN finds the second profile");
+
+    printf("\n%s boot, times in ms, SD card on host files\n",
+        !warm ? "Cold" : swapped ? "Swapped sensor" : "Warm");
+    printf("%-22s %5s %5s %10s %10s %10s %10s %10s\n", "operation", "slots", "runs", "mean",
+        "min", "max", "delay", "work");
+    print_result(&init);
+    print_result(&verify_hit);
+    print_result(&verify_miss);
+    print_result(&compile);
+    print_result(&delete);
+    print_result(&finger);
+    printf("\nFinger to relay by stage\n");
+    LT_print(stdout);
+    printf("%s\n", failures ? "FAIL" : "OK");
+    fflush(stdout);
+
+    fake_r502_stop();
+    chdir("/");
+    nftw(work_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    // The display and event loop tasks never end, leave without joining them
+    _exit(failures ? 1 : 0);
+}
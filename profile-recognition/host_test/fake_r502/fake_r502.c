@@ -0,0 +1,819 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "fake_r502.h"
+#include "R502Checksum.h"
+
+#define HEADER_SIZE offsetof(R502_DataPkg_t, data)
+#define IN_BUFFER_SIZE 8192
+// An ack plus a template in 32 byte data packages
+#define OUT_MAX_PACKAGES (R502_TEMPLATE_SIZE / 32 + 1)
+#define OUT_BUFFER_SIZE (OUT_MAX_PACKAGES * (HEADER_SIZE + R502_CS_LEN) + \
+    R502_TEMPLATE_SIZE + sizeof(R502_DataPkg_t))
+// Longest a getter waits for the fake to catch up with the driver
+#define IDLE_TIMEOUT_MS 1000
+// Bytes handed to the driver at a time, the ESP32 RX FIFO full threshold
+#define FIFO_CHUNK 120
+#define MATCH_SCORE 200
+
+/**
+ * \brief Packages to send for one command, with the fault for each
+ */
+typedef struct {
+    uint8_t bytes[OUT_BUFFER_SIZE];
+    size_t len;
+    size_t start[OUT_MAX_PACKAGES + 1];
+    fake_r502_fault_t fault[OUT_MAX_PACKAGES];
+    int count;
+    int fault_delay_us;
+} reply_t;
+
+static struct {
+    fake_r502_config_t config;
+    pthread_t thread;
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t idle;
+    bool busy; //!< handling a package, or sending the reply
+    uint32_t generation; //!< bumped by reset, replies in flight are dropped
+
+    // bytes from the driver
+    uint8_t in[IN_BUFFER_SIZE];
+    size_t in_len;
+    int64_t in_done_us;
+
+    // module state
+    R502_baud_t baud;
+    R502_baud_t pending_baud; //!< switch to after the ack of SetSysPara
+    R502_data_len_t data_len;
+    uint16_t security_level;
+    uint8_t char_buffer[2][R502_TEMPLATE_SIZE];
+    uint8_t *library;
+    bool *library_used;
+    int finger; //!< on the sensor, -1 for none
+    int image; //!< in the image buffer, -1 for none
+    int down_char_buffer; //!< receiving DownChar data into, -1 for none
+    int down_char_len;
+    uint8_t led_config[4];
+
+    fake_r502_fault_t fault;
+    int fault_skip;
+    int fault_count;
+    int fault_delay_us;
+
+    fake_r502_stats_t stats;
+} fake = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+};
+
+// Private functions
+
+static void sleep_until_us(int64_t when_us)
+{
+    int64_t wait_us = when_us - esp_timer_get_time();
+    if(wait_us <= 0) return;
+    struct timespec ts = {
+        .tv_sec = wait_us / 1000000,
+        .tv_nsec = (wait_us % 1000000) * 1000
+    };
+    while(nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+static uint16_t get_16(const uint8_t in[2])
+{
+    return (in[0] << 8) | in[1];
+}
+
+static void put_16(uint8_t out[2], uint16_t value)
+{
+    out[0] = value >> 8;
+    out[1] = value & 0xff;
+}
+
+static bool wired(void)
+{
+    int tx_io_num = UART_PIN_NO_CHANGE;
+    int rx_io_num = UART_PIN_NO_CHANGE;
+    host_uart_get_pins(fake.config.uart_num, &tx_io_num, &rx_io_num);
+    return tx_io_num == fake.config.tx_io_num && rx_io_num == fake.config.rx_io_num;
+}
+
+/**
+ * \brief Fault for the next package sent, counting down the injection
+ */
+static fake_r502_fault_t next_fault(void)
+{
+    if(fake.fault == fake_r502_fault_none) return fake_r502_fault_none;
+    if(fake.fault_skip > 0){
+        fake.fault_skip--;
+        return fake_r502_fault_none;
+    }
+    fake_r502_fault_t fault = fake.fault;
+    if(--fake.fault_count <= 0) fake.fault = fake_r502_fault_none;
+    return fault;
+}
+
+static void reply_package(reply_t *out, uint8_t pid, const uint8_t *data, size_t data_len)
+{
+    uint8_t *pkg = out->bytes + out->len;
+    uint16_t length = data_len + R502_CS_LEN;
+    pkg[0] = 0xEF;
+    pkg[1] = 0x01;
+    memcpy(pkg + 2, fake.config.adder, 4);
+    pkg[6] = pid;
+    put_16(pkg + 7, length);
+    uint16_t sum = R502_checksum_copy(pid + pkg[7] + pkg[8], pkg + HEADER_SIZE, data,
+        data_len);
+    put_16(pkg + HEADER_SIZE + data_len, sum);
+
+    out->start[out->count] = out->len;
+    out->fault[out->count] = next_fault();
+    out->count++;
+    out->len += HEADER_SIZE + length;
+    out->start[out->count] = out->len;
+}
+
+/**
+ * \brief Ack package, confirmation code then extra_len bytes of extra
+ */
+static void reply_ack(reply_t *out, R502_conf_code_t conf_code, const uint8_t *extra,
+    size_t extra_len)
+{
+    uint8_t data[1 + R502_INDEX_TABLE_LEN];
+    data[0] = conf_code;
+    if(extra_len) memcpy(data + 1, extra, extra_len);
+    reply_package(out, R502_pid_ack, data, 1 + extra_len);
+}
+
+static bool valid_buffer_id(uint8_t buffer_id)
+{
+    return buffer_id == 1 || buffer_id == 2;
+}
+
+static uint8_t *library_page(uint16_t page_id)
+{
+    return fake.library + (size_t)page_id * R502_TEMPLATE_SIZE;
+}
+
+/**
+ * \brief Take one whole package off the input, dropping noise before it
+ * \retval false if there isn't a whole package yet
+ */
+static bool take_package(R502_DataPkg_t *pkg)
+{
+    for(;;){
+        // Sync on the start code
+        size_t skip = 0;
+        while(skip < fake.in_len && !(fake.in[skip] == 0xEF &&
+            (skip + 1 == fake.in_len || fake.in[skip + 1] == 0x01)))
+        {
+            skip++;
+        }
+        if(skip){
+            memmove(fake.in, fake.in + skip, fake.in_len - skip);
+            fake.in_len -= skip;
+        }
+        if(fake.in_len < HEADER_SIZE) return false;
+
+        size_t len = HEADER_SIZE + get_16(fake.in + 7);
+        if(get_16(fake.in + 7) < R502_CS_LEN + 1 || len > sizeof(R502_DataPkg_t)){
+            // Not a real header, resync after this start code
+            fake.stats.bad_packages++;
+            memmove(fake.in, fake.in + 1, fake.in_len - 1);
+            fake.in_len--;
+            continue;
+        }
+        if(fake.in_len < len) return false;
+
+        memcpy(pkg, fake.in, len);
+        memmove(fake.in, fake.in + len, fake.in_len - len);
+        fake.in_len -= len;
+        return true;
+    }
+}
+
+static int handle_command(const R502_DataPkg_t *pkg, reply_t *out, bool *released)
+{
+    const uint8_t *data = (const uint8_t *)&pkg->data;
+    int latency_us = fake.config.reply_latency_us;
+    fake.stats.commands++;
+    fake.stats.last_instr_code = data[0];
+
+    switch(data[0]){
+        case R502_ic_vfy_pwd:
+            reply_ack(out, memcmp(pkg->data.vfy_pwd.password, fake.config.password, 4) ?
+                R502_err_wrong_pass : R502_ok, NULL, 0);
+            break;
+
+        case R502_ic_set_sys_para: {
+            uint8_t contents = pkg->data.set_sys_para.contents;
+            R502_conf_code_t conf_code = R502_ok;
+            switch(pkg->data.set_sys_para.parameter_number){
+                case R502_para_num_baud_control:
+                    if(contents == 1 || contents == 2 || contents == 4 || contents == 6 ||
+                        contents == 12)
+                    {
+                        fake.pending_baud = contents;
+                    }
+                    else{
+                        conf_code = R502_err_wrong_reg_config;
+                    }
+                    break;
+                case R502_para_num_security_level:
+                    if(contents >= 1 && contents <= 5){
+                        fake.security_level = contents;
+                    }
+                    else{
+                        conf_code = R502_err_wrong_reg_config;
+                    }
+                    break;
+                case R502_para_num_data_pkg_len:
+                    if(contents <= R502_data_len_256){
+                        fake.data_len = contents;
+                        if(fake.config.min_data_len_128 && contents < R502_data_len_128){
+                            fake.data_len = R502_data_len_128;
+                        }
+                    }
+                    else{
+                        conf_code = R502_err_wrong_reg_config;
+                    }
+                    break;
+                default:
+                    conf_code = R502_err_invalid_reg_num;
+                    break;
+            }
+            reply_ack(out, conf_code, NULL, 0);
+            break;
+        }
+
+        case R502_ic_read_sys_para: {
+            uint8_t para[16];
+            put_16(para + 0, fake.image >= 0 ? 0x8 : 0x0);
+            put_16(para + 2, 0);
+            put_16(para + 4, fake.config.library_size);
+            put_16(para + 6, fake.security_level);
+            memcpy(para + 8, fake.config.adder, 4);
+            put_16(para + 12, fake.data_len);
+            put_16(para + 14, fake.baud);
+            reply_ack(out, R502_ok, para, sizeof(para));
+            break;
+        }
+
+        case R502_ic_template_num: {
+            uint16_t count = 0;
+            for(int i = 0; i < fake.config.library_size; i++){
+                count += fake.library_used[i];
+            }
+            uint8_t num[2];
+            put_16(num, count);
+            reply_ack(out, R502_ok, num, sizeof(num));
+            break;
+        }
+
+        case R502_ic_read_index_table: {
+            uint8_t index[R502_INDEX_TABLE_LEN] = { 0 };
+            uint8_t index_page = pkg->data.read_index_table.index_page;
+            // The module has 4 pages, a bigger simulated library has more
+            if(index_page > 3 &&
+                index_page * R502_INDEX_TABLE_LEN * 8 >= fake.config.library_size)
+            {
+                reply_ack(out, R502_err_wrong_page_num, index, sizeof(index));
+                break;
+            }
+            for(int i = 0; i < R502_INDEX_TABLE_LEN * 8; i++){
+                int page_id = index_page * R502_INDEX_TABLE_LEN * 8 + i;
+                if(page_id < fake.config.library_size && fake.library_used[page_id]){
+                    index[i / 8] |= 1 << (i % 8);
+                }
+            }
+            reply_ack(out, R502_ok, index, sizeof(index));
+            break;
+        }
+
+        case R502_ic_gen_img:
+            latency_us += fake.config.image_latency_us;
+            if(fake.finger < 0){
+                reply_ack(out, R502_err_no_finger, NULL, 0);
+                break;
+            }
+            fake.image = fake.finger;
+            fake.finger = -1;
+            *released = true;
+            reply_ack(out, R502_ok, NULL, 0);
+            break;
+
+        case R502_ic_img_2_tz: {
+            uint8_t buffer_id = pkg->data.img_2_tz.buffer_id;
+            latency_us += fake.config.image_latency_us;
+            if(fake.image < 0){
+                reply_ack(out, R502_err_no_valid_primary_image, NULL, 0);
+            }
+            else if(!valid_buffer_id(buffer_id)){
+                reply_ack(out, R502_err_no_character_pointer, NULL, 0);
+            }
+            else{
+                fake_r502_finger_template(fake.image, fake.char_buffer[buffer_id - 1]);
+                reply_ack(out, R502_ok, NULL, 0);
+            }
+            break;
+        }
+
+        case R502_ic_reg_model:
+            latency_us += fake.config.image_latency_us;
+            reply_ack(out, memcmp(fake.char_buffer[0], fake.char_buffer[1],
+                R502_TEMPLATE_SIZE) ? R502_err_combine : R502_ok, NULL, 0);
+            break;
+
+        case R502_ic_up_char: {
+            uint8_t buffer_id = pkg->data.up_char.buffer_id;
+            if(!valid_buffer_id(buffer_id)){
+                reply_ack(out, R502_err_uploading_template, NULL, 0);
+                break;
+            }
+            reply_ack(out, R502_ok, NULL, 0);
+            int package_len = 32 << fake.data_len;
+            const uint8_t *src = fake.char_buffer[buffer_id - 1];
+            for(int sent = 0; sent < R502_TEMPLATE_SIZE; sent += package_len){
+                bool last = sent + package_len >= R502_TEMPLATE_SIZE;
+                reply_package(out, last ? R502_pid_end_of_data : R502_pid_data, src + sent,
+                    package_len);
+            }
+            break;
+        }
+
+        case R502_ic_down_char: {
+            uint8_t buffer_id = pkg->data.down_char.buffer_id;
+            if(!valid_buffer_id(buffer_id)){
+                reply_ack(out, R502_err_receiving_data, NULL, 0);
+                break;
+            }
+            fake.down_char_buffer = buffer_id - 1;
+            fake.down_char_len = 0;
+            reply_ack(out, R502_ok, NULL, 0);
+            break;
+        }
+
+        case R502_ic_store: {
+            uint8_t buffer_id = pkg->data.store.buffer_id;
+            uint16_t page_id = get_16(pkg->data.store.page_id);
+            latency_us += fake.config.image_latency_us;
+            if(!valid_buffer_id(buffer_id) || page_id >= fake.config.library_size){
+                reply_ack(out, R502_err_page_id_out_of_range, NULL, 0);
+                break;
+            }
+            memcpy(library_page(page_id), fake.char_buffer[buffer_id - 1], R502_TEMPLATE_SIZE);
+            fake.library_used[page_id] = true;
+            reply_ack(out, R502_ok, NULL, 0);
+            break;
+        }
+
+        case R502_ic_load_char: {
+            uint8_t buffer_id = pkg->data.load_char.buffer_id;
+            uint16_t page_id = get_16(pkg->data.load_char.page_id);
+            if(!valid_buffer_id(buffer_id) || page_id >= fake.config.library_size){
+                reply_ack(out, R502_err_page_id_out_of_range, NULL, 0);
+                break;
+            }
+            if(!fake.library_used[page_id]){
+                reply_ack(out, R502_err_reading_template, NULL, 0);
+                break;
+            }
+            memcpy(fake.char_buffer[buffer_id - 1], library_page(page_id), R502_TEMPLATE_SIZE);
+            reply_ack(out, R502_ok, NULL, 0);
+            break;
+        }
+
+        case R502_ic_delet_char: {
+            uint16_t page_id = get_16(pkg->data.delet_char.page_id);
+            uint16_t n = get_16(pkg->data.delet_char.num_of_templates);
+            if(n == 0 || page_id + n > fake.config.library_size){
+                reply_ack(out, R502_err_deleting_template, NULL, 0);
+                break;
+            }
+            memset(fake.library_used + page_id, 0, n * sizeof(bool));
+            reply_ack(out, R502_ok, NULL, 0);
+            break;
+        }
+
+        case R502_ic_empty:
+            memset(fake.library_used, 0, fake.config.library_size * sizeof(bool));
+            reply_ack(out, R502_ok, NULL, 0);
+            break;
+
+        case R502_ic_search: {
+            uint8_t buffer_id = pkg->data.search.buffer_id;
+            int start_page = get_16(pkg->data.search.start_page);
+            int end_page = start_page + get_16(pkg->data.search.page_num);
+            uint8_t result[4] = { 0 };
+            latency_us += fake.config.image_latency_us;
+            if(!valid_buffer_id(buffer_id)){
+                reply_ack(out, R502_err_no_character_pointer, result, sizeof(result));
+                break;
+            }
+            if(end_page > fake.config.library_size) end_page = fake.config.library_size;
+            R502_conf_code_t conf_code = R502_err_not_found;
+            for(int page_id = start_page; page_id < end_page; page_id++){
+                if(fake.library_used[page_id] && memcmp(library_page(page_id),
+                    fake.char_buffer[buffer_id - 1], R502_TEMPLATE_SIZE) == 0)
+                {
+                    put_16(result, page_id);
+                    put_16(result + 2, MATCH_SCORE);
+                    conf_code = R502_ok;
+                    break;
+                }
+            }
+            reply_ack(out, conf_code, result, sizeof(result));
+            break;
+        }
+
+        case R502_ic_led_config:
+            fake.led_config[0] = pkg->data.led_config.ctrl;
+            fake.led_config[1] = pkg->data.led_config.speed;
+            fake.led_config[2] = pkg->data.led_config.color_index;
+            fake.led_config[3] = pkg->data.led_config.count;
+            reply_ack(out, R502_ok, NULL, 0);
+            break;
+
+        default:
+            reply_ack(out, R502_err_receive, NULL, 0);
+            break;
+    }
+    return latency_us;
+}
+
+/**
+ * \brief Act on one package from the driver, filling out with the reply
+ * \retval time to take before replying, us
+ */
+static int handle_package(const R502_DataPkg_t *pkg, reply_t *out, bool *released)
+{
+    int data_len = get_16(pkg->length) - R502_CS_LEN;
+    const uint8_t *data = (const uint8_t *)&pkg->data;
+    uint16_t sum = R502_checksum(pkg->pid + pkg->length[0] + pkg->length[1], data, data_len);
+    if(sum != get_16(data + data_len) || memcmp(pkg->adder, fake.config.adder, 4)){
+        fake.stats.bad_packages++;
+        if(pkg->pid == R502_pid_command && !memcmp(pkg->adder, fake.config.adder, 4)){
+            reply_ack(out, R502_err_receive, NULL, 0);
+            return fake.config.reply_latency_us;
+        }
+        fake.down_char_buffer = -1;
+        return 0;
+    }
+
+    switch(pkg->pid){
+        case R502_pid_command:
+            return handle_command(pkg, out, released);
+
+        case R502_pid_data:
+        case R502_pid_end_of_data:
+            fake.stats.data_packages_in++;
+            if(fake.down_char_buffer >= 0){
+                int n = data_len;
+                if(fake.down_char_len + n > R502_TEMPLATE_SIZE){
+                    n = R502_TEMPLATE_SIZE - fake.down_char_len;
+                }
+                memcpy(fake.char_buffer[fake.down_char_buffer] + fake.down_char_len, data, n);
+                fake.down_char_len += n;
+                if(pkg->pid == R502_pid_end_of_data) fake.down_char_buffer = -1;
+            }
+            return 0;
+
+        default:
+            fake.stats.bad_packages++;
+            return 0;
+    }
+}
+
+/**
+ * \brief Hand bytes to the driver a FIFO at a time, each after its wire time
+ * \param wire_us IN/OUT when the previous byte finished on the wire
+ * \retval false if a reset abandoned the reply
+ */
+static bool send_paced(const uint8_t *data, size_t len, uint32_t baudrate,
+    uint32_t generation, int64_t *wire_us, bool last)
+{
+    size_t sent = 0;
+    while(sent < len){
+        size_t n = len - sent < FIFO_CHUNK ? len - sent : FIFO_CHUNK;
+        int64_t now = esp_timer_get_time();
+        if(*wire_us < now) *wire_us = now;
+        *wire_us += (int64_t)n * 10 * 1000000 / baudrate;
+        sleep_until_us(*wire_us);
+
+        pthread_mutex_lock(&fake.lock);
+        if(fake.generation != generation){
+            pthread_mutex_unlock(&fake.lock);
+            return false;
+        }
+        if(last && sent + n == len && fake.pending_baud){
+            // Listen at the new rate before the driver can hear the ack
+            fake.baud = fake.pending_baud;
+            fake.pending_baud = 0;
+        }
+        bool connected = wired();
+        fake.stats.bytes_out += n;
+        pthread_mutex_unlock(&fake.lock);
+
+        if(connected) host_uart_inject(fake.config.uart_num, data + sent, n, baudrate);
+        sent += n;
+    }
+    return true;
+}
+
+static void send_reply(const reply_t *out, uint32_t baudrate, uint32_t generation)
+{
+    static const uint8_t noise[] = { 0x00, 0xEF, 0x55, 0xFF };
+    int64_t wire_us = 0;
+    for(int i = 0; i < out->count; i++){
+        const uint8_t *pkg = out->bytes + out->start[i];
+        size_t len = out->start[i + 1] - out->start[i];
+        bool last = (i == out->count - 1);
+        uint8_t corrupt[sizeof(R502_DataPkg_t)];
+
+        switch(out->fault[i]){
+            case fake_r502_fault_drop:
+                continue;
+            case fake_r502_fault_checksum:
+                memcpy(corrupt, pkg, len);
+                corrupt[len - 1] ^= 0x01;
+                pkg = corrupt;
+                break;
+            case fake_r502_fault_truncate:
+                // The rest of the reply never comes
+                send_paced(pkg, len / 2, baudrate, generation, &wire_us, true);
+                return;
+            case fake_r502_fault_noise:
+                if(!send_paced(noise, sizeof(noise), baudrate, generation, &wire_us, false)){
+                    return;
+                }
+                break;
+            case fake_r502_fault_delay:
+                wire_us = esp_timer_get_time() + out->fault_delay_us;
+                sleep_until_us(wire_us);
+                break;
+            case fake_r502_fault_zero_length:
+                // No payload and no room for a checksum
+                memcpy(corrupt, pkg, HEADER_SIZE);
+                put_16(corrupt + 7, 0);
+                send_paced(corrupt, HEADER_SIZE, baudrate, generation, &wire_us, true);
+                return;
+            default:
+                break;
+        }
+        if(!send_paced(pkg, len, baudrate, generation, &wire_us, last)) return;
+
+        pthread_mutex_lock(&fake.lock);
+        if(fake.generation == generation) fake.stats.packages_out++;
+        pthread_mutex_unlock(&fake.lock);
+    }
+}
+
+static void *fake_task(void *arg)
+{
+    static reply_t out;
+    R502_DataPkg_t pkg;
+
+    pthread_mutex_lock(&fake.lock);
+    while(fake.running){
+        if(!take_package(&pkg)){
+            fake.busy = false;
+            pthread_cond_broadcast(&fake.idle);
+            pthread_cond_wait(&fake.wake, &fake.lock);
+            continue;
+        }
+        fake.busy = true;
+        uint32_t generation = fake.generation;
+        int64_t arrived_us = fake.in_done_us;
+        bool released = false;
+        out.len = 0;
+        out.count = 0;
+        out.fault_delay_us = fake.fault_delay_us;
+        int latency_us = handle_package(&pkg, &out, &released);
+        uint32_t baudrate = 9600 * fake.baud;
+        pthread_mutex_unlock(&fake.lock);
+
+        if(released) host_gpio_set_input(fake.config.irq_io_num, 1);
+        if(out.count){
+            sleep_until_us(arrived_us + latency_us);
+            send_reply(&out, baudrate, generation);
+        }
+        pthread_mutex_lock(&fake.lock);
+        if(fake.generation == generation && fake.pending_baud){
+            // Every package of the ack dropped, switch anyway
+            fake.baud = fake.pending_baud;
+            fake.pending_baud = 0;
+        }
+    }
+    pthread_mutex_unlock(&fake.lock);
+    return NULL;
+}
+
+/**
+ * \brief Take the lock once the thread has handled every whole package
+ * received, or after IDLE_TIMEOUT_MS
+ */
+static void lock_when_idle(void)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += IDLE_TIMEOUT_MS / 1000;
+    pthread_mutex_lock(&fake.lock);
+    while(fake.running && (fake.busy || fake.in_len >= HEADER_SIZE)){
+        if(pthread_cond_timedwait(&fake.idle, &fake.lock, &deadline) == ETIMEDOUT) break;
+    }
+}
+
+static void fake_receive(void *ctx, const uint8_t *data, size_t len, uint32_t baudrate,
+    int64_t done_us)
+{
+    pthread_mutex_lock(&fake.lock);
+    if(!fake.running || !wired() || baudrate != 9600 * fake.baud ||
+        fake.in_len + len > IN_BUFFER_SIZE)
+    {
+        fake.stats.bytes_dropped += len;
+        pthread_mutex_unlock(&fake.lock);
+        return;
+    }
+    memcpy(fake.in + fake.in_len, data, len);
+    fake.in_len += len;
+    fake.in_done_us = done_us;
+    fake.stats.bytes_in += len;
+    pthread_cond_signal(&fake.wake);
+    pthread_mutex_unlock(&fake.lock);
+}
+
+// Public functions
+
+void fake_r502_default_config(fake_r502_config_t *config)
+{
+    *config = (fake_r502_config_t){
+        .uart_num = UART_NUM_1,
+        .tx_io_num = GPIO_NUM_17,
+        .rx_io_num = GPIO_NUM_16,
+        .irq_io_num = GPIO_NUM_4,
+        .baud = R502_baud_57600,
+        .adder = {0xFF, 0xFF, 0xFF, 0xFF},
+        .password = {0x00, 0x00, 0x00, 0x00},
+        .library_size = 200,
+        .min_data_len_128 = true,
+        .reply_latency_us = 1000,
+        .image_latency_us = 0,
+    };
+}
+
+esp_err_t fake_r502_start(const fake_r502_config_t *config)
+{
+    if(fake.running) return ESP_ERR_INVALID_STATE;
+    fake.config = *config;
+    fake.library = calloc(config->library_size, R502_TEMPLATE_SIZE);
+    fake.library_used = calloc(config->library_size, sizeof(bool));
+    if(!fake.library || !fake.library_used){
+        free(fake.library);
+        free(fake.library_used);
+        return ESP_ERR_NO_MEM;
+    }
+    fake_r502_reset();
+
+    fake.running = true;
+    if(pthread_create(&fake.thread, NULL, fake_task, NULL)){
+        fake.running = false;
+        return ESP_FAIL;
+    }
+    host_uart_peer_t peer = {
+        .receive = fake_receive,
+        .ctx = NULL
+    };
+    host_uart_attach(config->uart_num, &peer);
+    return ESP_OK;
+}
+
+void fake_r502_stop(void)
+{
+    if(!fake.running) return;
+    host_uart_attach(fake.config.uart_num, NULL);
+    pthread_mutex_lock(&fake.lock);
+    fake.running = false;
+    fake.generation++;
+    pthread_cond_signal(&fake.wake);
+    pthread_mutex_unlock(&fake.lock);
+    pthread_join(fake.thread, NULL);
+    free(fake.library);
+    free(fake.library_used);
+    fake.library = NULL;
+    fake.library_used = NULL;
+}
+
+void fake_r502_reset(void)
+{
+    pthread_mutex_lock(&fake.lock);
+    fake.generation++;
+    fake.in_len = 0;
+    fake.baud = fake.config.baud;
+    fake.pending_baud = 0;
+    fake.data_len = R502_data_len_128;
+    fake.security_level = 3;
+    fake.finger = -1;
+    fake.image = -1;
+    fake.down_char_buffer = -1;
+    memset(fake.led_config, 0, sizeof(fake.led_config));
+    memset(fake.library_used, 0, fake.config.library_size * sizeof(bool));
+    fake_r502_finger_template(0, library_page(0));
+    fake.library_used[0] = true;
+    memcpy(fake.char_buffer[0], library_page(0), R502_TEMPLATE_SIZE);
+    memcpy(fake.char_buffer[1], library_page(0), R502_TEMPLATE_SIZE);
+    fake.fault = fake_r502_fault_none;
+    memset(&fake.stats, 0, sizeof(fake.stats));
+    pthread_mutex_unlock(&fake.lock);
+    host_gpio_set_input(fake.config.irq_io_num, 1);
+}
+
+void fake_r502_set_latency(int reply_latency_us, int image_latency_us)
+{
+    pthread_mutex_lock(&fake.lock);
+    fake.config.reply_latency_us = reply_latency_us;
+    fake.config.image_latency_us = image_latency_us;
+    pthread_mutex_unlock(&fake.lock);
+}
+
+void fake_r502_place_finger(int finger_id)
+{
+    pthread_mutex_lock(&fake.lock);
+    fake.finger = finger_id;
+    pthread_mutex_unlock(&fake.lock);
+    host_gpio_set_input(fake.config.irq_io_num, 0);
+}
+
+void fake_r502_inject_fault(fake_r502_fault_t fault, int skip, int count, int delay_us)
+{
+    pthread_mutex_lock(&fake.lock);
+    fake.fault = count > 0 ? fault : fake_r502_fault_none;
+    fake.fault_skip = skip;
+    fake.fault_count = count;
+    fake.fault_delay_us = delay_us;
+    pthread_mutex_unlock(&fake.lock);
+}
+
+void fake_r502_get_stats(fake_r502_stats_t *stats)
+{
+    pthread_mutex_lock(&fake.lock);
+    *stats = fake.stats;
+    pthread_mutex_unlock(&fake.lock);
+}
+
+uint32_t fake_r502_get_baudrate(void)
+{
+    pthread_mutex_lock(&fake.lock);
+    uint32_t baudrate = 9600 * fake.baud;
+    pthread_mutex_unlock(&fake.lock);
+    return baudrate;
+}
+
+bool fake_r502_get_template(uint16_t page_id, uint8_t *out)
+{
+    lock_when_idle();
+    bool valid = fake.library && page_id < fake.config.library_size &&
+        fake.library_used[page_id];
+    if(valid) memcpy(out, library_page(page_id), R502_TEMPLATE_SIZE);
+    pthread_mutex_unlock(&fake.lock);
+    return valid;
+}
+
+bool fake_r502_set_template(uint16_t page_id, const uint8_t *data)
+{
+    lock_when_idle();
+    bool valid = fake.library && page_id < fake.config.library_size;
+    if(valid){
+        if(data) memcpy(library_page(page_id), data, R502_TEMPLATE_SIZE);
+        fake.library_used[page_id] = data != NULL;
+    }
+    pthread_mutex_unlock(&fake.lock);
+    return valid;
+}
+
+bool fake_r502_get_char_buffer(uint8_t buffer_id, uint8_t *out)
+{
+    lock_when_idle();
+    bool valid = valid_buffer_id(buffer_id);
+    if(valid) memcpy(out, fake.char_buffer[buffer_id - 1], R502_TEMPLATE_SIZE);
+    pthread_mutex_unlock(&fake.lock);
+    return valid;
+}
+
+void fake_r502_finger_template(int finger_id, uint8_t *out)
+{
+    // xorshift32, seeded per finger
+    uint32_t state = 0x9E3779B9u ^ (uint32_t)(finger_id + 1) * 0x85EBCA6Bu;
+    for(int i = 0; i < R502_TEMPLATE_SIZE; i++){
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        out[i] = state & 0xff;
+    }
+}
@@ -0,0 +1,149 @@
+#ifndef FAKE_R502_H_
+#define FAKE_R502_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "R502Definitions.h"
+
+/**
+ * \brief A simulated R502/R503 on the far side of a host UART
+ *
+ * The fake parses the packages the driver writes and answers like the module
+ * does: VfyPwd, SetSysPara, ReadSysPara, TemplateNum, ReadIndexTable,
+ * GenImg, Img2Tz, RegModel, UpChar, DownChar, Store, LoadChar, DeletChar, Empty,
+ * Search and AuraLedConfig. Replies go out from a thread of its own, at the
+ * module's baud rate and in FIFO sized chunks paced by the wire time, so
+ * driver timeouts and throughput behave as on the bench.
+ *
+ * ReadIndexTable has the module's 4 pages (1024 templates), or as many as a
+ * bigger library_size takes, for sizing runs beyond the real module.
+ *
+ * Bytes are only exchanged while the driver's pins are the ones the fake is
+ * wired to and both sides use the same baud rate, like the real module.
+ *
+ * A placed finger is an id. Img2Tz turns it into a character file derived
+ * from the id, so two captures of the same finger combine and match, and
+ * different fingers do not.
+ */
+
+/**
+ * \brief Power on state and timing of the simulated module
+ */
+typedef struct {
+    uart_port_t uart_num;
+    int tx_io_num; //!< ESP32 pin wired to the module's RX
+    int rx_io_num; //!< ESP32 pin wired to the module's TX
+    gpio_num_t irq_io_num; //!< ESP32 pin wired to the touch output, low on touch
+    R502_baud_t baud; //!< rate at power on
+    uint8_t adder[4];
+    uint8_t password[4];
+    uint16_t library_size;
+    /**
+     * Set 32 and 64 byte data packages as 128, like the bench module (see
+     * R502_set_data_package_length)
+     */
+    bool min_data_len_128;
+    int reply_latency_us; //!< processing time of a command before the ack
+    int image_latency_us; //!< extra for GenImg, Img2Tz, RegModel, Search, Store
+} fake_r502_config_t;
+
+/**
+ * \brief Faults applied to the packages the fake sends
+ */
+typedef enum {
+    fake_r502_fault_none,
+    fake_r502_fault_checksum, //!< flip a checksum bit
+    fake_r502_fault_drop, //!< send nothing
+    fake_r502_fault_truncate, //!< send the first half and stop
+    fake_r502_fault_noise, //!< garbage bytes before the start code
+    fake_r502_fault_delay, //!< send late, by fault_delay_us
+    fake_r502_fault_zero_length, //!< the header alone, its length field 0
+} fake_r502_fault_t;
+
+/**
+ * \brief Counters since the last fake_r502_reset
+ */
+typedef struct {
+    int commands; //!< command packages received with a valid checksum
+    int bad_packages; //!< packages received with a bad checksum or address
+    int data_packages_in;
+    int packages_out;
+    int bytes_in;
+    int bytes_out;
+    int bytes_dropped; //!< lost to a baud mismatch or unwired pins
+    uint8_t last_instr_code;
+} fake_r502_stats_t;
+
+/**
+ * \brief The wiring and behaviour of the module the component tests expect
+ */
+void fake_r502_default_config(fake_r502_config_t *config);
+
+/**
+ * \brief Attach the fake to config->uart_num and start its thread
+ */
+esp_err_t fake_r502_start(const fake_r502_config_t *config);
+
+/**
+ * \brief Stop the thread and detach from the UART
+ */
+void fake_r502_stop(void);
+
+/**
+ * \brief Power cycle: back to the configured baud rate, security level 3,
+ * 128 byte data packages, and one template in page 0 made from finger 0,
+ * also held in both char buffers. Clears faults, stats and any reply in
+ * flight
+ */
+void fake_r502_reset(void);
+
+/**
+ * \brief Change timing without a reset
+ */
+void fake_r502_set_latency(int reply_latency_us, int image_latency_us);
+
+/**
+ * \brief Put a finger on the sensor for the next GenImg. Pulls the touch
+ * output low, and it goes high again once the image is taken
+ */
+void fake_r502_place_finger(int finger_id);
+
+/**
+ * \brief Apply fault to count packages sent, after letting skip through
+ * \param delay_us for fake_r502_fault_delay
+ */
+void fake_r502_inject_fault(fake_r502_fault_t fault, int skip, int count, int delay_us);
+
+void fake_r502_get_stats(fake_r502_stats_t *stats);
+
+/**
+ * \brief Baud rate the module is at now, as 9600 * N
+ */
+uint32_t fake_r502_get_baudrate(void);
+
+/**
+ * \brief Library and char buffer access, for checking transfers. Waits for
+ * the fake to finish with what the driver has sent, then copies
+ * \param buffer_id 1 or 2
+ * \param out OUT R502_TEMPLATE_SIZE bytes
+ * \retval false for an empty or invalid page, or an invalid buffer
+ */
+bool fake_r502_get_template(uint16_t page_id, uint8_t *out);
+bool fake_r502_get_char_buffer(uint8_t buffer_id, uint8_t *out);
+
+/**
+ * \brief Fill a library page, as if it had been stored on an earlier run
+ * \param data R502_TEMPLATE_SIZE bytes, NULL to empty the page
+ * \retval false for a page outside the library
+ */
+bool fake_r502_set_template(uint16_t page_id, const uint8_t *data);
+
+/**
+ * \brief The character file Img2Tz makes for finger_id
+ * \param out OUT R502_TEMPLATE_SIZE bytes
+ */
+void fake_r502_finger_template(int finger_id, uint8_t *out);
+
+#endif
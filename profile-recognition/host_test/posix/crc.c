@@ -0,0 +1,27 @@
+#include <pthread.h>
+#include "esp32/rom/crc.h"
+
+static uint32_t crc32_table[256];
+static pthread_once_t crc32_table_once = PTHREAD_ONCE_INIT;
+
+static void crc32_table_init(void)
+{
+    // Reflected polynomial of the zlib CRC32
+    for(uint32_t i = 0; i < 256; i++){
+        uint32_t crc = i;
+        for(int bit = 0; bit < 8; bit++){
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        crc32_table[i] = crc;
+    }
+}
+
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    pthread_once(&crc32_table_once, crc32_table_init);
+    crc = ~crc;
+    for(uint32_t i = 0; i < len; i++){
+        crc = crc32_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
@@ -0,0 +1,176 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include "esp_timer.h"
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+
+    bool active;
+    int64_t alarm_us; //!< esp_timer_get_time of the next expiry
+    uint64_t period_us; //!< 0 for one-shot
+    struct esp_timer *next;
+};
+
+static pthread_mutex_t timer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timer_changed;
+static pthread_t timer_thread;
+static bool timer_thread_started;
+static struct esp_timer *timers;
+
+// Private functions
+
+static void deadline_at(struct timespec *deadline, int64_t when_us)
+{
+    // Conditions wait on CLOCK_MONOTONIC, and esp_timer_get_time counts from startup
+    int64_t wait_us = when_us - esp_timer_get_time();
+    if(wait_us < 0) wait_us = 0;
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    uint64_t ns = (uint64_t)wait_us * 1000 + deadline->tv_nsec;
+    deadline->tv_sec += ns / 1000000000;
+    deadline->tv_nsec = ns % 1000000000;
+}
+
+static struct esp_timer *earliest(void)
+{
+    struct esp_timer *first = NULL;
+    for(struct esp_timer *itr = timers; itr; itr = itr->next){
+        if(itr->active && (!first || itr->alarm_us < first->alarm_us)) first = itr;
+    }
+    return first;
+}
+
+static void *timer_task(void *arg)
+{
+    pthread_mutex_lock(&timer_lock);
+    for(;;){
+        struct esp_timer *timer = earliest();
+        if(!timer){
+            pthread_cond_wait(&timer_changed, &timer_lock);
+            continue;
+        }
+        if(timer->alarm_us > esp_timer_get_time()){
+            struct timespec deadline;
+            deadline_at(&deadline, timer->alarm_us);
+            pthread_cond_timedwait(&timer_changed, &timer_lock, &deadline);
+            continue;
+        }
+
+        // Rearm before the callback, so it can stop or restart the timer
+        if(timer->period_us){
+            timer->alarm_us += timer->period_us;
+        }
+        else{
+            timer->active = false;
+        }
+        esp_timer_cb_t callback = timer->callback;
+        void *callback_arg = timer->arg;
+        pthread_mutex_unlock(&timer_lock);
+        callback(callback_arg);
+        pthread_mutex_lock(&timer_lock);
+    }
+    return NULL;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t timer, uint64_t timeout_us, uint64_t period_us)
+{
+    if(!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timer_lock);
+    if(timer->active){
+        pthread_mutex_unlock(&timer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = true;
+    timer->alarm_us = esp_timer_get_time() + timeout_us;
+    timer->period_us = period_us;
+    pthread_cond_signal(&timer_changed);
+    pthread_mutex_unlock(&timer_lock);
+    return ESP_OK;
+}
+
+// Public functions
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args,
+    esp_timer_handle_t *out_handle)
+{
+    if(!create_args || !create_args->callback || !out_handle) return ESP_ERR_INVALID_ARG;
+    struct esp_timer *timer = calloc(1, sizeof(struct esp_timer));
+    if(!timer) return ESP_ERR_NO_MEM;
+    timer->callback = create_args->callback;
+    timer->arg = create_args->arg;
+    timer->name = create_args->name;
+
+    pthread_mutex_lock(&timer_lock);
+    if(!timer_thread_started){
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&timer_changed, &attr);
+        pthread_condattr_destroy(&attr);
+        if(pthread_create(&timer_thread, NULL, timer_task, NULL)){
+            pthread_mutex_unlock(&timer_lock);
+            free(timer);
+            return ESP_FAIL;
+        }
+        timer_thread_started = true;
+    }
+    timer->next = timers;
+    timers = timer;
+    pthread_mutex_unlock(&timer_lock);
+
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    if(period == 0) return ESP_ERR_INVALID_ARG;
+    return timer_start(timer, period, period);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if(!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timer_lock);
+    esp_err_t err = timer->active ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    pthread_cond_signal(&timer_changed);
+    pthread_mutex_unlock(&timer_lock);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    if(!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timer_lock);
+    if(timer->active){
+        pthread_mutex_unlock(&timer_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    for(struct esp_timer **itr = &timers; *itr; itr = &(*itr)->next){
+        if(*itr == timer){
+            *itr = timer->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&timer_lock);
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    if(!timer) return false;
+    pthread_mutex_lock(&timer_lock);
+    bool active = timer->active;
+    pthread_mutex_unlock(&timer_lock);
+    return active;
+}
@@ -0,0 +1,536 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+/**
+ * \brief A queue, or a semaphore when item_size is 0 (count is then the
+ * number of tokens). Mutexes also record their holder for recursion
+ */
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t count;
+    UBaseType_t head;
+    uint8_t *items;
+
+    TaskHandle_t holder;
+    UBaseType_t depth;
+};
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t task_code;
+    void *params;
+    UBaseType_t priority;
+    char name[16];
+
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify_value;
+    bool notify_pending;
+};
+
+static __thread struct host_task *current_task;
+static __thread int64_t delay_us;
+static pthread_mutex_t critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+// Private functions
+
+static void cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void deadline_after(struct timespec *deadline, TickType_t ticks)
+{
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    if(ticks == portMAX_DELAY) return;
+    uint64_t ns = (uint64_t)ticks * portTICK_PERIOD_MS * 1000000;
+    deadline->tv_sec += ns / 1000000000;
+    deadline->tv_nsec += ns % 1000000000;
+    if(deadline->tv_nsec >= 1000000000){
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+
+/**
+ * \brief Wait once on cond, as long as ticks allows
+ * \retval false if the time is up, so the caller should stop waiting
+ */
+static bool wait_until(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+    const struct timespec *deadline)
+{
+    if(ticks == 0) return false;
+    if(ticks == portMAX_DELAY){
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+static struct host_task *task_new(const char *name, UBaseType_t priority)
+{
+    struct host_task *task = calloc(1, sizeof(struct host_task));
+    if(!task) return NULL;
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->priority = priority;
+    pthread_mutex_init(&task->lock, NULL);
+    cond_init(&task->notified);
+    return task;
+}
+
+static struct host_task *task_self(void)
+{
+    // Threads not made by xTaskCreate, like main, get a task on first use
+    if(!current_task){
+        current_task = task_new("main", 1);
+        if(!current_task) abort();
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+static void *task_entry(void *arg)
+{
+    current_task = arg;
+    current_task->task_code(current_task->params);
+    return NULL;
+}
+
+static QueueHandle_t queue_new(UBaseType_t length, UBaseType_t item_size, UBaseType_t count)
+{
+    QueueHandle_t queue = calloc(1, sizeof(struct QueueDefinition));
+    if(!queue) return NULL;
+    if(item_size){
+        queue->items = malloc(length * item_size);
+        if(!queue->items){
+            free(queue);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    cond_init(&queue->not_empty);
+    cond_init(&queue->not_full);
+    queue->length = length;
+    queue->item_size = item_size;
+    queue->count = count;
+    return queue;
+}
+
+typedef enum {
+    queue_back,
+    queue_front,
+    queue_overwrite
+} queue_pos_t;
+
+static BaseType_t queue_put(QueueHandle_t queue, const void *item, TickType_t ticks,
+    queue_pos_t pos)
+{
+    struct timespec deadline;
+    deadline_after(&deadline, ticks);
+    pthread_mutex_lock(&queue->lock);
+    if(pos == queue_overwrite && queue->count == queue->length){
+        // Overwrite is for length 1 queues, replace the item held
+        queue->count--;
+    }
+    while(queue->count == queue->length){
+        if(!wait_until(&queue->not_full, &queue->lock, ticks, &deadline)) break;
+    }
+    if(queue->count == queue->length){
+        pthread_mutex_unlock(&queue->lock);
+        return pdFALSE;
+    }
+    if(queue->item_size){
+        UBaseType_t slot;
+        if(pos == queue_front){
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            slot = queue->head;
+        }
+        else{
+            slot = (queue->head + queue->count) % queue->length;
+        }
+        memcpy(queue->items + slot * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+static BaseType_t queue_get(QueueHandle_t queue, void *item, TickType_t ticks, bool remove)
+{
+    struct timespec deadline;
+    deadline_after(&deadline, ticks);
+    pthread_mutex_lock(&queue->lock);
+    while(queue->count == 0){
+        if(!wait_until(&queue->not_empty, &queue->lock, ticks, &deadline)) break;
+    }
+    if(queue->count == 0){
+        pthread_mutex_unlock(&queue->lock);
+        return pdFALSE;
+    }
+    if(queue->item_size && item){
+        memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    }
+    if(remove){
+        if(queue->item_size) queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+    else{
+        // Let the next waiter see it too
+        pthread_cond_signal(&queue->not_empty);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+// Critical sections
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    pthread_mutex_lock(&critical_lock);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+// Tasks
+
+BaseType_t xTaskCreate(TaskFunction_t task_code, const char *name, uint32_t stack_depth,
+    void *params, UBaseType_t priority, TaskHandle_t *created_task)
+{
+    struct host_task *task = task_new(name, priority);
+    if(!task) return pdFAIL;
+    task->task_code = task_code;
+    task->params = params;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int rc = pthread_create(&task->thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if(rc){
+        free(task);
+        return pdFAIL;
+    }
+    if(created_task) *created_task = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_code, const char *name,
+    uint32_t stack_depth, void *params, UBaseType_t priority, TaskHandle_t *created_task,
+    BaseType_t core_id)
+{
+    return xTaskCreate(task_code, name, stack_depth, params, priority, created_task);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // The task struct is never freed, a late notify to it stays harmless
+    if(!task || task == task_self()){
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec deadline;
+    deadline_after(&deadline, ticks);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+    delay_us += (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+void vTaskYield(void)
+{
+    sched_yield();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    return (TickType_t)(ms / portTICK_PERIOD_MS);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return task_self();
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return (task ? task : task_self())->priority;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    BaseType_t ret = pdPASS;
+    pthread_mutex_lock(&task->lock);
+    switch(action){
+        case eSetBits:
+            task->notify_value |= value;
+            break;
+        case eIncrement:
+            task->notify_value++;
+            break;
+        case eSetValueWithOverwrite:
+            task->notify_value = value;
+            break;
+        case eSetValueWithoutOverwrite:
+            if(task->notify_pending){
+                ret = pdFAIL;
+            }
+            else{
+                task->notify_value = value;
+            }
+            break;
+        case eNoAction:
+        default:
+            break;
+    }
+    task->notify_pending = true;
+    pthread_cond_broadcast(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+    BaseType_t *higher_priority_task_woken)
+{
+    if(higher_priority_task_woken) *higher_priority_task_woken = pdFALSE;
+    return xTaskNotify(task, value, action);
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit,
+    uint32_t *value, TickType_t ticks)
+{
+    struct host_task *task = task_self();
+    struct timespec deadline;
+    deadline_after(&deadline, ticks);
+    pthread_mutex_lock(&task->lock);
+    if(!task->notify_pending){
+        task->notify_value &= ~clear_on_entry;
+    }
+    while(!task->notify_pending){
+        if(!wait_until(&task->notified, &task->lock, ticks, &deadline)) break;
+    }
+    if(value) *value = task->notify_value;
+    BaseType_t ret = task->notify_pending ? pdTRUE : pdFALSE;
+    if(ret){
+        task->notify_value &= ~clear_on_exit;
+        task->notify_pending = false;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return ret;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    if(higher_priority_task_woken) *higher_priority_task_woken = pdFALSE;
+    xTaskNotify(task, 0, eIncrement);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct host_task *task = task_self();
+    struct timespec deadline;
+    deadline_after(&deadline, ticks);
+    pthread_mutex_lock(&task->lock);
+    while(task->notify_value == 0){
+        if(!wait_until(&task->notified, &task->lock, ticks, &deadline)) break;
+    }
+    uint32_t value = task->notify_value;
+    if(value){
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+// Queues
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    if(length == 0) return NULL;
+    return queue_new(length, item_size, 0);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if(!queue) return;
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_put(queue, item, ticks, queue_back);
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_put(queue, item, ticks, queue_back);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_put(queue, item, ticks, queue_front);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item,
+    BaseType_t *higher_priority_task_woken)
+{
+    if(higher_priority_task_woken) *higher_priority_task_woken = pdFALSE;
+    return queue_put(queue, item, 0, queue_back);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    return queue_put(queue, item, 0, queue_overwrite);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queue_get(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queue_get(queue, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    UBaseType_t spaces = queue->length - queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return spaces;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->count = 0;
+    queue->head = 0;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+    return pdPASS;
+}
+
+// Semaphores
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return queue_new(1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    return queue_new(max_count, 0, initial_count);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return queue_new(1, 0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void)
+{
+    return queue_new(1, 0, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    return queue_get(semaphore, NULL, ticks, true);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return queue_put(semaphore, NULL, 0, queue_back);
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore,
+    BaseType_t *higher_priority_task_woken)
+{
+    if(higher_priority_task_woken) *higher_priority_task_woken = pdFALSE;
+    return queue_put(semaphore, NULL, 0, queue_back);
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+    TaskHandle_t self = task_self();
+    pthread_mutex_lock(&mutex->lock);
+    bool held = (mutex->holder == self);
+    if(held) mutex->depth++;
+    pthread_mutex_unlock(&mutex->lock);
+    if(held) return pdTRUE;
+
+    if(queue_get(mutex, NULL, ticks, true) != pdTRUE) return pdFALSE;
+    pthread_mutex_lock(&mutex->lock);
+    mutex->holder = self;
+    mutex->depth = 1;
+    pthread_mutex_unlock(&mutex->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex)
+{
+    pthread_mutex_lock(&mutex->lock);
+    if(mutex->holder != task_self()){
+        pthread_mutex_unlock(&mutex->lock);
+        return pdFALSE;
+    }
+    bool release = (--mutex->depth == 0);
+    if(release) mutex->holder = NULL;
+    pthread_mutex_unlock(&mutex->lock);
+    if(release) queue_put(mutex, NULL, 0, queue_back);
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    vQueueDelete(semaphore);
+}
+
+int64_t host_task_get_delay_us(void)
+{
+    return delay_us;
+}
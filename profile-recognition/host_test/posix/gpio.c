@@ -0,0 +1,185 @@
+#include <pthread.h>
+#include "driver/gpio.h"
+
+typedef struct {
+    gpio_mode_t mode;
+    gpio_int_type_t intr_type;
+    bool intr_enabled;
+    uint32_t level;
+    gpio_isr_t isr_handler;
+    void *isr_arg;
+} host_gpio_t;
+
+static pthread_mutex_t gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+static host_gpio_t gpios[GPIO_NUM_MAX];
+static bool isr_service_installed;
+static void (*output_hook)(gpio_num_t gpio_num, uint32_t level);
+
+static bool valid_pin(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX;
+}
+
+esp_err_t gpio_config(const gpio_config_t *pGPIOConfig)
+{
+    if(!pGPIOConfig || !pGPIOConfig->pin_bit_mask) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    for(int pin = 0; pin < GPIO_NUM_MAX; pin++){
+        if(!(pGPIOConfig->pin_bit_mask & (1ULL << pin))) continue;
+        gpios[pin].mode = pGPIOConfig->mode;
+        gpios[pin].intr_type = pGPIOConfig->intr_type;
+        gpios[pin].intr_enabled = pGPIOConfig->intr_type != GPIO_INTR_DISABLE;
+        // Inputs idle at their pull
+        if(pGPIOConfig->pull_up_en) gpios[pin].level = 1;
+        if(pGPIOConfig->pull_down_en) gpios[pin].level = 0;
+    }
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num] = (host_gpio_t){ .mode = GPIO_MODE_INPUT, .level = 1 };
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num].mode = mode;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_pull_mode(gpio_num_t gpio_num, gpio_pull_mode_t pull)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    if(pull == GPIO_PULLUP_ONLY) gpios[gpio_num].level = 1;
+    if(pull == GPIO_PULLDOWN_ONLY) gpios[gpio_num].level = 0;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num].level = level ? 1 : 0;
+    void (*hook)(gpio_num_t, uint32_t) = output_hook;
+    pthread_mutex_unlock(&gpio_lock);
+
+    if(hook) hook(gpio_num, level ? 1 : 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if(!valid_pin(gpio_num)) return 0;
+    pthread_mutex_lock(&gpio_lock);
+    int level = gpios[gpio_num].level;
+    pthread_mutex_unlock(&gpio_lock);
+    return level;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio_num, gpio_int_type_t intr_type)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num].intr_type = intr_type;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_enable(gpio_num_t gpio_num)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num].intr_enabled = true;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_intr_disable(gpio_num_t gpio_num)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num].intr_enabled = false;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags)
+{
+    pthread_mutex_lock(&gpio_lock);
+    esp_err_t err = isr_service_installed ? ESP_ERR_INVALID_STATE : ESP_OK;
+    isr_service_installed = true;
+    pthread_mutex_unlock(&gpio_lock);
+    return err;
+}
+
+void gpio_uninstall_isr_service(void)
+{
+    pthread_mutex_lock(&gpio_lock);
+    isr_service_installed = false;
+    pthread_mutex_unlock(&gpio_lock);
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio_num, gpio_isr_t isr_handler, void *args)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num].isr_handler = isr_handler;
+    gpios[gpio_num].isr_arg = args;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio_num)
+{
+    if(!valid_pin(gpio_num)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&gpio_lock);
+    gpios[gpio_num].isr_handler = NULL;
+    gpios[gpio_num].isr_arg = NULL;
+    pthread_mutex_unlock(&gpio_lock);
+    return ESP_OK;
+}
+
+void host_gpio_set_input(gpio_num_t gpio_num, uint32_t level)
+{
+    if(!valid_pin(gpio_num)) return;
+    level = level ? 1 : 0;
+    pthread_mutex_lock(&gpio_lock);
+    host_gpio_t *gpio = &gpios[gpio_num];
+    uint32_t old_level = gpio->level;
+    gpio->level = level;
+
+    bool fire = false;
+    if(gpio->intr_enabled){
+        switch(gpio->intr_type){
+            case GPIO_INTR_POSEDGE: fire = !old_level && level; break;
+            case GPIO_INTR_NEGEDGE: fire = old_level && !level; break;
+            case GPIO_INTR_ANYEDGE: fire = old_level != level; break;
+            case GPIO_INTR_LOW_LEVEL: fire = !level; break;
+            case GPIO_INTR_HIGH_LEVEL: fire = level; break;
+            default: break;
+        }
+    }
+    gpio_isr_t isr_handler = gpio->isr_handler;
+    void *isr_arg = gpio->isr_arg;
+    pthread_mutex_unlock(&gpio_lock);
+
+    // Run the handler on the caller, standing in for interrupt context
+    if(fire && isr_handler) isr_handler(isr_arg);
+}
+
+void host_gpio_set_output_hook(void (*hook)(gpio_num_t gpio_num, uint32_t level))
+{
+    pthread_mutex_lock(&gpio_lock);
+    output_hook = hook;
+    pthread_mutex_unlock(&gpio_lock);
+}
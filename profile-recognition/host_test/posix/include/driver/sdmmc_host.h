@@ -0,0 +1,12 @@
+#ifndef DRIVER_SDMMC_HOST_H_
+#define DRIVER_SDMMC_HOST_H_
+
+/**
+ * \file sdmmc_host.h
+ * \brief Host build: the SDMMC peripheral is not simulated, cards are used
+ * over SPI (see sdspi_host.h)
+ */
+
+#include "sdmmc_cmd.h"
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef DRIVER_SDSPI_HOST_H_
+#define DRIVER_SDSPI_HOST_H_
+
+/**
+ * \file sdspi_host.h
+ * \brief Host build: SD card over SPI, the configuration the mount takes
+ */
+
+#include "driver/gpio.h"
+#include "driver/spi_common.h"
+#include "sdmmc_cmd.h"
+
+#define SDSPI_SLOT_NO_CD -1
+#define SDSPI_SLOT_NO_WP -1
+#define SDSPI_SLOT_NO_INT -1
+
+#define SDSPI_HOST_DEFAULT() { \
+    .flags = SDMMC_HOST_FLAG_SPI, \
+    .slot = HSPI_HOST, \
+    .max_freq_khz = SDMMC_FREQ_DEFAULT, \
+}
+
+typedef int sdspi_dev_handle_t;
+
+typedef struct {
+    spi_host_device_t host_id;
+    int gpio_cs;
+    int gpio_cd;
+    int gpio_wp;
+    int gpio_int;
+} sdspi_device_config_t;
+
+#define SDSPI_DEVICE_CONFIG_DEFAULT() { \
+    .host_id = HSPI_HOST, \
+    .gpio_cs = 13, \
+    .gpio_cd = SDSPI_SLOT_NO_CD, \
+    .gpio_wp = SDSPI_SLOT_NO_WP, \
+    .gpio_int = SDSPI_SLOT_NO_INT, \
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef DRIVER_SPI_COMMON_H_
+#define DRIVER_SPI_COMMON_H_
+
+/**
+ * \file spi_common.h
+ * \brief Host build: SPI bus setup with the ESP-IDF 4.x api
+ */
+
+#include "esp_err.h"
+
+typedef enum {
+    SPI1_HOST = 0,
+    SPI2_HOST = 1,
+    SPI3_HOST = 2,
+    SPI_HOST_MAX,
+} spi_host_device_t;
+
+#define SPI_HOST SPI1_HOST
+#define HSPI_HOST SPI2_HOST
+#define VSPI_HOST SPI3_HOST
+
+/**
+ * \brief Data the ESP32 shifts out MSB first, aligned for a tx_buffer
+ */
+#define SPI_SWAP_DATA_TX(DATA, LEN) __builtin_bswap32((uint32_t)(DATA) << (32 - (LEN)))
+#define SPI_SWAP_DATA_RX(DATA, LEN) (__builtin_bswap32(DATA) >> (32 - (LEN)))
+
+typedef struct {
+    int mosi_io_num;
+    int miso_io_num;
+    int sclk_io_num;
+    int quadwp_io_num;
+    int quadhd_io_num;
+    int max_transfer_sz;
+    uint32_t flags;
+    int intr_flags;
+} spi_bus_config_t;
+
+/**
+ * \retval ESP_ERR_INVALID_STATE if the bus is already initialized
+ */
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+    int dma_chan);
+esp_err_t spi_bus_free(spi_host_device_t host);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef DRIVER_SPI_MASTER_H_
+#define DRIVER_SPI_MASTER_H_
+
+/**
+ * \file spi_master.h
+ * \brief Host build: SPI master driver with the ESP-IDF 4.x api. There is no
+ * device on the bus; a transmit takes as long as its bits need at the
+ * device's clock and reads back zeroes. A queued transaction returns at once
+ * and its result is ready once those bits would be out, after the ones
+ * queued ahead of it
+ */
+
+#include "driver/spi_common.h"
+#include "freertos/FreeRTOS.h"
+
+#define SPI_TRANS_USE_RXDATA (1 << 2)
+#define SPI_TRANS_USE_TXDATA (1 << 3)
+
+typedef struct spi_device_t *spi_device_handle_t;
+
+typedef struct {
+    uint8_t command_bits;
+    uint8_t address_bits;
+    uint8_t dummy_bits;
+    uint8_t mode;
+    uint16_t duty_cycle_pos;
+    uint16_t cs_ena_pretrans;
+    uint8_t cs_ena_posttrans;
+    int clock_speed_hz;
+    int input_delay_ns;
+    int spics_io_num;
+    uint32_t flags;
+    int queue_size;
+    void (*pre_cb)(void *trans);
+    void (*post_cb)(void *trans);
+} spi_device_interface_config_t;
+
+typedef struct spi_transaction_t {
+    uint32_t flags;
+    uint16_t cmd;
+    uint64_t addr;
+    size_t length; //!< total data length, in bits
+    size_t rxlength; //!< in bits, 0 for the same as length
+    void *user;
+    union {
+        const void *tx_buffer;
+        uint8_t tx_data[4];
+    };
+    union {
+        void *rx_buffer;
+        uint8_t rx_data[4];
+    };
+} spi_transaction_t;
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+    spi_device_handle_t *handle);
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle);
+
+/**
+ * \brief Send trans and wait for it to finish
+ */
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc);
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc);
+
+/**
+ * \brief Queue trans and return. It must stay valid until reaped
+ * \retval ESP_ERR_TIMEOUT if queue_size transactions are queued or unreaped
+ */
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc,
+    TickType_t ticks_to_wait);
+
+/**
+ * \brief Reap the oldest queued transaction, waiting for it to finish
+ */
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+    TickType_t ticks_to_wait);
+
+/**
+ * \brief Call hook for every transaction as it goes out, in bus order, so a
+ * test can model the device (a display's DDRAM). NULL for none
+ */
+void host_spi_set_transmit_hook(void (*hook)(spi_device_handle_t handle,
+    const spi_transaction_t *trans_desc));
+
+#endif
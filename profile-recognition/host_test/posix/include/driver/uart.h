@@ -0,0 +1,134 @@
+#ifndef DRIVER_UART_H_
+#define DRIVER_UART_H_
+
+/**
+ * \file uart.h
+ * \brief Host build: UART driver with the ESP-IDF 4.x api. There is no
+ * hardware behind it; whatever is written goes to the peer attached with
+ * host_uart_attach, and bytes the peer sends with host_uart_inject land in
+ * the RX buffer and raise UART_DATA events, as from the RX FIFO on target
+ */
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef int uart_port_t;
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+#define UART_NUM_2 2
+#define UART_NUM_MAX 3
+
+#define UART_PIN_NO_CHANGE (-1)
+#define UART_FIFO_LEN 128
+
+typedef enum {
+    UART_DATA_5_BITS = 0,
+    UART_DATA_6_BITS = 1,
+    UART_DATA_7_BITS = 2,
+    UART_DATA_8_BITS = 3
+} uart_word_length_t;
+
+typedef enum {
+    UART_PARITY_DISABLE = 0,
+    UART_PARITY_EVEN = 2,
+    UART_PARITY_ODD = 3
+} uart_parity_t;
+
+typedef enum {
+    UART_STOP_BITS_1 = 1,
+    UART_STOP_BITS_1_5 = 2,
+    UART_STOP_BITS_2 = 3
+} uart_stop_bits_t;
+
+typedef enum {
+    UART_HW_FLOWCTRL_DISABLE = 0,
+    UART_HW_FLOWCTRL_RTS = 1,
+    UART_HW_FLOWCTRL_CTS = 2,
+    UART_HW_FLOWCTRL_CTS_RTS = 3
+} uart_hw_flowcontrol_t;
+
+typedef struct {
+    int baud_rate;
+    uart_word_length_t data_bits;
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+    uart_hw_flowcontrol_t flow_ctrl;
+    uint8_t rx_flow_ctrl_thresh;
+    bool use_ref_tick;
+} uart_config_t;
+
+typedef enum {
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+    UART_DATA_BREAK,
+    UART_PATTERN_DET,
+    UART_EVENT_MAX
+} uart_event_type_t;
+
+typedef struct {
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config);
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num,
+    int rts_io_num, int cts_io_num);
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size,
+    int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags);
+esp_err_t uart_driver_delete(uart_port_t uart_num);
+bool uart_is_driver_installed(uart_port_t uart_num);
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate);
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t *baudrate);
+int uart_write_bytes(uart_port_t uart_num, const char *src, size_t size);
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait);
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length,
+    TickType_t ticks_to_wait);
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size);
+esp_err_t uart_flush(uart_port_t uart_num);
+esp_err_t uart_flush_input(uart_port_t uart_num);
+
+/// Host side of the wire ///
+
+/**
+ * \brief The other end of a host UART, e.g. a simulated module
+ */
+typedef struct {
+    /**
+     * \brief Bytes the driver wrote. Called on the writing task, outside
+     * the driver's locks
+     * \param baudrate rate they were sent at; a peer at another rate
+     * should treat them as garbage
+     * \param done_us esp_timer_get_time at which the last byte has left
+     * the TX pin, given the bytes already queued ahead of them
+     */
+    void (*receive)(void *ctx, const uint8_t *data, size_t len, uint32_t baudrate,
+        int64_t done_us);
+    void *ctx;
+} host_uart_peer_t;
+
+/**
+ * \brief Attach a peer to uart_num, NULL to detach
+ */
+void host_uart_attach(uart_port_t uart_num, const host_uart_peer_t *peer);
+
+/**
+ * \brief Deliver bytes from the peer to the RX buffer of uart_num
+ * \param baudrate rate the peer sent them at. They are lost if it isn't the
+ * driver's rate, or the driver isn't installed
+ * \retval number of bytes buffered, the rest overflowed
+ */
+int host_uart_inject(uart_port_t uart_num, const uint8_t *data, size_t len,
+    uint32_t baudrate);
+
+/**
+ * \brief Pins last set with uart_set_pin, so a peer can tell if it's wired up
+ */
+void host_uart_get_pins(uart_port_t uart_num, int *tx_io_num, int *rx_io_num);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef ESP32_ROM_CRC_H_
+#define ESP32_ROM_CRC_H_
+
+/**
+ * \file crc.h
+ * \brief Host build: the ROM CRC routines. crc32_le is the zlib CRC32, so
+ * crc32_le(0, buf, len) gives the same value on target and host
+ */
+
+#include <stdint.h>
+
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif
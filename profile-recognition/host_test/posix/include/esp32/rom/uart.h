@@ -0,0 +1,14 @@
+#ifndef ESP32_ROM_UART_H_
+#define ESP32_ROM_UART_H_
+
+/**
+ * \file uart.h
+ * \brief Host build: console input. Tests use it to wait for the person at
+ * the bench, so host test programs provide it and act out that step
+ */
+
+#include <stdint.h>
+
+uint8_t uart_rx_one_char_block(void);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef ESP_ATTR_H_
+#define ESP_ATTR_H_
+
+/**
+ * \file esp_attr.h
+ * \brief Host build: placement attributes have no meaning off target
+ */
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
+#define DMA_ATTR WORD_ALIGNED_ATTR DRAM_ATTR
+
+#endif
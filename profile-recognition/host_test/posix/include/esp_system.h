@@ -0,0 +1,12 @@
+#ifndef ESP_SYSTEM_H_
+#define ESP_SYSTEM_H_
+
+/**
+ * \file esp_system.h
+ * \brief Host build: system api, only what the components use
+ */
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+#endif
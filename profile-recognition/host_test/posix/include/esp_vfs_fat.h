@@ -0,0 +1,26 @@
+#ifndef ESP_VFS_FAT_H_
+#define ESP_VFS_FAT_H_
+
+/**
+ * \file esp_vfs_fat.h
+ * \brief Host build: mounting a card makes base_path a directory of the host
+ * file system, and files under it are ordinary host files. Builds set
+ * MOUNT_POINT to a relative path so runs don't touch the root directory
+ */
+
+#include "esp_err.h"
+#include "driver/sdspi_host.h"
+#include "sdmmc_cmd.h"
+
+typedef struct {
+    bool format_if_mount_failed;
+    int max_files;
+    size_t allocation_unit_size;
+} esp_vfs_fat_sdmmc_mount_config_t;
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base_path, const sdmmc_host_t *host_config,
+    const sdspi_device_config_t *slot_config,
+    const esp_vfs_fat_sdmmc_mount_config_t *mount_config, sdmmc_card_t **out_card);
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base_path, sdmmc_card_t *card);
+
+#endif
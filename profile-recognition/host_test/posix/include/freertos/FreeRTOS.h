@@ -0,0 +1,53 @@
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+
+/**
+ * \file FreeRTOS.h
+ * \brief Host build: FreeRTOS on POSIX threads. Tasks are threads and
+ * priorities are recorded but not enforced, so code must not rely on a
+ * higher priority task pre-empting a lower one
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+// The IDF FreeRTOSConfig.h has it for configASSERT, components rely on that
+#include <assert.h>
+#include "esp_err.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+#define portYIELD_FROM_ISR() do{}while(0)
+
+/**
+ * \brief Critical sections all share one recursive process-wide lock
+ */
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical(mux)
+
+#endif
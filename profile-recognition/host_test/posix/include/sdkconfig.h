@@ -0,0 +1,13 @@
+#ifndef SDKCONFIG_H_
+#define SDKCONFIG_H_
+
+/**
+ * \file sdkconfig.h
+ * \brief Host build: the menuconfig options the components read. Options a
+ * build varies, like CONFIG_EZ_MAX_PROFILES, come from compile definitions
+ */
+
+#define CONFIG_IDF_TARGET_ESP32 1
+#define CONFIG_IDF_TARGET "esp32"
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef SDMMC_CMD_H_
+#define SDMMC_CMD_H_
+
+/**
+ * \file sdmmc_cmd.h
+ * \brief Host build: SD card types. The card is a directory on the host
+ * (see esp_vfs_fat.h)
+ */
+
+#include <stdio.h>
+#include "esp_err.h"
+
+#define SDMMC_HOST_FLAG_SPI (1 << 3)
+#define SDMMC_FREQ_DEFAULT 20000
+
+typedef struct {
+    uint32_t flags;
+    int slot;
+    int max_freq_khz;
+} sdmmc_host_t;
+
+typedef struct {
+    sdmmc_host_t host;
+    char name[8];
+    uint32_t capacity; //!< in sectors
+    uint32_t sector_size;
+} sdmmc_card_t;
+
+void sdmmc_card_print_info(FILE *stream, const sdmmc_card_t *card);
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef UNITY_H_
+#define UNITY_H_
+
+/**
+ * \file unity.h
+ * \brief Host build: the part of Unity and the ESP-IDF unit test app that
+ * the component tests use. TEST_CASEs register themselves at startup and
+ * unity_run runs them; a failed assertion ends the test case and the next
+ * one runs, as on target
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef struct unity_test_case {
+    const char *name;
+    const char *desc; //!< tags, e.g. "[system][userInput]"
+    const char *file;
+    int line;
+    void (*fn)(void);
+    struct unity_test_case *next;
+} unity_test_case_t;
+
+void unity_register(unity_test_case_t *test_case);
+
+/**
+ * \brief Run the registered test cases in file and line order
+ * \param argc/argv from main. No arguments runs every test case; otherwise
+ * each argument selects by name, "[tag]" by tag, and "![tag]" excludes a tag
+ * \retval number of failed test cases
+ */
+int unity_run(int argc, char **argv);
+
+// setUp and tearDown are optional, run around every test case
+void setUp(void);
+void tearDown(void);
+
+void unity_fail(const char *file, int line, const char *format, ...)
+    __attribute__((format(printf, 3, 4), noreturn));
+
+#define UNITY_CAT_(a, b) a##b
+#define UNITY_CAT(a, b) UNITY_CAT_(a, b)
+
+#define TEST_CASE(name_, desc_) \
+    static void UNITY_CAT(unity_test_fn_, __LINE__)(void); \
+    static unity_test_case_t UNITY_CAT(unity_test_case_, __LINE__) = { \
+        .name = name_, .desc = desc_, .file = __FILE__, .line = __LINE__, \
+        .fn = UNITY_CAT(unity_test_fn_, __LINE__) \
+    }; \
+    __attribute__((constructor)) static void UNITY_CAT(unity_test_reg_, __LINE__)(void) \
+    { \
+        unity_register(&UNITY_CAT(unity_test_case_, __LINE__)); \
+    } \
+    static void UNITY_CAT(unity_test_fn_, __LINE__)(void)
+
+#define UNITY_ASSERT_CMP(expected, actual, op, what) do{ \
+    long long unity_e_ = (long long)(expected); \
+    long long unity_a_ = (long long)(actual); \
+    if(!(unity_a_ op unity_e_)){ \
+        unity_fail(__FILE__, __LINE__, "Expected " what " %lld Was %lld", \
+            unity_e_, unity_a_); \
+    } \
+}while(0)
+
+#define TEST_FAIL_MESSAGE(message) unity_fail(__FILE__, __LINE__, "%s", message)
+#define TEST_FAIL() unity_fail(__FILE__, __LINE__, "Failed")
+
+#define TEST_ASSERT(condition) do{ \
+    if(!(condition)){ \
+        unity_fail(__FILE__, __LINE__, "Expression Evaluated To FALSE: %s", #condition); \
+    } \
+}while(0)
+#define TEST_ASSERT_TRUE(condition) TEST_ASSERT(condition)
+#define TEST_ASSERT_FALSE(condition) TEST_ASSERT(!(condition))
+#define TEST_ASSERT_NULL(pointer) TEST_ASSERT((pointer) == NULL)
+#define TEST_ASSERT_NOT_NULL(pointer) TEST_ASSERT((pointer) != NULL)
+
+#define TEST_ASSERT_EQUAL(expected, actual) UNITY_ASSERT_CMP(expected, actual, ==, "")
+#define TEST_ASSERT_EQUAL_INT(expected, actual) TEST_ASSERT_EQUAL(expected, actual)
+#define TEST_ASSERT_EQUAL_UINT(expected, actual) TEST_ASSERT_EQUAL(expected, actual)
+#define TEST_ASSERT_EQUAL_UINT8(expected, actual) \
+    TEST_ASSERT_EQUAL((uint8_t)(expected), (uint8_t)(actual))
+#define TEST_ASSERT_EQUAL_UINT16(expected, actual) \
+    TEST_ASSERT_EQUAL((uint16_t)(expected), (uint16_t)(actual))
+#define TEST_ASSERT_EQUAL_UINT32(expected, actual) \
+    TEST_ASSERT_EQUAL((uint32_t)(expected), (uint32_t)(actual))
+#define TEST_ASSERT_EQUAL_HEX8(expected, actual) TEST_ASSERT_EQUAL_UINT8(expected, actual)
+#define TEST_ASSERT_EQUAL_HEX16(expected, actual) TEST_ASSERT_EQUAL_UINT16(expected, actual)
+#define TEST_ASSERT_EQUAL_HEX32(expected, actual) TEST_ASSERT_EQUAL_UINT32(expected, actual)
+#define TEST_ASSERT_NOT_EQUAL(expected, actual) UNITY_ASSERT_CMP(expected, actual, !=, "not")
+#define TEST_ASSERT_EQUAL_PTR(expected, actual) \
+    TEST_ASSERT_EQUAL((intptr_t)(expected), (intptr_t)(actual))
+#define TEST_ASSERT_LESS_THAN(threshold, actual) \
+    UNITY_ASSERT_CMP(threshold, actual, <, "less than")
+#define TEST_ASSERT_GREATER_THAN(threshold, actual) \
+    UNITY_ASSERT_CMP(threshold, actual, >, "greater than")
+#define TEST_ASSERT_LESS_OR_EQUAL(threshold, actual) \
+    UNITY_ASSERT_CMP(threshold, actual, <=, "at most")
+#define TEST_ASSERT_GREATER_OR_EQUAL(threshold, actual) \
+    UNITY_ASSERT_CMP(threshold, actual, >=, "at least")
+
+void unity_assert_equal_memory(const void *expected, const void *actual, size_t len,
+    const char *file, int line);
+#define TEST_ASSERT_EQUAL_MEMORY(expected, actual, len) \
+    unity_assert_equal_memory(expected, actual, len, __FILE__, __LINE__)
+#define TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, actual, num_elements) \
+    TEST_ASSERT_EQUAL_MEMORY(expected, actual, num_elements)
+#define TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, actual, num_elements) \
+    TEST_ASSERT_EQUAL_MEMORY(expected, actual, num_elements)
+
+void unity_assert_equal_string(const char *expected, const char *actual,
+    const char *file, int line);
+#define TEST_ASSERT_EQUAL_STRING(expected, actual) \
+    unity_assert_equal_string(expected, actual, __FILE__, __LINE__)
+
+// ESP-IDF additions
+#define TEST_ESP_ERR(expected, actual) do{ \
+    esp_err_t unity_e_ = (expected); \
+    esp_err_t unity_a_ = (actual); \
+    if(unity_e_ != unity_a_){ \
+        unity_fail(__FILE__, __LINE__, "Expected %s Was %s", \
+            esp_err_to_name(unity_e_), esp_err_to_name(unity_a_)); \
+    } \
+}while(0)
+#define TEST_ESP_OK(rc) TEST_ESP_ERR(ESP_OK, rc)
+
+#endif
@@ -0,0 +1,221 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "driver/spi_master.h"
+
+// Most transactions a device can have queued or waiting to be reaped
+#define SPI_QUEUE_MAX 16
+
+struct spi_device_t {
+    spi_host_device_t host;
+    int clock_speed_hz;
+    int spics_io_num;
+    int queue_size;
+    // queued transactions, oldest first, and when each is off the wire
+    spi_transaction_t *queued[SPI_QUEUE_MAX];
+    int64_t done_ns[SPI_QUEUE_MAX];
+    int queue_head;
+    int queue_count;
+};
+
+static pthread_mutex_t spi_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool bus_initialized[SPI_HOST_MAX];
+// Transactions on a bus go out one at a time
+static pthread_mutex_t bus_lock[SPI_HOST_MAX] = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER
+};
+// When the last queued transaction on each bus is off the wire
+static int64_t bus_busy_until[SPI_HOST_MAX];
+static void (*transmit_hook)(spi_device_handle_t handle, const spi_transaction_t *trans_desc);
+
+static bool valid_host(spi_host_device_t host)
+{
+    return host >= SPI1_HOST && host < SPI_HOST_MAX;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sleep_ns(int64_t ns)
+{
+    if(ns <= 0) return;
+    struct timespec ts = {
+        .tv_sec = ns / 1000000000,
+        .tv_nsec = ns % 1000000000
+    };
+    while(nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+static esp_err_t check_trans(spi_transaction_t *trans_desc)
+{
+    if(!trans_desc) return ESP_ERR_INVALID_ARG;
+    if(!(trans_desc->flags & SPI_TRANS_USE_TXDATA) && trans_desc->length &&
+        !trans_desc->tx_buffer)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Nothing answers, whatever is read is zero
+    size_t rxlength = trans_desc->rxlength ? trans_desc->rxlength : trans_desc->length;
+    if(trans_desc->flags & SPI_TRANS_USE_RXDATA){
+        memset(trans_desc->rx_data, 0, sizeof(trans_desc->rx_data));
+    }
+    else if(trans_desc->rx_buffer){
+        memset(trans_desc->rx_buffer, 0, (rxlength + 7) / 8);
+    }
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *bus_config,
+    int dma_chan)
+{
+    if(!valid_host(host) || !bus_config || dma_chan < 0 || dma_chan > 2){
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&spi_lock);
+    esp_err_t err = bus_initialized[host] ? ESP_ERR_INVALID_STATE : ESP_OK;
+    bus_initialized[host] = true;
+    pthread_mutex_unlock(&spi_lock);
+    return err;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host)
+{
+    if(!valid_host(host)) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&spi_lock);
+    esp_err_t err = bus_initialized[host] ? ESP_OK : ESP_ERR_INVALID_STATE;
+    bus_initialized[host] = false;
+    pthread_mutex_unlock(&spi_lock);
+    return err;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *dev_config,
+    spi_device_handle_t *handle)
+{
+    if(!valid_host(host) || !dev_config || !handle || dev_config->clock_speed_hz <= 0){
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&spi_lock);
+    bool initialized = bus_initialized[host];
+    pthread_mutex_unlock(&spi_lock);
+    if(!initialized) return ESP_ERR_INVALID_STATE;
+
+    struct spi_device_t *device = calloc(1, sizeof(struct spi_device_t));
+    if(!device) return ESP_ERR_NO_MEM;
+    device->host = host;
+    device->clock_speed_hz = dev_config->clock_speed_hz;
+    device->spics_io_num = dev_config->spics_io_num;
+    device->queue_size = dev_config->queue_size < SPI_QUEUE_MAX ?
+        dev_config->queue_size : SPI_QUEUE_MAX;
+    *handle = device;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    if(!handle) return ESP_ERR_INVALID_ARG;
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_polling_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc)
+{
+    if(!handle) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = check_trans(trans_desc);
+    if(err != ESP_OK) return err;
+
+    // Hold the bus for as long as the bits take at the device's clock
+    int64_t wire_ns = (int64_t)trans_desc->length * 1000000000 / handle->clock_speed_hz;
+    pthread_mutex_lock(&spi_lock);
+    void (*hook)(spi_device_handle_t, const spi_transaction_t *) = transmit_hook;
+    bool pending = handle->queue_count > 0;
+    pthread_mutex_unlock(&spi_lock);
+    // As on target, not while queued transactions are outstanding
+    if(pending) return ESP_ERR_INVALID_STATE;
+    pthread_mutex_lock(&bus_lock[handle->host]);
+    if(hook) hook(handle, trans_desc);
+    sleep_ns(wire_ns);
+    pthread_mutex_unlock(&bus_lock[handle->host]);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc,
+    TickType_t ticks_to_wait)
+{
+    if(!handle) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = check_trans(trans_desc);
+    if(err != ESP_OK) return err;
+
+    // The bits go out after whatever is queued ahead on the bus; the caller
+    // doesn't wait for them
+    int64_t wire_ns = (int64_t)trans_desc->length * 1000000000 / handle->clock_speed_hz;
+    pthread_mutex_lock(&bus_lock[handle->host]);
+    pthread_mutex_lock(&spi_lock);
+    if(handle->queue_count == handle->queue_size){
+        // Nothing frees a slot but the owner reaping, which isn't waiting here
+        pthread_mutex_unlock(&spi_lock);
+        pthread_mutex_unlock(&bus_lock[handle->host]);
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t start = now_ns();
+    if(bus_busy_until[handle->host] > start) start = bus_busy_until[handle->host];
+    bus_busy_until[handle->host] = start + wire_ns;
+    int slot = (handle->queue_head + handle->queue_count) % SPI_QUEUE_MAX;
+    handle->queued[slot] = trans_desc;
+    handle->done_ns[slot] = start + wire_ns;
+    handle->queue_count++;
+    void (*hook)(spi_device_handle_t, const spi_transaction_t *) = transmit_hook;
+    pthread_mutex_unlock(&spi_lock);
+    if(hook) hook(handle, trans_desc);
+    pthread_mutex_unlock(&bus_lock[handle->host]);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc,
+    TickType_t ticks_to_wait)
+{
+    if(!handle || !trans_desc) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&spi_lock);
+    if(handle->queue_count == 0){
+        pthread_mutex_unlock(&spi_lock);
+        // Nothing queued can finish: wait out the timeout as the target would
+        if(ticks_to_wait != portMAX_DELAY){
+            sleep_ns((int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000000);
+        }
+        return ESP_ERR_TIMEOUT;
+    }
+    int64_t wait_ns = handle->done_ns[handle->queue_head] - now_ns();
+    if(ticks_to_wait != portMAX_DELAY &&
+        wait_ns > (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000000)
+    {
+        pthread_mutex_unlock(&spi_lock);
+        sleep_ns((int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000000);
+        return ESP_ERR_TIMEOUT;
+    }
+    *trans_desc = handle->queued[handle->queue_head];
+    handle->queue_head = (handle->queue_head + 1) % SPI_QUEUE_MAX;
+    handle->queue_count--;
+    pthread_mutex_unlock(&spi_lock);
+
+    sleep_ns(wait_ns);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc)
+{
+    return spi_device_polling_transmit(handle, trans_desc);
+}
+
+void host_spi_set_transmit_hook(void (*hook)(spi_device_handle_t handle,
+    const spi_transaction_t *trans_desc))
+{
+    pthread_mutex_lock(&spi_lock);
+    transmit_hook = hook;
+    pthread_mutex_unlock(&spi_lock);
+}
@@ -0,0 +1,327 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "driver/uart.h"
+#include "esp_timer.h"
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t readable;
+
+    bool installed;
+    uint32_t baudrate;
+    int tx_io_num;
+    int rx_io_num;
+    QueueHandle_t events;
+
+    uint8_t *rx;
+    size_t rx_size;
+    size_t rx_head;
+    size_t rx_len;
+
+    int64_t tx_done_us; //!< when the last byte written leaves the TX pin
+    host_uart_peer_t peer;
+} host_uart_t;
+
+static host_uart_t uarts[UART_NUM_MAX];
+
+// Private functions
+
+static host_uart_t *get_uart(uart_port_t uart_num)
+{
+    if(uart_num < 0 || uart_num >= UART_NUM_MAX) return NULL;
+    return &uarts[uart_num];
+}
+
+__attribute__((constructor)) static void uart_init_locks(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    for(int i = 0; i < UART_NUM_MAX; i++){
+        pthread_mutex_init(&uarts[i].lock, NULL);
+        pthread_cond_init(&uarts[i].readable, &attr);
+        uarts[i].baudrate = 115200;
+        uarts[i].tx_io_num = UART_PIN_NO_CHANGE;
+        uarts[i].rx_io_num = UART_PIN_NO_CHANGE;
+    }
+    pthread_condattr_destroy(&attr);
+}
+
+static void post_event(host_uart_t *uart, uart_event_type_t type, size_t size)
+{
+    // Like the driver ISR, an event that doesn't fit in the queue is lost
+    if(!uart->events) return;
+    uart_event_t event = {
+        .type = type,
+        .size = size,
+        .timeout_flag = false
+    };
+    xQueueSend(uart->events, &event, 0);
+}
+
+static void sleep_until_us(int64_t when_us)
+{
+    int64_t wait_us = when_us - esp_timer_get_time();
+    if(wait_us <= 0) return;
+    struct timespec ts = {
+        .tv_sec = wait_us / 1000000,
+        .tv_nsec = (wait_us % 1000000) * 1000
+    };
+    while(nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+// Public functions
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart || !uart_config || uart_config->baud_rate <= 0) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    uart->baudrate = uart_config->baud_rate;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num,
+    int rts_io_num, int cts_io_num)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    if(tx_io_num != UART_PIN_NO_CHANGE) uart->tx_io_num = tx_io_num;
+    if(rx_io_num != UART_PIN_NO_CHANGE) uart->rx_io_num = rx_io_num;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size,
+    int queue_size, QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart || rx_buffer_size <= UART_FIFO_LEN) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    if(uart->installed){
+        pthread_mutex_unlock(&uart->lock);
+        return ESP_FAIL;
+    }
+    uart->rx = malloc(rx_buffer_size);
+    if(!uart->rx){
+        pthread_mutex_unlock(&uart->lock);
+        return ESP_ERR_NO_MEM;
+    }
+    uart->rx_size = rx_buffer_size;
+    uart->rx_head = 0;
+    uart->rx_len = 0;
+    uart->events = NULL;
+    if(queue_size > 0 && uart_queue){
+        uart->events = xQueueCreate(queue_size, sizeof(uart_event_t));
+        *uart_queue = uart->events;
+    }
+    uart->tx_done_us = 0;
+    uart->installed = true;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    if(uart->installed){
+        free(uart->rx);
+        uart->rx = NULL;
+        vQueueDelete(uart->events);
+        uart->events = NULL;
+        uart->installed = false;
+    }
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+bool uart_is_driver_installed(uart_port_t uart_num)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    return uart && uart->installed;
+}
+
+esp_err_t uart_set_baudrate(uart_port_t uart_num, uint32_t baudrate)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart || baudrate == 0) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    uart->baudrate = baudrate;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t *baudrate)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart || !baudrate) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    *baudrate = uart->baudrate;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const char *src, size_t size)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart || !src) return -1;
+    pthread_mutex_lock(&uart->lock);
+    if(!uart->installed){
+        pthread_mutex_unlock(&uart->lock);
+        return -1;
+    }
+    // 10 bits a byte on the wire, after whatever is still going out
+    int64_t now = esp_timer_get_time();
+    int64_t start = uart->tx_done_us > now ? uart->tx_done_us : now;
+    uart->tx_done_us = start + (int64_t)size * 10 * 1000000 / uart->baudrate;
+    int64_t done_us = uart->tx_done_us;
+    uint32_t baudrate = uart->baudrate;
+    host_uart_peer_t peer = uart->peer;
+    pthread_mutex_unlock(&uart->lock);
+
+    if(peer.receive){
+        peer.receive(peer.ctx, (const uint8_t *)src, size, baudrate, done_us);
+    }
+    return size;
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t ticks_to_wait)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    int64_t done_us = uart->tx_done_us;
+    pthread_mutex_unlock(&uart->lock);
+
+    int64_t now = esp_timer_get_time();
+    if(ticks_to_wait != portMAX_DELAY &&
+        done_us - now > (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000)
+    {
+        sleep_until_us(now + (int64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000);
+        return ESP_ERR_TIMEOUT;
+    }
+    sleep_until_us(done_us);
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length,
+    TickType_t ticks_to_wait)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart || !buf) return -1;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if(ticks_to_wait != portMAX_DELAY){
+        uint64_t ns = (uint64_t)ticks_to_wait * portTICK_PERIOD_MS * 1000000 + deadline.tv_nsec;
+        deadline.tv_sec += ns / 1000000000;
+        deadline.tv_nsec = ns % 1000000000;
+    }
+
+    pthread_mutex_lock(&uart->lock);
+    if(!uart->installed){
+        pthread_mutex_unlock(&uart->lock);
+        return -1;
+    }
+    // Like the driver, wait for all of length unless the time runs out
+    while(uart->rx_len < length && ticks_to_wait != 0){
+        int rc = 0;
+        if(ticks_to_wait == portMAX_DELAY){
+            pthread_cond_wait(&uart->readable, &uart->lock);
+        }
+        else{
+            rc = pthread_cond_timedwait(&uart->readable, &uart->lock, &deadline);
+        }
+        if(!uart->installed || rc == ETIMEDOUT) break;
+    }
+    size_t n = uart->rx_len < length ? uart->rx_len : length;
+    for(size_t i = 0; i < n; i++){
+        ((uint8_t *)buf)[i] = uart->rx[(uart->rx_head + i) % uart->rx_size];
+    }
+    uart->rx_head = (uart->rx_head + n) % uart->rx_size;
+    uart->rx_len -= n;
+    pthread_mutex_unlock(&uart->lock);
+    return n;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart || !size) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    *size = uart->rx_len;
+    pthread_mutex_unlock(&uart->lock);
+    return uart->installed ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t uart_flush(uart_port_t uart_num)
+{
+    return uart_flush_input(uart_num);
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&uart->lock);
+    uart->rx_head = 0;
+    uart->rx_len = 0;
+    pthread_mutex_unlock(&uart->lock);
+    return ESP_OK;
+}
+
+void host_uart_attach(uart_port_t uart_num, const host_uart_peer_t *peer)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart) return;
+    pthread_mutex_lock(&uart->lock);
+    if(peer){
+        uart->peer = *peer;
+    }
+    else{
+        memset(&uart->peer, 0, sizeof(uart->peer));
+    }
+    pthread_mutex_unlock(&uart->lock);
+}
+
+int host_uart_inject(uart_port_t uart_num, const uint8_t *data, size_t len,
+    uint32_t baudrate)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart) return 0;
+    pthread_mutex_lock(&uart->lock);
+    if(!uart->installed || baudrate != uart->baudrate){
+        // Not listening, or framing errors at the wrong rate
+        pthread_mutex_unlock(&uart->lock);
+        return 0;
+    }
+    size_t space = uart->rx_size - uart->rx_len;
+    size_t n = len < space ? len : space;
+    for(size_t i = 0; i < n; i++){
+        uart->rx[(uart->rx_head + uart->rx_len + i) % uart->rx_size] = data[i];
+    }
+    uart->rx_len += n;
+    if(n > 0) post_event(uart, UART_DATA, n);
+    if(n < len) post_event(uart, UART_BUFFER_FULL, 0);
+    pthread_cond_broadcast(&uart->readable);
+    pthread_mutex_unlock(&uart->lock);
+    return n;
+}
+
+void host_uart_get_pins(uart_port_t uart_num, int *tx_io_num, int *rx_io_num)
+{
+    host_uart_t *uart = get_uart(uart_num);
+    if(!uart) return;
+    pthread_mutex_lock(&uart->lock);
+    if(tx_io_num) *tx_io_num = uart->tx_io_num;
+    if(rx_io_num) *rx_io_num = uart->rx_io_num;
+    pthread_mutex_unlock(&uart->lock);
+}
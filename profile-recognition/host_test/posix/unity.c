@@ -0,0 +1,144 @@
+#include <pthread.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "unity.h"
+#include "esp_timer.h"
+
+static unity_test_case_t *test_cases;
+static jmp_buf test_abort;
+static pthread_t runner;
+static bool running;
+
+__attribute__((weak)) void setUp(void)
+{
+}
+
+__attribute__((weak)) void tearDown(void)
+{
+}
+
+void unity_register(unity_test_case_t *test_case)
+{
+    // Keep file then line order, whatever order the constructors ran in
+    unity_test_case_t **itr = &test_cases;
+    while(*itr && (strcmp((*itr)->file, test_case->file) < 0 ||
+        (strcmp((*itr)->file, test_case->file) == 0 && (*itr)->line < test_case->line)))
+    {
+        itr = &(*itr)->next;
+    }
+    test_case->next = *itr;
+    *itr = test_case;
+}
+
+void unity_fail(const char *file, int line, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    printf("%s:%d:FAIL: ", file, line);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+    fflush(stdout);
+
+    // Only the runner thread can unwind to the test case boundary
+    if(!running || !pthread_equal(pthread_self(), runner)){
+        printf("assertion failed outside the test runner, aborting\n");
+        abort();
+    }
+    longjmp(test_abort, 1);
+}
+
+void unity_assert_equal_memory(const void *expected, const void *actual, size_t len,
+    const char *file, int line)
+{
+    if(!expected || !actual){
+        if(expected != actual) unity_fail(file, line, "Expected or actual is NULL");
+        return;
+    }
+    const uint8_t *e = expected;
+    const uint8_t *a = actual;
+    for(size_t i = 0; i < len; i++){
+        if(e[i] != a[i]){
+            unity_fail(file, line, "Memory mismatch at byte %zu, expected 0x%02X was 0x%02X",
+                i, e[i], a[i]);
+        }
+    }
+}
+
+void unity_assert_equal_string(const char *expected, const char *actual,
+    const char *file, int line)
+{
+    if(!expected || !actual || strcmp(expected, actual) != 0){
+        unity_fail(file, line, "Expected \"%s\" Was \"%s\"", expected ? expected : "(null)",
+            actual ? actual : "(null)");
+    }
+}
+
+static bool has_tag(const unity_test_case_t *test_case, const char *tag)
+{
+    return strstr(test_case->desc, tag) != NULL;
+}
+
+static bool selected(const unity_test_case_t *test_case, int argc, char **argv)
+{
+    bool any_include = false;
+    bool included = false;
+    for(int i = 1; i < argc; i++){
+        if(argv[i][0] == '!'){
+            if(has_tag(test_case, argv[i] + 1)) return false;
+            continue;
+        }
+        any_include = true;
+        if(argv[i][0] == '['){
+            if(has_tag(test_case, argv[i])) included = true;
+        }
+        else if(strcmp(test_case->name, argv[i]) == 0){
+            included = true;
+        }
+    }
+    return !any_include || included;
+}
+
+int unity_run(int argc, char **argv)
+{
+    int tests = 0;
+    int failures = 0;
+    runner = pthread_self();
+
+    for(unity_test_case_t *test_case = test_cases; test_case; test_case = test_case->next){
+        if(!selected(test_case, argc, argv)) continue;
+        tests++;
+        printf("Running %s...\n", test_case->name);
+        fflush(stdout);
+        int64_t start_us = esp_timer_get_time();
+
+        // volatile, it is read again after a longjmp
+        volatile bool failed = false;
+        running = true;
+        if(setjmp(test_abort) == 0){
+            setUp();
+            test_case->fn();
+        }
+        else{
+            failed = true;
+        }
+        if(setjmp(test_abort) == 0){
+            tearDown();
+        }
+        else{
+            failed = true;
+        }
+        running = false;
+
+        failures += failed;
+        printf("%s:%d:%s:%s (%lld ms)\n", test_case->file, test_case->line, test_case->name,
+            failed ? "FAIL" : "PASS", (long long)(esp_timer_get_time() - start_us) / 1000);
+    }
+
+    printf("-----------------------\n");
+    printf("%d Tests %d Failures 0 Ignored\n", tests, failures);
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures;
+}
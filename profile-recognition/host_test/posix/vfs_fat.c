@@ -0,0 +1,41 @@
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "esp_vfs_fat.h"
+#include "esp_log.h"
+
+static const char *TAG = "vfs_fat";
+static sdmmc_card_t host_card;
+
+esp_err_t esp_vfs_fat_sdspi_mount(const char *base_path, const sdmmc_host_t *host_config,
+    const sdspi_device_config_t *slot_config,
+    const esp_vfs_fat_sdmmc_mount_config_t *mount_config, sdmmc_card_t **out_card)
+{
+    if(!base_path || !host_config || !slot_config || !mount_config) return ESP_ERR_INVALID_ARG;
+
+    // The card is a directory, an empty card is a new one
+    if(mkdir(base_path, 0755) != 0 && errno != EEXIST){
+        ESP_LOGE(TAG, "Failed to create %s: %s", base_path, strerror(errno));
+        return ESP_FAIL;
+    }
+    host_card = (sdmmc_card_t){
+        .host = *host_config,
+        .name = "HOST",
+        .capacity = 0,
+        .sector_size = 512
+    };
+    if(out_card) *out_card = &host_card;
+    return ESP_OK;
+}
+
+esp_err_t esp_vfs_fat_sdcard_unmount(const char *base_path, sdmmc_card_t *card)
+{
+    return card == &host_card ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+void sdmmc_card_print_info(FILE *stream, const sdmmc_card_t *card)
+{
+    fprintf(stream, "Name: %s\n", card->name);
+    fprintf(stream, "Type: host directory\n");
+    fprintf(stream, "Speed: %d kHz (not simulated)\n", card->host.max_freq_khz);
+}
@@ -0,0 +1,42 @@
+/**
+ * \brief Runs the R502 component tests against the simulated module
+ *
+ * Arguments select tests like the IDF test menu: a test name or a "[tag]",
+ * and "![tag]" to leave tests out
+ */
+#include "unity.h"
+#include "esp32/rom/uart.h"
+#include "R502Interface.h"
+#include "fake_r502.h"
+
+// Finger the simulated user puts down when a test asks for one
+#define HOST_FINGER_ID 1
+
+void IRAM_ATTR gpio_isr_handler(void *arg)
+{
+    // The application's handler is in main.c, nothing to do for the tests
+}
+
+void setUp(void)
+{
+    fake_r502_reset();
+}
+
+uint8_t uart_rx_one_char_block(void)
+{
+    // "Place finger on sensor, then press enter"
+    fake_r502_place_finger(HOST_FINGER_ID);
+    return '\n';
+}
+
+int main(int argc, char **argv)
+{
+    fake_r502_config_t config;
+    fake_r502_default_config(&config);
+    ESP_ERROR_CHECK(fake_r502_start(&config));
+
+    int failures = unity_run(argc, argv);
+
+    fake_r502_stop();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,306 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "CFAL1602.h"
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return 1; \
+    } \
+}while(0)
+
+#define TICK_MS 20
+
+CFAL1602Interface CFAL1602 = {
+    .TAG = "CFAL1602C-PB",
+    .initialized = false,
+    .line_len = 16,
+    .line_count = 2,
+    .timer_period = TICK_MS * 1000
+};
+
+// The panel: DDRAM and its address counter, built from what goes out on SPI
+static pthread_mutex_t panel_lock = PTHREAD_MUTEX_INITIALIZER;
+static char ddram[2][16];
+static int address;
+static int commands;
+static int writes;
+static int transactions;
+
+// Private functions
+
+static void panel_hook(spi_device_handle_t handle, const spi_transaction_t *trans)
+{
+    // 10-bit words back to back, MSB first: RS, RW, then the byte
+    const uint8_t *tx = trans->tx_buffer;
+
+    pthread_mutex_lock(&panel_lock);
+    transactions++;
+    for(size_t bit = 0; bit + 10 <= trans->length; bit += 10){
+        uint16_t word = 0;
+        for(size_t i = bit; i < bit + 10; i++){
+            word = (word << 1) | ((tx[i / 8] >> (7 - i % 8)) & 1);
+        }
+        if(word & WS2_data_write){
+            int line = (address >> 6) & 1;
+            int cell = address & 0x3f;
+            if(cell < 16) ddram[line][cell] = (char)(word & 0xff);
+            address++;
+            writes++;
+        }
+        else{
+            if(word & WS2_setDDRAM) address = word & 0x7f;
+            if(word == WS2_clear || word == WS2_home) address = 0;
+            if(word == WS2_clear) memset(ddram, ' ', sizeof(ddram));
+            commands++;
+        }
+    }
+    pthread_mutex_unlock(&panel_lock);
+}
+
+// Let the event loop catch up, then take the traffic since the last look
+static int settle(int *cmd_count, int *write_count)
+{
+    vTaskDelay(3 * TICK_MS / portTICK_PERIOD_MS);
+    pthread_mutex_lock(&panel_lock);
+    int trans_count = transactions;
+    *cmd_count = commands;
+    *write_count = writes;
+    transactions = 0;
+    commands = 0;
+    writes = 0;
+    pthread_mutex_unlock(&panel_lock);
+    return trans_count;
+}
+
+static bool shows(int line, const char *text)
+{
+    char expected[16];
+    memset(expected, ' ', sizeof(expected));
+    memcpy(expected, text, strlen(text));
+    pthread_mutex_lock(&panel_lock);
+    bool same = memcmp(ddram[line], expected, sizeof(expected)) == 0;
+    pthread_mutex_unlock(&panel_lock);
+    return same;
+}
+
+static int test_changes_only(void)
+{
+    int cmds, data;
+
+    // First print: one run, the spaces clear left are not sent again, in
+    // one transaction
+    WS2_msg_print(&CFAL1602, "Hello", 0, false);
+    CHECK(settle(&cmds, &data) == 1);
+    CHECK(shows(0, "Hello"));
+    CHECK(cmds == 1 && data == 5);
+
+    // Nothing changed: the timer ticks send nothing
+    vTaskDelay(10 * TICK_MS / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(cmds == 0 && data == 0);
+
+    // Cells 3 and 4 change: one run
+    WS2_msg_print(&CFAL1602, "Help", 0, false);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Help"));
+    CHECK(cmds == 1 && data == 2);
+
+    // Cells 1, 3 and 4 change: an address per run, still one transaction
+    WS2_msg_print(&CFAL1602, "HxlYo", 0, false);
+    CHECK(settle(&cmds, &data) == 1);
+    CHECK(shows(0, "HxlYo"));
+    CHECK(cmds == 2 && data == 3);
+
+    // The other line is its own frame
+    WS2_msg_print(&CFAL1602, "HxlYo", 1, false);
+    settle(&cmds, &data);
+    CHECK(shows(0, "HxlYo") && shows(1, "HxlYo"));
+    CHECK(cmds == 1 && data == 5);
+
+    WS2_msg_clear(&CFAL1602, 0);
+    WS2_msg_clear(&CFAL1602, 1);
+    CHECK(settle(&cmds, &data) == 2);
+    CHECK(shows(0, "") && shows(1, ""));
+    CHECK(cmds == 2 && data == 10);
+    return 0;
+}
+
+static int test_queued(void)
+{
+    static const char *lines[2][2] = {
+        {"0123456789abcdef", "fedcba9876543210"},
+        {"ABCDEFGHIJKLMNOP", "PONMLKJIHGFEDCBA"}
+    };
+    int cmds, data;
+
+    // Whole lines at 100 kHz take 1.7 ms each on the wire. The event loop
+    // queues them without waiting, past the queue's depth, and they land in
+    // order
+    for(int i = 0; i < 2 * WS2_SPI_QUEUE_SIZE; i++){
+        WS2_msg_print(&CFAL1602, lines[0][i % 2], 0, false);
+        WS2_msg_print(&CFAL1602, lines[1][i % 2], 1, false);
+    }
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(shows(0, lines[0][1]) && shows(1, lines[1][1]));
+    return 0;
+}
+
+static int test_dwell(void)
+{
+    int cmds, data;
+
+    // The print behind a dwell waits for it, the one after a flush doesn't
+    WS2_msg_print(&CFAL1602, "first", 0, false);
+    WS2_msg_dwell(&CFAL1602, 200);
+    WS2_msg_print(&CFAL1602, "second", 0, false);
+    settle(&cmds, &data);
+    CHECK(shows(0, "first"));
+    CHECK(strcmp(WS2_get_string(&CFAL1602, 0), "second") == 0);
+    vTaskDelay(200 / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(shows(0, "second"));
+
+    WS2_msg_print(&CFAL1602, "third", 0, false);
+    WS2_msg_dwell(&CFAL1602, 5000);
+    WS2_msg_print(&CFAL1602, "fourth", 0, false);
+    WS2_msg_flush(&CFAL1602);
+    settle(&cmds, &data);
+    CHECK(shows(0, "fourth"));
+    return 0;
+}
+
+static int test_priority(void)
+{
+    int cmds, data;
+
+    // Equal or lower: waits its turn behind the running dwell
+    WS2_msg_screen(&CFAL1602, "Access granted", "", WS2_prio_outcome, 300);
+    WS2_msg_screen(&CFAL1602, "Door open", NULL, WS2_prio_outcome, 300);
+    WS2_msg_screen(&CFAL1602, "Returning to", "menu", WS2_prio_status, 300);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Access granted") && shows(1, ""));
+    vTaskDelay(300 / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Door open") && shows(1, ""));
+    vTaskDelay(300 / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Returning to") && shows(1, "menu"));
+    vTaskDelay(300 / portTICK_PERIOD_MS);
+
+    // Higher: cuts short the dwells below it, prints between still land
+    WS2_msg_screen(&CFAL1602, "Deleting", "", WS2_prio_status, 5000);
+    WS2_msg_print(&CFAL1602, "profile", 1, false);
+    WS2_msg_dwell(&CFAL1602, 5000);
+    WS2_msg_screen(&CFAL1602, "Invalid PIN", NULL, WS2_prio_error, 300);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Invalid PIN") && shows(1, "profile"));
+
+    // Unless one at its level is queued ahead: it waits behind that
+    WS2_msg_screen(&CFAL1602, "Bad fingerprint", "entry", WS2_prio_error, 300);
+    WS2_msg_screen(&CFAL1602, "Access denied", "", WS2_prio_outcome, 300);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Invalid PIN"));
+    vTaskDelay(300 / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Bad fingerprint") && shows(1, "entry"));
+    vTaskDelay(300 / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(shows(0, "Access denied") && shows(1, ""));
+    WS2_msg_flush(&CFAL1602);
+    return 0;
+}
+
+static int test_overflow(void)
+{
+    static const char *lines[2] = {"0123456789abcdef", "fedcba9876543210"};
+    int cmds, data;
+
+    // Far more mail than the mailbox holds, behind a long dwell: whatever
+    // is dropped, the last print on each line shows
+    WS2_msg_dwell(&CFAL1602, 5000);
+    for(int i = 0; i < 4 * WS2_MAILBOX_SIZE; i++){
+        WS2_msg_print(&CFAL1602, lines[i % 2], 0, false);
+        WS2_msg_print(&CFAL1602, lines[(i + 1) % 2], 1, false);
+        WS2_msg_dwell(&CFAL1602, 5000);
+    }
+    WS2_msg_print(&CFAL1602, "last", 0, false);
+    WS2_msg_print(&CFAL1602, "screen", 1, false);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    settle(&cmds, &data);
+    CHECK(shows(0, "last") && shows(1, "screen"));
+    CHECK(strcmp(WS2_get_string(&CFAL1602, 1), "screen") == 0);
+    WS2_msg_flush(&CFAL1602);
+    return 0;
+}
+
+// Watch a line for ticks ticks and mark which of the windows it showed.
+// Fails on anything else
+static int watch(int line, const char *msg, int step, int last, int ticks, bool *seen)
+{
+    char window[17];
+    for(int t = 0; t < 2 * ticks; t++){
+        bool valid = false;
+        for(int pos = 0; pos <= last; pos += step){
+            snprintf(window, sizeof(window), "%s", msg + pos);
+            if(shows(line, window)){
+                seen[pos / step] = valid = true;
+            }
+        }
+        CHECK(valid);
+        vTaskDelay(TICK_MS / 2 / portTICK_PERIOD_MS);
+    }
+    return 0;
+}
+
+static int test_scroll(void)
+{
+    static const char *scroll = "0123456789abcdefXYZ";
+    static const char *paged = "Place finger on the sensor";
+    bool seen[4] = {false};
+    int cmds, data;
+
+    // Scrolling by one around the ring: 0 to 3, then back to 0
+    WS2_msg_print(&CFAL1602, scroll, 1, true);
+    settle(&cmds, &data);
+    CHECK(watch(1, scroll, 1, 3, 12, seen) == 0);
+    CHECK(seen[0] && seen[1] && seen[2] && seen[3]);
+
+    // Paged: 0, then 16 with the rest padded
+    memset(seen, 0, sizeof(seen));
+    WS2_msg_print(&CFAL1602, paged, 1, false);
+    settle(&cmds, &data);
+    CHECK(watch(1, paged, 16, 16, 6, seen) == 0);
+    CHECK(seen[0] && seen[1]);
+
+    // Fits: the ticks stop, nothing more goes out
+    WS2_msg_print(&CFAL1602, "Place finger", 1, false);
+    settle(&cmds, &data);
+    CHECK(shows(1, "Place finger"));
+    vTaskDelay(10 * TICK_MS / portTICK_PERIOD_MS);
+    CHECK(settle(&cmds, &data) == 0);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    int cmds, data;
+    host_spi_set_transmit_hook(panel_hook);
+    WS2_init(&CFAL1602, -1, 15, 14, 13);
+    settle(&cmds, &data);
+    CHECK(shows(0, "") && shows(1, ""));
+
+    failed += test_changes_only();
+    failed += test_queued();
+    failed += test_dwell();
+    failed += test_priority();
+    failed += test_overflow();
+    failed += test_scroll();
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed ? 1 : 0;
+}
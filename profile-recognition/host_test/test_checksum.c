@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "R502Checksum.h"
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return 1; \
+    } \
+}while(0)
+
+// Room for a whole DownChar burst, plus slack to shift the alignment
+#define BUF_LEN 2200
+
+// The byte loop fill_checksum used before R502_checksum
+static uint16_t checksum_ref(uint16_t sum, const uint8_t *data, size_t len)
+{
+    int ref = sum;
+    for(size_t i = 0; i < len; i++){
+        ref += data[i];
+    }
+    return ref & 0xffff;
+}
+
+static int test_known_package(void)
+{
+    // VfyPwd, password 0: pid 0x01, length 0x0007, data 0x13 00 00 00 00
+    const uint8_t data[] = { 0x13, 0x00, 0x00, 0x00, 0x00 };
+    CHECK(R502_checksum(0x01 + 0x00 + 0x07, data, sizeof(data)) == 0x001b);
+    return 0;
+}
+
+static int test_empty(void)
+{
+    uint8_t dst = 0xa5;
+    CHECK(R502_checksum(0x1234, NULL, 0) == 0x1234);
+    CHECK(R502_checksum_copy(0x1234, &dst, NULL, 0) == 0x1234);
+    CHECK(dst == 0xa5);
+    return 0;
+}
+
+static int test_lane_overflow(void)
+{
+    // All 0xff fills every lane to the limit, at every alignment
+    static uint8_t buf[BUF_LEN];
+    memset(buf, 0xff, sizeof(buf));
+    for(int offset = 0; offset < 4; offset++){
+        size_t len = sizeof(buf) - offset;
+        CHECK(R502_checksum(0xffff, buf + offset, len) ==
+            checksum_ref(0xffff, buf + offset, len));
+    }
+    return 0;
+}
+
+static int test_random_packages(void)
+{
+    static uint8_t src[BUF_LEN];
+    static uint8_t dst[BUF_LEN];
+    srand(502);
+    for(int round = 0; round < 20000; round++){
+        for(int i = 0; i < sizeof(src); i++){
+            src[i] = rand();
+        }
+        memset(dst, 0xa5, sizeof(dst));
+        int src_off = rand() % 4;
+        int dst_off = rand() % 4;
+        size_t len = rand() % (sizeof(src) - 4);
+        uint16_t seed = rand();
+
+        uint16_t ref = checksum_ref(seed, src + src_off, len);
+        CHECK(R502_checksum(seed, src + src_off, len) == ref);
+        CHECK(R502_checksum_copy(seed, dst + dst_off, src + src_off, len) == ref);
+        CHECK(memcmp(dst + dst_off, src + src_off, len) == 0);
+        // Nothing written outside dst
+        for(int i = 0; i < dst_off; i++){
+            CHECK(dst[i] == 0xa5);
+        }
+        for(size_t i = dst_off + len; i < sizeof(dst); i++){
+            CHECK(dst[i] == 0xa5);
+        }
+    }
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed += test_known_package();
+    failed += test_empty();
+    failed += test_lane_overflow();
+    failed += test_random_packages();
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "input.h"
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return 1; \
+    } \
+}while(0)
+
+#define CLAIMS_PER_TASK 2000
+#define CLAIM_TASKS 3
+
+static SemaphoreHandle_t tasks_done;
+static volatile int shared_count;
+static volatile bool waiter_claimed;
+
+// Private functions
+
+// Read, yield, write: loses counts unless the claim keeps the others out
+static void claim_task(void *arg)
+{
+    bool try_only = (bool)(uintptr_t)arg;
+    int claims = 0;
+    while(claims < CLAIMS_PER_TASK){
+        if(try_only){
+            if(!input_try_acquire()){
+                taskYIELD();
+                continue;
+            }
+        }
+        else{
+            input_acquire();
+        }
+        int count = shared_count;
+        taskYIELD();
+        shared_count = count + 1;
+        input_release();
+        claims++;
+    }
+    xSemaphoreGive(tasks_done);
+    vTaskDelete(NULL);
+}
+
+static void waiter_task(void *arg)
+{
+    input_acquire();
+    waiter_claimed = true;
+    input_release();
+    xSemaphoreGive(tasks_done);
+    vTaskDelete(NULL);
+}
+
+static int test_before_init(void)
+{
+    input_event_t event = { .source = INPUT_EVENT_KEY, .key = '1' };
+
+    // Interrupts before app_main creates the queue are dropped, not a crash
+    CHECK(!input_post_gpio_from_isr(22));
+    CHECK(!input_post(&event, 0));
+    CHECK(!input_pending());
+    return 0;
+}
+
+static int test_order(void)
+{
+    input_event_t event;
+
+    // A PIN typed around a button press and a touch comes out as it went in
+    const char *keys = "12#";
+    for(int i = 0; keys[i]; i++){
+        event = (input_event_t){ .source = INPUT_EVENT_KEY, .key = keys[i] };
+        CHECK(input_post(&event, 0));
+        if(i == 0) CHECK(input_post_gpio_from_isr(22));
+        if(i == 1){
+            event = (input_event_t){ .source = INPUT_EVENT_AUTH };
+            CHECK(input_post(&event, 0));
+        }
+    }
+    CHECK(input_pending());
+    CHECK(input_receive(&event, 0) && event.source == INPUT_EVENT_KEY && event.key == '1');
+    CHECK(input_receive(&event, 0) && event.source == INPUT_EVENT_GPIO && event.gpio_num == 22);
+    CHECK(input_receive(&event, 0) && event.source == INPUT_EVENT_KEY && event.key == '2');
+    CHECK(input_receive(&event, 0) && event.source == INPUT_EVENT_AUTH);
+    CHECK(input_receive(&event, 0) && event.source == INPUT_EVENT_KEY && event.key == '#');
+    CHECK(!input_pending());
+    CHECK(!input_receive(&event, 0));
+
+    // Full: the poster waits, nothing already queued is lost
+    event = (input_event_t){ .source = INPUT_EVENT_KEY, .key = '0' };
+    for(int i = 0; i < INPUT_QUEUE_SIZE; i++){
+        CHECK(input_post(&event, 0));
+    }
+    CHECK(!input_post(&event, 0));
+    for(int i = 0; i < INPUT_QUEUE_SIZE; i++){
+        CHECK(input_receive(&event, 0));
+    }
+    CHECK(!input_receive(&event, 0));
+    return 0;
+}
+
+static int test_claim(void)
+{
+    CHECK(input_try_acquire());
+    CHECK(!input_try_acquire());
+    input_release();
+    CHECK(input_try_acquire());
+    input_release();
+
+    // A waiter runs once the holder releases, not before
+    tasks_done = xSemaphoreCreateCounting(CLAIM_TASKS, 0);
+    input_acquire();
+    waiter_claimed = false;
+    xTaskCreate(waiter_task, "waiter", 2048, NULL, 5, NULL);
+    vTaskDelay(20 / portTICK_PERIOD_MS);
+    CHECK(!waiter_claimed);
+    input_release();
+    CHECK(xSemaphoreTake(tasks_done, 1000 / portTICK_PERIOD_MS));
+    CHECK(waiter_claimed);
+    vSemaphoreDelete(tasks_done);
+    return 0;
+}
+
+static int test_contention(void)
+{
+    // Two input tasks waiting and one trying, as the auth task does
+    tasks_done = xSemaphoreCreateCounting(CLAIM_TASKS, 0);
+    shared_count = 0;
+    for(int i = 0; i < CLAIM_TASKS; i++){
+        xTaskCreate(claim_task, "claim", 2048, (void *)(uintptr_t)(i == 0), 5, NULL);
+    }
+    for(int i = 0; i < CLAIM_TASKS; i++){
+        CHECK(xSemaphoreTake(tasks_done, 10000 / portTICK_PERIOD_MS));
+    }
+    vSemaphoreDelete(tasks_done);
+    CHECK(shared_count == CLAIMS_PER_TASK * CLAIM_TASKS);
+    CHECK(input_try_acquire());
+    input_release();
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed += test_before_init();
+    if(input_init() != ESP_OK){
+        printf("input_init failed\n");
+        return 1;
+    }
+    failed += test_order();
+    failed += test_claim();
+    failed += test_contention();
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed ? 1 : 0;
+}
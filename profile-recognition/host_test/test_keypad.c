@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "Keypad.h"
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return 1; \
+    } \
+}while(0)
+
+// The board's keypad, as in main.c
+#define ROWS 4
+#define COLS 4
+
+static char keys[ROWS][COLS] = {
+    {'1','2','3','A'},
+    {'4','5','6','B'},
+    {'7','8','9','C'},
+    {'*','0','#','D'}
+};
+static uint8_t rowPins[ROWS] = {34, 35, 36, 39};
+static uint8_t colPins[COLS] = {25, 26, 27, 33};
+
+static Keypad keypad;
+static QueueHandle_t key_queue;
+
+// The matrix: a row reads low while a pressed key joins it to a low column
+static pthread_mutex_t matrix_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool pressed[ROWS][COLS];
+static uint32_t column_level[COLS] = {1, 1, 1, 1};
+static volatile int column_writes;
+
+// Private functions
+
+static void update_rows(void)
+{
+    for(int r = 0; r < ROWS; r++){
+        uint32_t level = 1;
+        for(int c = 0; c < COLS; c++){
+            if(pressed[r][c] && column_level[c] == 0) level = 0;
+        }
+        host_gpio_set_input(rowPins[r], level);
+    }
+}
+
+static void column_hook(gpio_num_t gpio_num, uint32_t level)
+{
+    for(int c = 0; c < COLS; c++){
+        if(colPins[c] != gpio_num) continue;
+        pthread_mutex_lock(&matrix_lock);
+        column_level[c] = level;
+        column_writes++;
+        update_rows();
+        pthread_mutex_unlock(&matrix_lock);
+    }
+}
+
+static void press(char key, bool down)
+{
+    pthread_mutex_lock(&matrix_lock);
+    for(int r = 0; r < ROWS; r++){
+        for(int c = 0; c < COLS; c++){
+            if(keys[r][c] == key) pressed[r][c] = down;
+        }
+    }
+    update_rows();
+    pthread_mutex_unlock(&matrix_lock);
+}
+
+static int writes(void)
+{
+    pthread_mutex_lock(&matrix_lock);
+    int count = column_writes;
+    pthread_mutex_unlock(&matrix_lock);
+    return count;
+}
+
+// gpio_keypad_loop in main.c, posting here instead of the input queue
+static void keypad_task(void *arg)
+{
+    for(;;){
+        if(Keypad_isIdle(&keypad)){
+            Keypad_waitForPress(&keypad, portMAX_DELAY);
+        }
+        vTaskDelay(10 / portTICK_PERIOD_MS);
+        char key = Keypad_getKey(&keypad);
+        if(key != NO_KEY) xQueueSend(key_queue, &key, portMAX_DELAY);
+    }
+}
+
+static int test_idle(void)
+{
+    // Nothing down: columns driven once, then no scanning at all
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    int before = writes();
+    vTaskDelay(300 / portTICK_PERIOD_MS);
+    CHECK(writes() == before);
+    return 0;
+}
+
+static int test_press(void)
+{
+    char key;
+
+    // The row interrupt wakes the scan, which finds the key
+    press('5', true);
+    CHECK(xQueueReceive(key_queue, &key, 200 / portTICK_PERIOD_MS) && key == '5');
+
+    // Scanning while it's held, for HOLD and the release
+    int before = writes();
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    CHECK(writes() > before);
+    press('5', false);
+
+    // Released: back to idle, one key reported
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    before = writes();
+    vTaskDelay(200 / portTICK_PERIOD_MS);
+    CHECK(writes() == before);
+    CHECK(!xQueueReceive(key_queue, &key, 0));
+    return 0;
+}
+
+static int test_sequence(void)
+{
+    char key;
+
+    // A quick PIN, each key woken from idle, in order
+    const char *pin = "1#D0";
+    for(int i = 0; pin[i]; i++){
+        press(pin[i], true);
+        vTaskDelay(50 / portTICK_PERIOD_MS);
+        press(pin[i], false);
+        vTaskDelay(50 / portTICK_PERIOD_MS);
+    }
+    for(int i = 0; pin[i]; i++){
+        CHECK(xQueueReceive(key_queue, &key, 200 / portTICK_PERIOD_MS) && key == pin[i]);
+    }
+    CHECK(!xQueueReceive(key_queue, &key, 100 / portTICK_PERIOD_MS));
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    gpio_install_isr_service(0);
+    host_gpio_set_output_hook(column_hook);
+    // Rows idle high, as their external pull-ups hold them
+    press('\0', false);
+    Keypad_init(&keypad, makeKeymap(keys), rowPins, colPins, ROWS, COLS);
+    key_queue = xQueueCreate(16, sizeof(char));
+    xTaskCreate(keypad_task, "keypad", 4096, NULL, 12, NULL);
+
+    failed += test_idle();
+    failed += test_press();
+    failed += test_sequence();
+    printf("%s\n", failed ? "FAIL" : "OK");
+    fflush(stdout);
+    // The keypad task never ends, leave without joining it
+    _exit(failed ? 1 : 0);
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "latency-trace.h"
+
+#define CHECK(cond) do{ \
+    if(!(cond)){ \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return 1; \
+    } \
+}while(0)
+
+// Worst bucket width, a percentile is reported as the top of its bucket
+#define BUCKET_SLACK(us) ((us) / 4 + 1)
+
+static SemaphoreHandle_t other_done;
+
+// Private functions
+
+// Stamps the whole path from a task that doesn't own the trace
+static void other_task(void *arg)
+{
+    for(int point = LT_task_wake; point < LT_point_count; point++){
+        LT_mark(point);
+    }
+    LT_end();
+    xSemaphoreGive(other_done);
+    vTaskDelete(NULL);
+}
+
+static void full_trace(int search_us)
+{
+    LT_start_from_isr();
+    for(int point = LT_task_wake; point < LT_point_count; point++){
+        if(point == LT_search) usleep(search_us);
+        LT_mark(point);
+    }
+    LT_end();
+}
+
+static int test_no_trace(void)
+{
+    LT_stage_stats_t stats;
+    LT_reset();
+
+    // Nothing started, every stamp is dropped
+    for(int point = LT_task_wake; point < LT_point_count; point++){
+        LT_mark(point);
+    }
+    LT_end();
+    for(int stage = LT_task_wake; stage < LT_STAGE_COUNT; stage++){
+        LT_get_stats(stage, &stats);
+        CHECK(stats.count == 0);
+    }
+    return 0;
+}
+
+static int test_owner(void)
+{
+    LT_stage_stats_t stats;
+    LT_reset();
+
+    // Claimed here, so another task's relay and end don't touch it
+    LT_start_from_isr();
+    LT_mark(LT_task_wake);
+    other_done = xSemaphoreCreateBinary();
+    xTaskCreate(other_task, "other", 2048, NULL, 5, NULL);
+    xSemaphoreTake(other_done, portMAX_DELAY);
+    vSemaphoreDelete(other_done);
+    LT_get_stats(LT_STAGE_TOTAL, &stats);
+    CHECK(stats.count == 0);
+
+    // A second interrupt doesn't restart the running trace
+    usleep(2000);
+    LT_start_from_isr();
+    LT_end();
+    LT_get_stats(LT_task_wake, &stats);
+    CHECK(stats.count == 1);
+    CHECK(stats.max_us < 2000);
+    LT_get_stats(LT_scan_start, &stats);
+    CHECK(stats.count == 0);
+    return 0;
+}
+
+static int test_denied(void)
+{
+    LT_stage_stats_t stats;
+    LT_reset();
+
+    // Search fails: the stages up to it count, finger to relay doesn't
+    LT_start_from_isr();
+    for(int point = LT_task_wake; point <= LT_search; point++){
+        LT_mark(point);
+    }
+    LT_end();
+    LT_get_stats(LT_search, &stats);
+    CHECK(stats.count == 1);
+    LT_get_stats(LT_outcome, &stats);
+    CHECK(stats.count == 0);
+    LT_get_stats(LT_STAGE_TOTAL, &stats);
+    CHECK(stats.count == 0);
+
+    // A point stamped twice keeps the first time
+    LT_reset();
+    LT_start_from_isr();
+    LT_mark(LT_task_wake);
+    LT_mark(LT_scan_start);
+    usleep(3000);
+    LT_mark(LT_scan_start);
+    LT_end();
+    LT_get_stats(LT_scan_start, &stats);
+    CHECK(stats.count == 1);
+    CHECK(stats.max_us < 3000);
+    return 0;
+}
+
+static int test_percentiles(void)
+{
+    LT_stage_stats_t stats;
+    LT_reset();
+
+    // 99 short searches and a long one: p50 and p99 short, max long
+    for(int i = 0; i < 100; i++){
+        full_trace(i < 99 ? 1000 : 20000);
+    }
+    LT_get_stats(LT_search, &stats);
+    CHECK(stats.count == 100);
+    CHECK(stats.min_us >= 1000);
+    CHECK(stats.max_us >= 20000);
+    CHECK(stats.p50_us >= stats.min_us && stats.p50_us <= stats.p99_us);
+    CHECK(stats.p99_us < 20000);
+    CHECK(stats.p99_us <= stats.max_us);
+
+    // Every trace reached the relay, and took at least its search
+    LT_get_stats(LT_STAGE_TOTAL, &stats);
+    CHECK(stats.count == 100);
+    CHECK(stats.min_us >= 1000);
+    CHECK(stats.max_us >= 20000);
+
+    // One sample: every percentile is that sample
+    LT_reset();
+    full_trace(5000);
+    LT_get_stats(LT_search, &stats);
+    CHECK(stats.count == 1);
+    CHECK(stats.min_us == stats.max_us);
+    CHECK(stats.p50_us == stats.min_us && stats.p99_us == stats.min_us);
+
+    LT_reset();
+    LT_get_stats(LT_search, &stats);
+    CHECK(stats.count == 0);
+    return 0;
+}
+
+static int test_bucket_resolution(void)
+{
+    LT_stage_stats_t stats;
+    LT_reset();
+
+    // Two clusters far apart: p50 in the lower one and p99 in the upper, each
+    // within a bucket of what was measured
+    for(int i = 0; i < 60; i++){
+        full_trace(i < 40 ? 2000 : 8000);
+    }
+    LT_get_stats(LT_search, &stats);
+    CHECK(stats.p50_us >= stats.min_us);
+    CHECK(stats.p50_us <= stats.min_us + BUCKET_SLACK(stats.min_us) + 1000);
+    CHECK(stats.p50_us < 8000);
+    CHECK(stats.p99_us >= 8000);
+    CHECK(stats.p99_us <= stats.max_us);
+    return 0;
+}
+
+int main(void)
+{
+    int failed = 0;
+    failed += test_no_trace();
+    failed += test_owner();
+    failed += test_denied();
+    failed += test_percentiles();
+    failed += test_bucket_resolution();
+    LT_print(stdout);
+    printf("%s\n", failed ? "FAIL" : "OK");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/**
+ * \brief Driver behaviour on a bad link, only possible against the fake
+ */
+#include "unity.h"
+#include "R502Interface.h"
+#include "fake_r502.h"
+
+#define PIN_TXD  (GPIO_NUM_17)
+#define PIN_RXD  (GPIO_NUM_16)
+#define PIN_IRQ  (GPIO_NUM_4)
+
+// The object under test, from test_uart.c, which also deinits it in tearDown
+extern R502Interface R502;
+
+static uint8_t template[R502_TEMPLATE_SIZE];
+static uint8_t fake_template[R502_TEMPLATE_SIZE];
+
+static void init_r502(void)
+{
+    esp_err_t err = R502_init(&R502, UART_NUM_1, PIN_TXD, PIN_RXD, PIN_IRQ, R502_baud_115200);
+    TEST_ESP_OK(err);
+}
+
+static void vfy_pass_ok(void)
+{
+    uint8_t pass[4] = {0x00, 0x00, 0x00, 0x00};
+    R502_conf_code_t conf_code = R502_fail;
+    TEST_ESP_OK(R502_vfy_pass(&R502, pass, &conf_code));
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+}
+
+TEST_CASE("Fault-Checksum", "[faults]")
+{
+    init_r502();
+    uint8_t pass[4] = {0x00, 0x00, 0x00, 0x00};
+    R502_conf_code_t conf_code = R502_fail;
+    fake_r502_inject_fault(fake_r502_fault_checksum, 0, 1, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, R502_vfy_pass(&R502, pass, &conf_code));
+    vfy_pass_ok();
+}
+
+TEST_CASE("Fault-Drop", "[faults]")
+{
+    init_r502();
+    uint8_t pass[4] = {0x00, 0x00, 0x00, 0x00};
+    R502_conf_code_t conf_code = R502_fail;
+    fake_r502_inject_fault(fake_r502_fault_drop, 0, 1, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, R502_vfy_pass(&R502, pass, &conf_code));
+    vfy_pass_ok();
+}
+
+TEST_CASE("Fault-Truncate", "[faults]")
+{
+    init_r502();
+    uint8_t pass[4] = {0x00, 0x00, 0x00, 0x00};
+    R502_conf_code_t conf_code = R502_fail;
+    fake_r502_inject_fault(fake_r502_fault_truncate, 0, 1, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, R502_vfy_pass(&R502, pass, &conf_code));
+    vfy_pass_ok();
+}
+
+TEST_CASE("Fault-ZeroLength", "[faults]")
+{
+    init_r502();
+    uint8_t pass[4] = {0x00, 0x00, 0x00, 0x00};
+    R502_conf_code_t conf_code = R502_fail;
+    fake_r502_inject_fault(fake_r502_fault_zero_length, 0, 1, 0);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_RESPONSE, R502_vfy_pass(&R502, pass, &conf_code));
+    vfy_pass_ok();
+}
+
+TEST_CASE("Fault-Noise", "[faults]")
+{
+    init_r502();
+    fake_r502_inject_fault(fake_r502_fault_noise, 0, 3, 0);
+    vfy_pass_ok();
+    vfy_pass_ok();
+    vfy_pass_ok();
+}
+
+TEST_CASE("Fault-Delay", "[faults]")
+{
+    init_r502();
+    // Late, but inside the read delay
+    fake_r502_inject_fault(fake_r502_fault_delay, 0, 1, R502.default_read_delay * 1000 / 2);
+    vfy_pass_ok();
+}
+
+TEST_CASE("Fault-UpCharData", "[faults]")
+{
+    init_r502();
+    R502_conf_code_t conf_code = R502_fail;
+    int received_len = 0;
+
+    // The ack goes through, the second data package is corrupted
+    fake_r502_inject_fault(fake_r502_fault_checksum, 2, 1, 0);
+    esp_err_t err = R502_up_char_into(&R502, 1, template, sizeof(template), &received_len,
+        &conf_code);
+    TEST_ASSERT_EQUAL(ESP_ERR_INVALID_CRC, err);
+
+    // Once the rest of the template is in, the next command drops it
+    vTaskDelay(200 / portTICK_PERIOD_MS);
+    err = R502_up_char_into(&R502, 1, template, sizeof(template), &received_len, &conf_code);
+    TEST_ESP_OK(err);
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    TEST_ASSERT_TRUE(fake_r502_get_char_buffer(1, fake_template));
+    TEST_ASSERT_EQUAL_MEMORY(fake_template, template, R502_TEMPLATE_SIZE);
+}
+
+TEST_CASE("Link-BaudNegotiated", "[link]")
+{
+    // The fake powers on at 57600, init moves it to the fastest rate
+    TEST_ASSERT_EQUAL(9600 * R502_baud_57600, fake_r502_get_baudrate());
+    init_r502();
+    TEST_ASSERT_EQUAL(9600 * R502_BAUD_FASTEST, fake_r502_get_baudrate());
+    TEST_ASSERT_EQUAL(R502_BAUD_FASTEST, R502.cur_baud);
+    vfy_pass_ok();
+}
+
+TEST_CASE("Link-InitWritesOnlyChanges", "[link]")
+{
+    // First init moves the module, a second one finds it set up and only
+    // probes
+    init_r502();
+    fake_r502_stats_t stats;
+    fake_r502_get_stats(&stats);
+    int commands = stats.commands;
+    TEST_ESP_OK(R502_deinit(&R502));
+    init_r502();
+    fake_r502_get_stats(&stats);
+    TEST_ASSERT_EQUAL(commands + 1, stats.commands);
+    TEST_ASSERT_EQUAL(R502_ic_read_sys_para, stats.last_instr_code);
+    TEST_ASSERT_EQUAL(256, R502.cur_data_pkg_len);
+    vfy_pass_ok();
+}
+
+TEST_CASE("Link-BaudProbeLost", "[link]")
+{
+    // The module acks the switch, but the first reply at the new rate is
+    // lost. init finds it there again rather than fall back to 57600
+    fake_r502_inject_fault(fake_r502_fault_drop, 2, 1, 0);
+    init_r502();
+    TEST_ASSERT_EQUAL(9600 * R502_BAUD_FASTEST, fake_r502_get_baudrate());
+    TEST_ASSERT_EQUAL(R502_BAUD_FASTEST, R502.cur_baud);
+    vfy_pass_ok();
+}
+
+TEST_CASE("Link-DataLength", "[link]")
+{
+    init_r502();
+    TEST_ASSERT_EQUAL(256, R502.cur_data_pkg_len);
+
+    // 32 and 64 byte packages come back as 128, and the driver follows
+    R502_conf_code_t conf_code = R502_fail;
+    TEST_ESP_OK(R502_set_data_package_length(&R502, R502_data_len_32, &conf_code));
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    TEST_ASSERT_EQUAL(128, R502.cur_data_pkg_len);
+}
+
+TEST_CASE("Link-CharRoundTrip", "[link]")
+{
+    init_r502();
+    R502_conf_code_t conf_code = R502_fail;
+    fake_r502_finger_template(7, template);
+    TEST_ESP_OK(R502_down_char(&R502, 2, template, &conf_code));
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    TEST_ASSERT_TRUE(fake_r502_get_char_buffer(2, fake_template));
+    TEST_ASSERT_EQUAL_MEMORY(template, fake_template, R502_TEMPLATE_SIZE);
+
+    // Store it and find it again
+    TEST_ESP_OK(R502_store(&R502, 2, 5, &conf_code));
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    uint16_t page_id = 0;
+    uint16_t match_score = 0;
+    TEST_ESP_OK(R502_search(&R502, 2, 1, 100, &conf_code, &page_id, &match_score));
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    TEST_ASSERT_EQUAL(5, page_id);
+
+    // Load it back from flash and upload it
+    int received_len = 0;
+    TEST_ESP_OK(R502_load_char(&R502, 1, 5, &conf_code));
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    TEST_ESP_OK(R502_up_char_into(&R502, 1, fake_template, sizeof(fake_template),
+        &received_len, &conf_code));
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+    TEST_ASSERT_EQUAL(R502_TEMPLATE_SIZE, received_len);
+    TEST_ASSERT_EQUAL_MEMORY(template, fake_template, R502_TEMPLATE_SIZE);
+
+    // A different finger is not found
+    fake_r502_finger_template(8, template);
+    TEST_ESP_OK(R502_down_char(&R502, 2, template, &conf_code));
+    TEST_ESP_OK(R502_search(&R502, 2, 0, 100, &conf_code, &page_id, &match_score));
+    TEST_ASSERT_EQUAL(R502_err_not_found, conf_code);
+}
+
+TEST_CASE("Link-Throughput", "[link]")
+{
+    init_r502();
+    R502_conf_code_t conf_code = R502_fail;
+    int received_len = 0;
+
+    // Template bytes plus a header and checksum per package, at 10 bits a byte
+    int packages = R502_TEMPLATE_SIZE / R502.cur_data_pkg_len;
+    int64_t wire_us = (int64_t)(R502_TEMPLATE_SIZE + packages * (R502.header_size +
+        R502_CS_LEN)) * 10 * 1000000 / (9600 * R502.cur_baud);
+
+    int64_t time_start = esp_timer_get_time();
+    TEST_ESP_OK(R502_up_char_into(&R502, 1, template, sizeof(template), &received_len,
+        &conf_code));
+    int64_t up_us = esp_timer_get_time() - time_start;
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+
+    time_start = esp_timer_get_time();
+    TEST_ESP_OK(R502_down_char(&R502, 1, template, &conf_code));
+    int64_t down_us = esp_timer_get_time() - time_start;
+    TEST_ASSERT_EQUAL(R502_ok, conf_code);
+
+    printf("UpChar %lld us, DownChar %lld us, wire time %lld us\n", (long long)up_us,
+        (long long)down_us, (long long)wire_us);
+    // Wire time, the reply latency, and room for a loaded machine
+    TEST_ASSERT_LESS_THAN(wire_us * 2 + 50000, up_us);
+    TEST_ASSERT_LESS_THAN(wire_us * 2 + 50000, down_us);
+}
+
+TEST_CASE("Link-NotWired", "[link]")
+{
+    // Pins the fake is not on: the driver still inits and reports no module
+    esp_err_t err = R502_init(&R502, UART_NUM_1, GPIO_NUM_25, GPIO_NUM_26, PIN_IRQ,
+        R502_baud_115200);
+    TEST_ESP_OK(err);
+    uint8_t pass[4] = {0x00, 0x00, 0x00, 0x00};
+    R502_conf_code_t conf_code = R502_fail;
+    TEST_ASSERT_EQUAL(ESP_ERR_NOT_FOUND, R502_vfy_pass(&R502, pass, &conf_code));
+
+    fake_r502_stats_t stats;
+    fake_r502_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.commands);
+    TEST_ASSERT_GREATER_THAN(0, stats.bytes_dropped);
+}